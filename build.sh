@@ -30,5 +30,6 @@ echo "alias lmus=$(pwd)/build/Litemus" >> "$RC_FILE"
 mkdir $HOME/.config/litemus/ >/dev/null
 
 cp keybinds.json $HOME/.config/litemus/
+cp -n playlists.json $HOME/.config/litemus/  # never replaces playlists already saved
 
 echo -e "\n[SUCCESS] Alias added to $RC_FILE. Please restart your terminal or source the rc file to apply the changes."
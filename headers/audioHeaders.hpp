@@ -0,0 +1,20 @@
+#ifndef AUDIO_HEADERS_HPP
+#define AUDIO_HEADERS_HPP
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Duration from container / stream headers only, without decoding:
+//   mp3  - Xing/Info frame (minus LAME encoder delay and padding), VBRI frame,
+//          or an exact count of every frame header when neither is present
+//   flac - STREAMINFO total samples
+//   wav  - data chunk size / fmt byte rate
+// Returns 0 when the headers do not tell (the caller decides on a fallback).
+uint32_t probeDurationMs(const std::string& filePath);
+
+// Calls onFrame for every MPEG audio frame of an mp3 (ID3v2 tag skipped, stops at
+// ID3v1 / APE trailers or the first broken header). Returns false if no frame was found.
+bool walkMp3Frames(const std::string& filePath, const std::function<void(uint64_t offset, uint32_t samples, uint32_t sampleRate)>& onFrame);
+
+#endif // AUDIO_HEADERS_HPP
@@ -19,6 +19,7 @@ void draw_error_window(WINDOW *win);
 void draw_error_message(WINDOW *win, const char *message);
 void cleanup(WINDOW *win, const char *song_directory, const std::string& songDirPath);
 bool has_mp3_files(const char *dir_path);
+bool file_exists_and_not_empty(const std::string& path);
 int songDirMain(const std::string& songDirPath, const std::string& cacheLitemusDir);
 
 #endif // CHECK_SONG_DIR_HPP
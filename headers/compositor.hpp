@@ -0,0 +1,39 @@
+#ifndef COMPOSITOR_HPP
+#define COMPOSITOR_HPP
+
+#include <ncurses.h>
+
+// Frame compositor over wnoutrefresh / doupdate.
+// Panels and overlays only mark themselves dirty after drawing; flushFrame() copies the
+// dirty windows into ncurses' virtual screen (panels first, then overlays on top) and
+// writes the difference to the terminal with a single doupdate(). Inside a window the
+// damaged lines are the ones ncurses already tracks per line, so an untouched row costs
+// nothing. Like ncurses itself there is one screen, so the state is process wide.
+
+// Base panel (title, artists, songs, status); flushed in registration order
+void compositorAddPanel(WINDOW* win);
+
+// Anything that is not a registered panel is an overlay and is flushed after the panels
+void markDirty(WINDOW* win);
+
+// Every panel is touched and redrawn, e.g. after a resize or once an overlay is gone
+void markAllDirty();
+
+// An overlay is about to be deleted, drop it from the pending frame
+void compositorForget(WINDOW* win);
+
+// One doupdate() for everything marked since the last frame; a no-op when nothing is dirty
+void flushFrame();
+
+struct FrameStats {
+    bool counting;                 // false unless enableFrameByteCounter() succeeded
+    unsigned long frames;
+    unsigned long long lastFrameBytes;
+    unsigned long long totalBytes;
+};
+
+// Counts the bytes each doupdate() writes to the terminal (per-thread write accounting)
+bool enableFrameByteCounter();
+FrameStats frameStats();
+
+#endif // COMPOSITOR_HPP
@@ -0,0 +1,54 @@
+#ifndef CONCURRENT_QUEUE_HPP
+#define CONCURRENT_QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Bounded multi-producer / multi-consumer queue.
+// push() blocks while the queue is full, pop() blocks until an item arrives
+// or the queue is closed and drained.
+template <typename T>
+class ConcurrentQueue {
+public:
+    explicit ConcurrentQueue(size_t capacity) : capacity(capacity == 0 ? 1 : capacity) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return items.size() < capacity || closed; });
+        if (closed) {
+            return;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return !items.empty() || closed; });
+        if (items.empty()) {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
+
+#endif // CONCURRENT_QUEUE_HPP
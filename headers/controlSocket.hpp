@@ -0,0 +1,72 @@
+#ifndef CONTROL_SOCKET_HPP
+#define CONTROL_SOCKET_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Line protocol of `lmus daemon` over a Unix domain stream socket.
+// Every request is one line, every reply is one line: "OK", "OK <json>" for queries,
+// or "ERR <reason>". Requests on one connection are answered in order.
+//
+//   play [ID]          resume, or play track ID (its artist becomes the queue)
+//   pause | toggle     pause, or flip between playing and paused
+//   next | prev        move through the play queue
+//   seek [+|-]SECONDS  absolute, or relative with a sign
+//   volume [+|-]N      0 to 100, relative with a sign
+//   enqueue ID         append track ID to the play queue
+//   shuffle [on|off]   toggles without an argument
+//   status             OK {"state":..., "track":..., "position":..., ...}
+//   quit               saves the queue and stops the daemon
+
+// Server side, polled from the daemon's LoopEvents
+class ControlServer {
+public:
+    ControlServer() = default;
+    ~ControlServer();
+    ControlServer(const ControlServer&) = delete;
+    ControlServer& operator=(const ControlServer&) = delete;
+
+    // Binds `path`, replacing a stale socket file; false when a daemon already answers there
+    bool open(const std::string& path);
+
+    // Listening socket and connected clients, for LoopEvents::watchControl()
+    std::vector<int> fds() const;
+
+    // Accepts pending connections and answers every complete line with `handler`; never blocks
+    void service(const std::function<std::string(const std::string&)>& handler);
+
+private:
+    struct Client {
+        int fd;
+        std::string pending;  // bytes after the last newline
+    };
+
+    int listenFd = -1;
+    std::string socketPath;
+    std::vector<Client> clients;
+};
+
+// Client side: `lmus ctl`, the thin client of `lmus run`
+class ControlClient {
+public:
+    ControlClient() = default;
+    ~ControlClient();
+    ControlClient(const ControlClient&) = delete;
+    ControlClient& operator=(const ControlClient&) = delete;
+
+    bool connect(const std::string& path);
+
+    // Sends one request line and waits up to `timeoutMs` for its reply line; false when the
+    // daemon went away or did not answer in time
+    bool request(const std::string& line, std::string& reply, int timeoutMs = 1000);
+
+private:
+    int fd = -1;
+    std::string pending;
+};
+
+// True when a daemon accepts connections on `path`
+bool daemonListening(const std::string& path);
+
+#endif // CONTROL_SOCKET_HPP
@@ -0,0 +1,21 @@
+#ifndef DAEMON_HPP
+#define DAEMON_HPP
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include "loudness.hpp"
+
+// `lmus daemon`: the player without a UI, driven over the control socket (controlSocket.hpp).
+// Same engine, loader, queue and sfml_helpers as `lmus run`; the loop sleeps in poll() on
+// the socket, the audio eventfds and a signalfd, so SIGINT / SIGTERM save the queue too.
+int lmus_daemon_main(const std::string& songsDirectory, const std::string& indexFilePath, const std::string& queueFilePath, const std::string& seekIndexDir, const std::string& socketPath, float bufferSeconds, uint32_t trackCacheMb, NormalizeMode normalize);
+
+// `lmus ctl CMD...`: one request, the reply on stdout (errors on stderr, exit status 1)
+int lmus_ctl_main(const std::string& socketPath, const std::string& command);
+
+// `lmus run` while a daemon listens: a status screen whose playback keys are sent to it.
+// Quitting detaches, the daemon keeps playing
+int lmus_attach_main(const std::string& socketPath, std::unordered_map<std::string, int>& keybinds);
+
+#endif // DAEMON_HPP
@@ -0,0 +1,28 @@
+#ifndef DIR_SCANNER_HPP
+#define DIR_SCANNER_HPP
+
+#include <string>
+#include <vector>
+#include <ctime>
+#include <sys/types.h>
+
+// One audio file found in the song directory
+struct FileRecord {
+    ino_t inode;
+    std::string path;   // relative to the scanned directory
+    off_t size;
+    time_t mtime;
+};
+
+struct ScanStats {
+    size_t entriesSeen = 0;       // every directory entry looked at (not only matches)
+    double elapsedSeconds = 0.0;
+    double entriesPerSecond = 0.0;
+};
+
+// Single pass over dirPath (no forks, no per-file `find`)
+// Records are ordered by extension (in the given order) and then by file name,
+// which is the same order the old `ls -i *.ext` pipeline produced.
+std::vector<FileRecord> scanSongDirectory(const std::string& dirPath, const std::vector<std::string>& extensions, ScanStats& stats);
+
+#endif // DIR_SCANNER_HPP
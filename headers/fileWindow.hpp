@@ -0,0 +1,70 @@
+#ifndef FILE_WINDOW_HPP
+#define FILE_WINDOW_HPP
+
+#include <string>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Read-only view of a file for header parsing.
+// The first `windowSize` bytes are fetched with a single pread when the file is opened,
+// anything outside that window costs one bounded pread per request.
+class FileWindow {
+public:
+    explicit FileWindow(const std::string& path, size_t windowSize = 64 * 1024) {
+        fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            fileSize = static_cast<uint64_t>(st.st_size);
+        }
+        head.resize(windowSize);
+        ssize_t n = pread(fd, &head[0], windowSize, 0);
+        head.resize(n > 0 ? static_cast<size_t>(n) : 0);
+    }
+
+    ~FileWindow() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    FileWindow(const FileWindow&) = delete;
+    FileWindow& operator=(const FileWindow&) = delete;
+
+    bool isOpen() const { return fd >= 0; }
+    uint64_t size() const { return fileSize; }
+
+    // Copies up to len bytes at offset into out, returns false on a short read
+    bool read(uint64_t offset, size_t len, std::string& out) const {
+        out.clear();
+        if (offset >= fileSize || len > fileSize - offset) {
+            return false;
+        }
+        if (offset + len <= head.size()) {
+            out.assign(head, static_cast<size_t>(offset), len);
+            return true;
+        }
+        out.resize(len);
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = pread(fd, &out[done], len - done, static_cast<off_t>(offset + done));
+            if (n <= 0) {
+                out.clear();
+                return false;
+            }
+            done += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+private:
+    int fd = -1;
+    uint64_t fileSize = 0;
+    std::string head;
+};
+
+#endif // FILE_WINDOW_HPP
@@ -0,0 +1,147 @@
+#ifndef LIBRARY_HPP
+#define LIBRARY_HPP
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "libraryIndex.hpp"
+
+// In-memory library for one session, copied out of library.idx once at startup.
+// Ids are the index's own: tracks are in artist / album / disc / track order, so
+// every artist and album owns the contiguous span [firstTrack, firstTrack + trackCount).
+// Nothing here touches the disk after load().
+
+struct LibraryTrack {
+    std::string title;
+    std::string path;      // songs directory + file name, ready for playback
+    std::string genre;
+    std::string date;
+    std::string duration;  // "mm:ss", formatted once at load
+    uint32_t artist;
+    uint32_t album;
+    uint32_t disc;
+    uint32_t number;
+    uint32_t durationMs;
+    uint32_t lyricsLength; // 0 without lyrics; the text stays in lyrics.dat until the lyrics view reads it
+    uint64_t lyricsOffset;
+    uint64_t inode;        // survives renames and rescans, unlike the id
+    float loudness;        // LUFS / sample peak from a --loudness scan, NaN when not measured
+    float peak;
+};
+
+struct LibraryAlbum {
+    std::string name;
+    std::string year;  // first four characters of the album's date tag
+    uint32_t artist;
+    uint32_t firstTrack;
+    uint32_t trackCount;
+    float loudness;
+    float peak;
+};
+
+struct LibraryArtist {
+    std::string name;
+    uint32_t firstAlbum;
+    uint32_t albumCount;
+    uint32_t firstTrack;
+    uint32_t trackCount;
+};
+
+// What the left pane lists; the song pane shows the tracks of the group under its cursor.
+// Playlist is the only view not built by load(): its groups are the smart playlists, set
+// (and set again after every rescan) through setPlaylists
+enum class BrowseMode { Artist, Album, Genre, Year, Playlist };
+const size_t BROWSE_MODE_COUNT = 5;
+
+// A header row of the song pane and the tracks under it: [first, first + count) of the view's tracks.
+// key is an album id, or the year in the Year view (0 when undated)
+struct BrowseSection {
+    uint32_t key;
+    uint32_t first;
+    uint32_t count;
+};
+
+// A row of the left pane. key is an artist, album or genre id, the decade in the Year view, or
+// the playlist's position
+struct BrowseGroup {
+    uint32_t key;
+    uint32_t first;         // its span of the view's tracks
+    uint32_t count;
+    uint32_t firstSection;  // its span of the view's sections
+    uint32_t sectionCount;
+    uint32_t titleWidth;    // column the song pane's durations line up at
+};
+
+// One browse mode, computed when the library loads: track ids cut into groups, and groups
+// into sections. Switching modes or groups only points the lists at these spans, and row
+// text is made from the keys for the rows on screen only.
+struct BrowseView {
+    std::vector<uint32_t> tracks;  // group after group
+    std::vector<BrowseSection> sections;
+    std::vector<BrowseGroup> groups;  // left pane order
+};
+
+class Library {
+public:
+    bool load(const LibraryIndex& index, const std::string& songsDirectory);
+
+    uint32_t trackCount() const { return static_cast<uint32_t>(tracks.size()); }
+    uint32_t artistCount() const { return static_cast<uint32_t>(artists.size()); }
+    uint32_t albumCount() const { return static_cast<uint32_t>(albums.size()); }
+
+    const LibraryTrack& track(uint32_t id) const { return tracks[id]; }
+    const LibraryAlbum& album(uint32_t id) const { return albums[id]; }
+    const LibraryArtist& artist(uint32_t id) const { return artists[id]; }
+
+    // Artist menu order (artists.json order): names, and the artist id behind each row
+    const std::vector<std::string>& artistNames() const { return menuNames; }
+    uint32_t artistIdAt(uint32_t position) const { return menuOrder[position]; }
+    uint32_t artistPosition(uint32_t id) const { return menuPositions[id]; }
+
+    // Artist groups follow the menu order above, so group i of the Artist view is menu row i
+    const BrowseView& view(BrowseMode mode) const { return views[static_cast<size_t>(mode)]; }
+    std::string groupName(BrowseMode mode, const BrowseGroup& group) const;
+    // The same texts appended to `text`, for list rows drawn into a reused string
+    void appendGroupName(BrowseMode mode, const BrowseGroup& group, std::string& text) const;
+    void appendSectionLabel(BrowseMode mode, const BrowseSection& section, std::string& text) const;
+
+    // Smart playlist groups: names[i] and its matching track ids, ascending
+    void setPlaylists(const std::vector<std::string>& names, const std::vector<std::vector<uint32_t>>& matches);
+
+    // O(1) per-track lookups
+    const std::string& trackArtist(uint32_t id) const { return artists[tracks[id].artist].name; }
+    const std::string& trackGenre(uint32_t id) const { return tracks[id].genre; }
+
+    // The columns the Genre and Year views are cut by: genres merged across case (named by the
+    // first spelling met), years from the track date or else the album's, 0 when undated
+    uint32_t genreCount() const { return static_cast<uint32_t>(genreNames.size()); }
+    const std::string& genreName(uint32_t genre) const { return genreNames[genre]; }
+    uint32_t trackGenreId(uint32_t id) const { return trackGenres[id]; }
+    uint32_t trackYear(uint32_t id) const { return trackYears[id]; }
+
+private:
+    void buildViews();
+    void setTitleWidths(BrowseView& view) const;
+
+    std::vector<LibraryTrack> tracks;
+    std::vector<LibraryAlbum> albums;
+    std::vector<LibraryArtist> artists;
+    std::vector<uint32_t> menuOrder;
+    std::vector<uint32_t> menuPositions;  // inverse of menuOrder
+    std::vector<std::string> menuNames;
+    std::array<BrowseView, BROWSE_MODE_COUNT> views;
+    std::vector<std::string> genreNames;  // Genre view keys
+    std::vector<uint32_t> trackGenres;
+    std::vector<uint32_t> trackYears;
+    std::vector<std::string> playlistNames;  // Playlist view keys
+
+};
+
+// Opens library.idx and copies it into `library`; false when missing, corrupt or empty
+bool loadLibraryFile(Library& library, const std::string& indexFilePath, const std::string& songsDirectory);
+
+// Id in `to` of every track id of `from`, matched by inode; INDEX_NOT_FOUND for tracks that are gone
+std::vector<uint32_t> mapTrackIds(const Library& from, const Library& to);
+
+#endif // LIBRARY_HPP
@@ -0,0 +1,115 @@
+#ifndef LIBRARY_INDEX_HPP
+#define LIBRARY_INDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// On-disk layout of info/library.idx, written by lmus_cache_main next to song_names.json.
+// Everything is fixed width and little endian; strings live in one heap at the end of the file.
+// Tracks are stored in artist / album / disc / track order, so every artist and album
+// owns a contiguous [firstTrack, firstTrack + trackCount) span.
+
+const char LIBRARY_INDEX_MAGIC[8] = {'L', 'M', 'U', 'S', 'I', 'D', 'X', '\0'};
+const uint32_t LIBRARY_INDEX_VERSION = 5;
+
+struct IndexString {
+    uint32_t offset;  // into the string heap
+    uint32_t length;
+};
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t trackCount;
+    uint32_t artistCount;
+    uint32_t albumCount;
+    uint64_t artistsOffset;      // IndexArtist[artistCount], sorted by name
+    uint64_t artistOrderOffset;  // uint32_t[artistCount], artist ids in artists.json order
+    uint64_t albumsOffset;       // IndexAlbum[albumCount], grouped by artist, sorted by name
+    uint64_t tracksOffset;       // IndexTrack[trackCount]
+    uint64_t heapOffset;
+    uint64_t heapSize;
+};
+
+struct IndexArtist {
+    IndexString name;
+    uint32_t firstAlbum;
+    uint32_t albumCount;
+    uint32_t firstTrack;
+    uint32_t trackCount;
+};
+
+struct IndexAlbum {
+    IndexString name;
+    IndexString date;  // date tag of the album's first track
+    uint32_t artist;
+    uint32_t firstTrack;
+    uint32_t trackCount;
+    float loudness;       // LUFS over the album's tracks, NaN when not measured
+    float peak;
+    uint32_t reserved;
+};
+
+struct IndexTrack {
+    IndexString title;
+    IndexString fileName;
+    IndexString genre;
+    IndexString date;
+    uint32_t artist;
+    uint32_t album;
+    uint32_t disc;
+    uint32_t track;
+    uint64_t inode;
+    uint64_t lyricsOffset;  // entry in lyrics.dat (lyricsStore.hpp)
+    uint32_t durationMs;    // 0 when unknown
+    float loudness;         // integrated LUFS, NaN when not measured
+    float peak;             // sample peak, NaN when not measured
+    uint32_t lyricsLength;  // 0 when the song has no lyrics
+};
+
+const uint32_t INDEX_NOT_FOUND = UINT32_MAX;
+
+// Read-only mmap of library.idx. Opening validates the header and bounds,
+// every lookup afterwards is pointer arithmetic (no parsing, no allocation).
+class LibraryIndex {
+public:
+    LibraryIndex() = default;
+    ~LibraryIndex();
+    LibraryIndex(const LibraryIndex&) = delete;
+    LibraryIndex& operator=(const LibraryIndex&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return base != nullptr; }
+
+    uint32_t trackCount() const { return header->trackCount; }
+    uint32_t artistCount() const { return header->artistCount; }
+    uint32_t albumCount() const { return header->albumCount; }
+
+    const IndexArtist& artist(uint32_t id) const { return artists[id]; }
+    const IndexAlbum& album(uint32_t id) const { return albums[id]; }
+    const IndexTrack& track(uint32_t id) const { return tracks[id]; }
+    // Artist id at position i of the artist menu (artists.json order)
+    uint32_t artistAt(uint32_t position) const { return artistOrder[position]; }
+
+    std::string_view str(const IndexString& s) const {
+        if (static_cast<uint64_t>(s.offset) + s.length > heapSize) {
+            return std::string_view(); // corrupt reference, never read past the mapping
+        }
+        return std::string_view(heap + s.offset, s.length);
+    }
+
+private:
+    void* base = nullptr;
+    size_t mappedSize = 0;
+    const IndexHeader* header = nullptr;
+    const IndexArtist* artists = nullptr;
+    const uint32_t* artistOrder = nullptr;
+    const IndexAlbum* albums = nullptr;
+    const IndexTrack* tracks = nullptr;
+    const char* heap = nullptr;
+    uint64_t heapSize = 0;
+};
+
+#endif // LIBRARY_INDEX_HPP
@@ -0,0 +1,45 @@
+#ifndef LIBRARY_REFRESH_HPP
+#define LIBRARY_REFRESH_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "library.hpp"
+#include "lmus_cache.hpp"
+
+// Verifies the library behind a session that opened from the last cache snapshot.
+// The cache pass (scan, diff, probing whatever changed) runs on its own thread, and when it
+// rewrote library.idx the new Library is loaded there as well: the UI thread only swaps a
+// finished object in, between two iterations of its loop.
+class LibraryRefresh {
+public:
+    // Runs lmus_cache_main quietly, filling the summary, and gives up once `cancel` is set
+    using ScanJob = std::function<void(CacheSummary&, const std::atomic<bool>& cancel)>;
+
+    LibraryRefresh() = default;
+    ~LibraryRefresh();  // cancels a scan still running and waits for it to stop
+    LibraryRefresh(const LibraryRefresh&) = delete;
+    LibraryRefresh& operator=(const LibraryRefresh&) = delete;
+
+    void start(ScanJob scan, const std::string& indexFilePath, const std::string& songsDirectory);
+
+    // UI thread: true once, after the scan finished; `library` stays null when nothing
+    // changed, the rewritten index could not be read or the scan failed (summary.error)
+    bool take(std::unique_ptr<Library>& library, CacheSummary& summary);
+
+    // Runs on the refresh thread once take() has something
+    std::function<void()> onFinished;
+
+private:
+    std::thread worker;
+    std::atomic<bool> cancelled{false};
+    std::mutex mutex;
+    bool finished = false;
+    std::unique_ptr<Library> fresh;
+    CacheSummary result;
+};
+
+#endif // LIBRARY_REFRESH_HPP
@@ -0,0 +1,60 @@
+#ifndef LIST_VIEW_HPP
+#define LIST_VIEW_HPP
+
+#include <ncurses.h>
+#include <functional>
+#include <string>
+
+// Scrolling list drawn inside a boxed window, replacing the ncurses MENU + ITEM arrays.
+// The list owns no rows: it keeps a cursor and the first visible row, and asks the
+// row source for the text of the rows currently on screen only, so a list over a
+// 2k-track artist costs the same to build and draw as one over ten.
+class ListView {
+public:
+    // `text` appends a row's text to the string it is given, which the list clears and reuses
+    // between rows so drawing allocates nothing once it has grown. `selectable` says whether the
+    // cursor may stop on a row (album headers are skipped); left empty, every row is selectable.
+    // Moving the cursor only asks `selectable`, never for text.
+    struct RowSource {
+        std::function<void(size_t row, std::string& text)> text;
+        std::function<bool(size_t row)> selectable;
+    };
+
+    void attach(WINDOW* window) { win = window; }
+    WINDOW* window() const { return win; }
+
+    // New contents; the cursor goes to the first selectable row
+    void setRows(size_t count, RowSource rowSource);
+    size_t cursor() const { return cur; }
+
+    // Puts the cursor on row (scrolled into view); false when row is out of range or not selectable
+    bool setCursor(size_t row);
+    // Next / previous selectable row; false when there is none
+    bool moveDown();
+    bool moveUp();
+
+    // Same roles as set_menu_fore / set_menu_back / set_menu_grey
+    void setFore(chtype attr) { fore = attr; }
+    void setBack(chtype attr) { back = attr; }
+    void setGrey(chtype attr) { grey = attr; }
+
+    // Draws the visible rows between the title line and the bottom border
+    void draw();
+
+private:
+    bool selectable(size_t row) const;
+    int visibleRows() const;
+    void scrollToCursor();
+
+    WINDOW* win = nullptr;
+    size_t count = 0;
+    size_t cur = 0;
+    size_t top = 0;
+    RowSource source;
+    chtype fore = A_REVERSE;
+    chtype back = A_NORMAL;
+    chtype grey = A_UNDERLINE;
+    std::string scratch;
+};
+
+#endif // LIST_VIEW_HPP
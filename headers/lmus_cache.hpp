@@ -6,28 +6,116 @@
 #include <unistd.h>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <sstream>
+#include <iomanip>
 #include <fstream>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <functional>
 #include "nlohmann/json.hpp"
 #include "exitError.h"
 #include "executeCmd.h"
 #include "directoryUtils.hpp"
+#include "dirScanner.hpp"
+#include "concurrentQueue.hpp"
+#include "tagReader.hpp"
+#include "libraryIndex.hpp"
+#include "lyricsIndex.hpp"
+#include "lyricsStore.hpp"
+#include "audioHeaders.hpp"
+#include "loudness.hpp"
+#include "seekIndex.hpp"
+#include <SFML/Audio.hpp>
 
 using json = nlohmann::json;
 using namespace std;
 
+struct SongMetadata {
+    string fileName;
+    string inode;
+    string artist;
+    string album;
+    string title;
+    int disc;
+    int track;
+    string genre;
+    string date;
+    string lyrics;  // freshly extracted text; cached songs leave theirs in lyrics.dat
+    uint32_t durationMs;
+    float loudness;  // integrated LUFS, LOUDNESS_NOT_MEASURED until a --loudness pass
+    float peak;      // sample peak; set (0 when undecodable) once the pass has looked at the file
+    uint64_t lyricsOffset = 0;  // entry in lyrics.dat, set when storeLyricsFile writes it
+    uint32_t lyricsLength = 0;
+};
+
+// How storeLyricsFile filled the new lyrics.dat
+struct LyricsStoreStats {
+    size_t copied = 0;   // entries carried over byte for byte from the previous file
+    size_t written = 0;  // entries written from freshly extracted text
+};
+
+// durationMs of a song_names.json entry written before durations were cached
+const uint32_t DURATION_NOT_CACHED = UINT32_MAX;
+
+// One entry of song_cache_info.json
+struct InodeSnapshot {
+    string inode;
+    long long size;
+    long long mtime;
+};
+
+// A long mp3 whose seek table is missing or stale
+struct SeekIndexJob {
+    string path;  // songDirectory joined with the file name
+    uint64_t inode;
+};
+
+// What changed between the previous snapshot and the current scan
+// added / modified hold indices into the scanned records
+struct CacheDiff {
+    vector<size_t> added;
+    vector<size_t> modified;
+    vector<string> removed;
+
+    bool empty() const { return added.empty() && modified.empty() && removed.empty(); }
+};
+
+// What a cache run changed; `changed` is set once library.idx was rewritten
+struct CacheSummary {
+    size_t added = 0;
+    size_t modified = 0;
+    size_t removed = 0;
+    bool changed = false;
+    string error;  // why a quiet run stopped short of writing the cache, empty when it did not
+};
+
 // Function declarations
-vector<string> getInodes();
-string getFileNameFromInode(const string& inode);
-vector<string> loadPreviousInodes(const string& filePath);
-void storeMetadataJSON(const string& fileName, json& artistsArray, json& songsInfoArray, const std::string debugFile);
-void saveArtistsToFile(const json& artistsArray, const string& filePath);
-void saveSongDirToFile(const std::string& songDirPath, const string& songDirectory);
+vector<InodeSnapshot> loadPreviousInodes(const string& filePath);
+bool saveCurrentInodes(const vector<FileRecord>& records, const string& filePath);
+CacheDiff diffInodeSnapshots(const vector<FileRecord>& records, const vector<InodeSnapshot>& previous);
+vector<SongMetadata> loadCachedSongs(const string& filePath);
+bool storeLyricsFile(const string& filePath, vector<SongMetadata>& songMetadata, LyricsStoreStats& stats);
+void storeLyricsSearchIndex(const string& filePath, const string& lyricsFilePath, const vector<SongMetadata>& songMetadata);
+void sortSongMetadata(vector<SongMetadata>& songMetadata);
+bool storeLibraryIndex(const string& filePath, const vector<SongMetadata>& songMetadata, const json& artistsArray);
+bool runOnWorkers(size_t count, unsigned int jobs, const function<void(size_t)>& work, const function<void(size_t, size_t)>& onDone, const atomic<bool>* cancel = nullptr);
+function<void(size_t, size_t)> progressLine(ostream& log, const string& label, size_t total, const string& noun);
+vector<SongMetadata> extractSongs(const vector<FileRecord>& records, const vector<size_t>& indices, const string& songDirectory, unsigned int jobs, const string& debugFile, bool showProgress, const atomic<bool>* cancel = nullptr);
+void measureSongsLoudness(vector<SongMetadata>& songs, const vector<size_t>& indices, const string& songDirectory, unsigned int jobs, ostream& log, const atomic<bool>* cancel = nullptr);
+bool wantsSeekIndex(const string& fileName, uint32_t durationMs);
+void buildSeekIndexes(const vector<SeekIndexJob>& pending, const string& seekDirectory, unsigned int jobs, ostream& log, const atomic<bool>* cancel = nullptr);
+SongMetadata storeMetadataJSON(const string& inode, const string& songDirectory, const string& fileName, string& logText);
+unsigned int defaultJobCount();
+bool saveArtistsToFile(const json& artistsArray, const string& filePath);
+bool saveSongDirToFile(const std::string& songDirPath, const string& songDirectory);
 void printArtists(const json& artistsArray);
 void storeSongCountAndInodes(const string& infoDirectory, int songCount, const vector<string>& inodes, const vector<string>& songNames, const json& songsInfoArray);
-void storeSongsJSON(const string& filePath, const vector<string>& songNames);
-bool compareInodeVectors(const vector<string>& vec1, const vector<string>& vec2);
-int lmus_cache_main(std::string& songDirectory, const std::string homeDir, const std::string cacheLitemusDirectory, const std::string configLitemusDirectory, const std::string cacheInfoDirectory, const std::string songCacheInfoFile, const std::string artistsFilePath, const std::string songDirPathCache, const std::string debugFile);
+bool storeSongsJSON(const string& filePath, const vector<SongMetadata>& songMetadata, const string debugFile, ostream& log);
+int lmus_cache_main(std::string& songDirectory, const std::string homeDir, const std::string cacheLitemusDirectory, const std::string configLitemusDirectory, const std::string cacheInfoDirectory, const std::string songCacheInfoFile, const std::string artistsFilePath, const std::string songDirPathCache, const std::string debugFile, unsigned int jobs, bool analyzeLoudness, bool quiet, CacheSummary* summary, const std::atomic<bool>* cancel = nullptr);
 
 #endif // MAIN_HPP
@@ -0,0 +1,55 @@
+#ifndef LOOP_EVENTS_HPP
+#define LOOP_EVENTS_HPP
+
+#include <cstdint>
+#include <vector>
+
+// What woke the main loop up, as a bitmask returned by LoopEvents::wait()
+const unsigned int LOOP_EVENT_INPUT = 1u << 0;      // stdin readable (or a signal such as SIGWINCH)
+const unsigned int LOOP_EVENT_TICK = 1u << 1;       // progress timer fired
+const unsigned int LOOP_EVENT_TRACK_END = 1u << 2;  // the decoder ran out of data
+const unsigned int LOOP_EVENT_HANGUP = 1u << 3;     // the terminal went away
+const unsigned int LOOP_EVENT_LOADED = 1u << 4;     // the track loader finished a request
+const unsigned int LOOP_EVENT_CONTROL = 1u << 5;    // one of the watched control descriptors is readable
+const unsigned int LOOP_EVENT_LIBRARY = 1u << 6;    // the background library scan finished
+
+// The main loop sleeps in poll() on stdin, a timerfd for the playback progress tick
+// and eventfds the audio thread signals when a track runs out, the track loader when a
+// file is open and the background library scan when it is done, so an idle session
+// costs no CPU at all and nothing is redrawn unless one of these fired. A headless loop
+// (the daemon) leaves stdin out and watches its control socket instead.
+class LoopEvents {
+public:
+    LoopEvents() = default;
+    ~LoopEvents();
+    LoopEvents(const LoopEvents&) = delete;
+    LoopEvents& operator=(const LoopEvents&) = delete;
+
+    bool open(bool watchInput = true);
+
+    // Extra descriptors (sockets, signalfd) reported together as LOOP_EVENT_CONTROL; the
+    // owner reads them itself. Replaces the previous set
+    void watchControl(const std::vector<int>& fds);
+
+    // Blocks until at least one event is pending, consumes it and reports which fired
+    unsigned int wait();
+
+    // Periodic tick, 0 disarms it; a no-op when the interval is unchanged
+    void setTickInterval(unsigned int milliseconds);
+
+    // Safe to call from any thread (a single eventfd write)
+    void notifyTrackEnd();
+    void notifyLoaded();
+    void notifyLibrary();
+
+private:
+    int timerFd = -1;
+    int wakeFd = -1;
+    int loadedFd = -1;
+    int libraryFd = -1;
+    unsigned int tickInterval = 0;
+    bool input = true;
+    std::vector<int> controlFds;
+};
+
+#endif // LOOP_EVENTS_HPP
@@ -0,0 +1,61 @@
+#ifndef LOUDNESS_HPP
+#define LOUDNESS_HPP
+
+#include <SFML/Audio.hpp>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// EBU R128 / ITU-R BS.1770-4 loudness, measured at scan time (`--loudness`) and applied
+// at playback as a ReplayGain 2.0 style gain stage.
+
+// Stored as NaN wherever a track or album was never measured
+const float LOUDNESS_NOT_MEASURED = NAN;
+// ReplayGain 2.0 reference level
+const float LOUDNESS_TARGET_LUFS = -18.f;
+
+// Which loudness the playback gain stage follows (`--normalize`); auto uses album gain
+// while the queue plays in order and track gain while it is shuffled
+enum class NormalizeMode { Off, Track, Album, Auto };
+
+struct LoudnessResult {
+    float integratedLufs = LOUDNESS_NOT_MEASURED;
+    float peak = LOUDNESS_NOT_MEASURED;  // sample peak, 1.0 is full scale
+};
+
+// K-weighted mean square over 400 ms blocks (100 ms hop) with the absolute -70 LUFS
+// and relative -10 LU gates. The two K-weighting biquads keep one channel pair per SSE2
+// register, so a stereo frame is filtered with a single pass of vector ops.
+class LoudnessMeter {
+public:
+    LoudnessMeter(unsigned int channelCount, unsigned int sampleRate);
+
+    void addFrames(const sf::Int16* samples, size_t frameCount);
+    LoudnessResult finish() const;
+
+private:
+    void closeSubBlock();
+
+    unsigned int channels;
+    size_t subBlockFrames;               // 100 ms
+    size_t framesInSubBlock = 0;
+    double shelf[5];                     // b0 b1 b2 a1 a2 of the high shelf stage
+    double highPass[5];                  // same for the high pass stage
+    std::vector<double> state;           // per channel: shelf z1 z2, high pass z1 z2
+    std::vector<double> squares;         // per channel, current sub-block
+    std::vector<double> weights;         // BS.1770 channel weights
+    std::vector<double> subBlockEnergy;  // weighted sum of squares of every closed sub-block
+    int peak = 0;
+};
+
+// Decodes the whole file; false when it cannot be opened or holds no audio
+bool measureLoudness(const std::string& filePath, LoudnessResult& result);
+
+// Duration weighted power mean of the tracks' loudness; NaN when none was measured
+float combineLoudness(const std::vector<float>& lufs, const std::vector<uint32_t>& durationsMs);
+
+// Linear gain bringing `lufs` to the target, lowered so `peak` never clips; 1 when unmeasured
+float normalizationGain(float lufs, float peak);
+
+#endif // LOUDNESS_HPP
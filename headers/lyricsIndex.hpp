@@ -0,0 +1,89 @@
+#ifndef LYRICS_INDEX_HPP
+#define LYRICS_INDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Inverted index over the embedded lyrics, info/lyrics.idx next to library.idx.
+// Its tracks are the entries of lyrics.dat, each with its inode: the session maps them onto
+// library ids by inode, so lmus_cache_main only rebuilds it when the lyrics themselves change.
+// Lyrics are folded like the library search (foldSearchText) and split into words; every
+// distinct word is a term whose postings list the tracks it occurs in, each with the word
+// positions inside that track's lyrics, so a phrase is matched positionally. Postings are
+// varint coded (track id deltas, then a byte length and the position deltas per track) and
+// the session maps the file: a search reads only the postings of the query's own terms.
+// Little endian like library.idx.
+
+const char LYRICS_INDEX_MAGIC[8] = {'L', 'M', 'U', 'S', 'L', 'Y', 'R', '\0'};
+const uint32_t LYRICS_INDEX_VERSION = 1;
+
+struct LyricsIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t trackCount;
+    uint32_t termCount;
+    uint32_t reserved;
+    uint64_t inodesOffset;    // uint64_t[trackCount], what ties each track to the library
+    uint64_t termsOffset;     // LyricsTerm[termCount], sorted by text
+    uint64_t postingsOffset;
+    uint64_t postingsSize;
+    uint64_t heapOffset;      // term texts
+    uint64_t heapSize;
+};
+
+struct LyricsTerm {
+    uint32_t textOffset;
+    uint32_t textLength;
+    uint32_t trackCount;      // tracks whose lyrics contain the term
+    uint32_t postingsLength;
+    uint64_t postingsOffset;  // into the postings block
+};
+
+struct LyricsMatch {
+    uint32_t track;
+    uint32_t occurrences;  // of the whole phrase
+};
+
+// Folded words of a text, in order: what the index stores and what a query is split into
+std::vector<std::string> lyricsTerms(const std::string& text);
+
+// Cache side: lyrics[i] and inodes[i] become track i; written to a temporary file and renamed
+// like the library index
+bool storeLyricsIndex(const std::string& path, const std::vector<std::string_view>& lyrics, const std::vector<uint64_t>& inodes);
+
+// Read-only mmap of lyrics.idx, validated on open
+class LyricsIndex {
+public:
+    LyricsIndex() = default;
+    ~LyricsIndex();
+    LyricsIndex(const LyricsIndex&) = delete;
+    LyricsIndex& operator=(const LyricsIndex&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return base != nullptr; }
+
+    uint32_t trackCount() const { return header->trackCount; }
+    uint64_t trackInode(uint32_t track) const { return inodes[track]; }
+
+    // Tracks whose lyrics hold the words of `phrase` one after the other, most occurrences
+    // first. The last word also matches longer words (typing "lov" finds "love"), so results
+    // show up while it is still being typed
+    std::vector<LyricsMatch> findPhrase(const std::string& phrase, size_t limit) const;
+
+private:
+    std::string_view termText(const LyricsTerm& term) const { return std::string_view(heap + term.textOffset, term.textLength); }
+    bool termValid(const LyricsTerm& term) const;
+
+    void* base = nullptr;
+    size_t mappedSize = 0;
+    const LyricsIndexHeader* header = nullptr;
+    const uint64_t* inodes = nullptr;
+    const LyricsTerm* terms = nullptr;
+    const uint8_t* postings = nullptr;
+    const char* heap = nullptr;
+};
+
+#endif // LYRICS_INDEX_HPP
@@ -0,0 +1,39 @@
+#ifndef LYRICS_PANE_HPP
+#define LYRICS_PANE_HPP
+
+#include <ncurses.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The lyrics view: the playing song's lyrics drawn over the artist pane, with the warning box
+// listing the keys that still work. It lives inside the main loop like the search pane (keys
+// are fed to it while it is open), so playback, the queue, a loaded track starting and a
+// library swap all carry on while the user reads.
+class LyricsPane {
+public:
+    // Shows `lyrics` over `parent`, scrolled to the top; also replaces what an open pane shows
+    void open(WINDOW* parent, const std::string& lyrics, const std::string& song, const std::string& artist);
+    void close();
+    bool active() const { return win != nullptr; }
+
+    // Up / Down (j / k) scroll and 1 closes; false for every other key
+    bool handleKey(int ch);
+
+    // Also called after the panels underneath were redrawn, the pane goes back on top
+    void draw(const std::unordered_map<std::string, int>& keybinds);
+    void resize();
+
+private:
+    void place();
+
+    WINDOW* parent = nullptr;
+    WINDOW* win = nullptr;         // lyrics, inside the parent's border
+    WINDOW* warningWin = nullptr;
+    std::vector<std::string> lines;
+    std::string song;
+    std::string artist;
+    int startLine = 0;
+};
+
+#endif // LYRICS_PANE_HPP
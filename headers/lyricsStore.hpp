@@ -0,0 +1,27 @@
+#ifndef LYRICS_STORE_HPP
+#define LYRICS_STORE_HPP
+
+#include <cstdint>
+#include <string>
+
+// info/lyrics.dat: the embedded lyrics of every cached song, kept out of song_names.json and
+// library.idx so neither the cache pass nor the session start parses or copies them.
+// After the header, each song with lyrics has one entry: its inode (uint64_t, little endian)
+// followed by the text. The song's metadata only holds the entry offset and the text length;
+// the lyrics view reads an entry with a single pread, and its inode tells a rewritten file
+// from the one the session's library was loaded with.
+
+const char LYRICS_STORE_MAGIC[8] = {'L', 'M', 'U', 'S', 'L', 'Y', 'B', '\0'};
+const uint32_t LYRICS_STORE_VERSION = 1;
+
+struct LyricsStoreHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+// Entry at `offset` into `lyrics`; false when the file is gone, short, or the entry is not
+// `inode`'s any more
+bool readLyrics(const std::string& path, uint64_t offset, uint32_t length, uint64_t inode, std::string& lyrics);
+
+#endif // LYRICS_STORE_HPP
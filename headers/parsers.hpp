@@ -9,19 +9,27 @@
 #include <sstream>
 #include <cctype>
 #include <nlohmann/json.hpp>
+#include "library.hpp"
+#include "loudness.hpp"
 
 using namespace std;
 
-std::vector<std::string> parseArtists(const std::string& artistsFile);
-std::tuple<std::vector<std::string>, std::vector<std::string>, std::vector<std::string>, std::vector<std::string>, std::vector<std::string>> listSongs(const std::string& cacheFile, const std::string& artistName, const std::string& songsDirectory); 
-std::pair<std::string, std::string> findCurrentGenreArtist(const std::string& cacheFile, const std::string& currentSong, std::string& currentLyrics);
+uint32_t groupRowCount(const BrowseView& view, uint32_t group);
+uint32_t groupRowTrack(const BrowseView& view, uint32_t group, uint32_t row, uint32_t& section);
+uint32_t groupTrackRow(const BrowseView& view, uint32_t group, uint32_t position);
+std::string formatDuration(uint32_t durationMs);
+std::pair<std::string, std::string> findCurrentGenreArtist(const Library& library, uint32_t trackId);
 std::vector<std::string> splitStringByNewlines(const std::string& str);
 std::string get_home_directory();
 std::string read_file_to_string(const std::string& path);
 void litemusHelper(const std::string& NC);
-std::vector<std::string> getTitlesWithWhiteSpaces(const std::vector<std::string>& songTitles, const std::vector<std::string>& songDurations, size_t maxLength);
-size_t getMaxSongTitleLength(const std::vector<std::string>& songTitles, const std::vector<std::string>& songDurations);
+std::string getRequiredWhitespaces(const std::string& title, size_t maxLength);
 std::string removeWhitespace(const std::string& str);
+unsigned int extractJobsOption(int& argc, char* argv[]);
+float extractBufferSecondsOption(int& argc, char* argv[], float fallback);
+uint32_t extractTrackCacheOption(int& argc, char* argv[], uint32_t fallback);
+bool extractFlagOption(int& argc, char* argv[], const std::string& flag);
+NormalizeMode extractNormalizeOption(int& argc, char* argv[]);
 void verboseQuit(const std::string& NC, const std::string& BLUE, const std::string& BOLD);
 
 #endif
@@ -0,0 +1,68 @@
+#ifndef PLAY_QUEUE_HPP
+#define PLAY_QUEUE_HPP
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include "library.hpp"
+
+// Playback order for the session, independent of whatever artist the menus show.
+// Tracks are keyed by library track id and appear at most once. The queue is a circular
+// doubly linked list kept in two arrays indexed by track id, so next / prev, append,
+// insert-next and remove are all O(1) without any allocation per track.
+// Shuffle walks a permutation of the queued ids computed up front; the current track sits
+// at its start so a full cycle plays every other track once before anything repeats.
+class PlayQueue {
+public:
+    explicit PlayQueue(uint32_t trackCount);
+
+    // Enter on a song: the queue becomes trackIds, playing from currentTrackId
+    void replace(const std::vector<uint32_t>& trackIds, uint32_t currentTrackId);
+    bool append(uint32_t trackId);      // false when already queued
+    bool insertNext(uint32_t trackId);  // moves an already queued track instead
+    bool remove(uint32_t trackId);
+    void clear();
+
+    bool empty() const { return count == 0; }
+    uint32_t size() const { return count; }
+    bool contains(uint32_t trackId) const { return trackId < nextLink.size() && nextLink[trackId] != INDEX_NOT_FOUND; }
+
+    // INDEX_NOT_FOUND when the queue is empty; both directions wrap around
+    uint32_t current() const { return currentId; }
+    uint32_t peekNext() const;
+    uint32_t peekPrevious() const;
+    uint32_t advance();
+    uint32_t retreat();
+    bool setCurrent(uint32_t trackId);
+
+    bool shuffled() const { return shuffle; }
+    void setShuffle(bool on);
+
+    // queue.json in the cache dir. Ids are checked against the tracks' inodes on load and
+    // re-resolved by inode after a rescan renumbered the library; vanished tracks are dropped
+    bool save(const std::string& filePath, const Library& library) const;
+    bool load(const std::string& filePath, const Library& library);
+
+    // The session swapped in a rescanned library of trackCount tracks: every id becomes
+    // newIds[id] (see mapTrackIds), vanished tracks drop out, order and shuffle are kept
+    void remap(const std::vector<uint32_t>& newIds, uint32_t trackCount);
+
+private:
+    void link(uint32_t trackId, uint32_t after);
+    void unlink(uint32_t trackId);
+    void reshuffle();
+    void renumberFrom(size_t position);
+
+    std::vector<uint32_t> nextLink;    // per track id, INDEX_NOT_FOUND when not queued
+    std::vector<uint32_t> prevLink;
+    std::vector<uint32_t> orderPos;    // per track id, position in `order` while shuffled
+    std::vector<uint32_t> order;       // shuffle permutation, order[orderPos[id]] == id
+    uint32_t head = INDEX_NOT_FOUND;   // first track in queue order, where save() starts
+    uint32_t currentId = INDEX_NOT_FOUND;
+    uint32_t count = 0;
+    bool shuffle = false;
+    std::mt19937 rng{std::random_device{}()};
+};
+
+#endif // PLAY_QUEUE_HPP
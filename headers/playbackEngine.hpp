@@ -0,0 +1,177 @@
+#ifndef PLAYBACK_ENGINE_HPP
+#define PLAYBACK_ENGINE_HPP
+
+#include <SFML/Audio.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "seekIndex.hpp"
+#include "spscRing.hpp"
+#include "trackLoader.hpp"
+
+const float DEFAULT_DECODE_AHEAD_SECONDS = 4.f;
+
+// One open track on the decode thread. After a seek through the track's seek index the
+// decoder reads a slice of the file, so it does not know the track's real length: the
+// totals are kept from when the whole file was opened.
+struct TrackDecoder {
+    std::unique_ptr<sf::InputSoundFile> file;  // declared first: always replaced before its stream
+    std::unique_ptr<sf::InputStream> stream;   // what `file` reads when not the file itself
+    bool sliced = false;                       // stream is a FileSliceStream, else cached bytes
+    std::shared_ptr<const SeekIndex> seekIndex;
+    std::string path;
+    uint64_t sampleCount = 0;                  // of the whole track, interleaved
+    sf::Time duration;
+    float gain = 1.f;                          // loudness normalization
+
+    TrackDecoder() = default;
+    TrackDecoder(TrackDecoder&&) = default;
+    TrackDecoder& operator=(TrackDecoder&&) = default;
+    ~TrackDecoder() { file.reset(); }
+    explicit operator bool() const { return file != nullptr; }
+    void reset() {
+        file.reset();
+        stream.reset();
+        sliced = false;
+        seekIndex.reset();
+    }
+};
+
+// Gapless replacement for sf::Music.
+// One sf::SoundStream stays open across tracks: during the last PRELOAD_SECONDS of the
+// playing track a TrackLoader opens the queued next track and decodes its first second,
+// and when the current decoder runs dry the next track's samples continue in the very
+// same decoded block, so the output never stops between album tracks.
+// Decoding happens on a dedicated thread that keeps a lock-free ring filled with
+// decodeAheadSeconds of PCM; SFML's streaming thread only copies out of that ring, so
+// a slow disk or network mount has that much time to catch up before anything is heard.
+// The stream keeps a single time line, so the engine remembers where in it the audible
+// track started; update() moves that origin once playback actually crosses the splice.
+// Tracks whose sample rate / channel count differ from the current one cannot share the
+// stream: the stream then ends normally and the caller starts the next track itself.
+// Long mp3s loaded with a seek index seek by reopening at the nearest indexed frame.
+class PlaybackEngine : public sf::SoundStream {
+public:
+    explicit PlaybackEngine(float decodeAheadSeconds = DEFAULT_DECODE_AHEAD_SECONDS);
+    ~PlaybackEngine();
+    PlaybackEngine(const PlaybackEngine&) = delete;
+    PlaybackEngine& operator=(const PlaybackEngine&) = delete;
+
+    // Stops whatever plays and starts a track opened by a TrackLoader; false (and silent)
+    // when the loader could not open it. Only memory is touched: the head is already decoded.
+    // `gain` is the track's loudness normalization, applied to its samples before the volume
+    bool start(LoadedTrack& track, float gain = 1.f);
+
+    // Hides sf::SoundStream::stop(): a streaming thread waiting on the ring is released first,
+    // and the stream is not rewound (that would decode the old track only to drop it); use
+    // setPlayingOffset(Zero) to start a track over
+    void stop();
+
+    // Track to splice in after the current one; replaces an earlier, not yet spliced choice
+    void setNext(const std::string& path, uint32_t trackId, float gain = 1.f);
+
+    // Where the seek tables of spliced tracks are looked up (the loader of the first track has its own)
+    void setSeekIndexDir(const std::string& seekIndexDir);
+    void setTrackCache(TrackCache* cache);
+
+    // Main loop side: true once a spliced track became audible (currentTrack() changed)
+    bool update();
+    bool transitionPending() const;
+
+    uint32_t currentTrack() const;
+    // The session swapped in a rescanned library: track ids become newIds[id] (mapTrackIds)
+    void renumberTracks(const std::vector<uint32_t>& newIds);
+    sf::Time getDuration() const;
+
+    // Relative to the audible track, hiding sf::SoundStream's stream-wide versions
+    sf::Time getPlayingOffset() const;
+    void setPlayingOffset(sf::Time offset);
+
+    unsigned int splicedTransitions() const;
+    unsigned int underranTransitions() const;  // the next track was not decoded in time
+
+    // Decode-ahead ring: what is buffered, what it holds at most, times it ran empty
+    sf::Time bufferedAhead() const;
+    sf::Time bufferCapacity() const;
+    unsigned int bufferUnderruns() const;
+
+    // Runs on SFML's streaming thread when a track was spliced or the stream ran dry
+    std::function<void()> onStreamEvent;
+
+protected:
+    bool onGetData(Chunk& data) override;
+    void onSeek(sf::Time timeOffset) override;
+
+private:
+    enum class Splice { Done, Waiting, Ended };
+
+    size_t fill(sf::Int16* out, size_t count);
+    void applyGain(sf::Int16* samples, size_t count) const;
+    bool seekWithIndex(uint64_t frame);
+    void seekDecoder(sf::Time timeOffset);
+    void decodeBlock();
+    void prefill();
+    Splice spliceNext(size_t samplesThisBlock);
+    void requestPreload();
+    void decodeLoop();
+
+    // Decoder side, owned by the decode thread and guarded by decodeMutex
+    std::mutex decodeMutex;
+    std::condition_variable decodeWake;          // ring has space again, new track, seek, quit
+    std::thread decodeThread;
+    TrackDecoder decoder;
+    TrackDecoder previous;                         // audible track while a splice is pending
+    std::vector<sf::Int16> block;
+    std::vector<sf::Int16> carry;                  // pre-decoded samples of the spliced track
+    size_t carryPos = 0;
+    uint64_t decodedInTrack = 0;                   // samples read from the decoder's track
+    uint64_t streamSamples = 0;                    // samples pushed into the ring since the last seek
+    bool decoding = false;                         // a track is open and not yet decoded to the end
+    bool awaitingSplice = false;                   // track exhausted, its successor still loading; written under both mutexes
+    std::chrono::steady_clock::time_point spliceDeadline;
+    std::atomic<unsigned int> channelCount{0};
+    std::atomic<unsigned int> sampleRate{0};
+
+    // Ring between the decode thread (producer) and SFML's streaming thread (consumer)
+    SpscRing<sf::Int16> ring;
+    float decodeAheadSeconds;
+    std::vector<sf::Int16> chunk;
+    std::mutex dataMutex;
+    std::condition_variable dataReady;
+    std::atomic<bool> streamDone{false};           // decode thread pushed the last samples
+    std::atomic<bool> abortWait{false};            // stop() / a seek is waiting for the streaming thread
+    std::atomic<bool> skipRewind{false};           // the next onSeek() is sf::SoundStream::stop()'s rewind
+    std::atomic<unsigned int> underrunCount{0};
+    bool starving = false;                         // consumer side: inside an underrun already
+
+    // Shared with the main loop and the preload loader
+    mutable std::mutex mutex;
+    std::condition_variable preloadDone;
+    std::atomic<bool> quitting{false};
+    TrackLoader preloader;
+    std::string nextPath;
+    uint32_t nextTrackId;
+    float nextGain = 1.f;
+    bool preloadRequested = false;
+
+    uint32_t trackId;
+    sf::Time duration;
+    sf::Time trackStart;                           // stream time where the audible track began
+    bool pending = false;
+    sf::Time pendingStart;
+    uint32_t pendingTrackId;
+    sf::Time pendingDuration;
+    std::string pendingPath;                       // queued again if a seek cancels the splice
+    float pendingGain = 1.f;
+    unsigned int spliced = 0;
+    unsigned int transitionUnderruns = 0;
+};
+
+#endif // PLAYBACK_ENGINE_HPP
@@ -0,0 +1,85 @@
+#ifndef SEARCH_INDEX_HPP
+#define SEARCH_INDEX_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "library.hpp"
+
+// Library-wide search over artist names, album names and song titles.
+// Every entry is folded once (lowercase, Latin diacritics stripped, punctuation turned
+// into spaces) and indexed two ways: all words of all entries sorted by their text, whose
+// prefix ranges answer search-as-you-type, and a trigram -> entries posting list for query
+// words found inside a word ("beat" in "heartbeat"). A query walks the narrowest prefix
+// range, verifies the other words on those entries only and keeps the best `limit` in a
+// heap; the trigram pass only runs when prefix matches do not fill the results. Building
+// takes a few hundred milliseconds at 100k songs, so it is done off the UI thread.
+
+enum class SearchKind : uint8_t {
+    Artist,
+    Album,
+    Track,
+};
+
+struct SearchResult {
+    SearchKind kind;
+    uint32_t id;  // artist, album or track id of the Library the index was built from
+};
+
+// "Beyoncé - Déjà Vu" -> "beyonce deja vu"; bytes outside ASCII / Latin-1 / Latin Extended-A
+// (other scripts) are kept as they are, so they still match themselves
+std::string foldSearchText(const std::string& text);
+
+class SearchIndex {
+public:
+    void build(const Library& library);
+    void clear();
+    bool built() const { return !documents.empty(); }
+
+    // Best matches first, at most `limit`. Every word of the query has to start a word of the
+    // entry (a song also matches on its artist and album); entries where some word only occurs
+    // inside a word come after all of those. Within a tier, names that are or start with the
+    // query rank first, then words found in the name itself, then shorter names
+    std::vector<SearchResult> search(const std::string& query, size_t limit) const;
+
+private:
+    struct Document {
+        SearchKind kind;
+        uint32_t id;
+        uint32_t primaryLength;  // text = folded name / title, then '|' and the folded context
+        std::string text;
+    };
+    // Carries what ranking a prefix match needs, so the widest ranges never touch the documents
+    struct Word {
+        uint32_t document;
+        uint16_t offset;
+        uint16_t length;
+        uint16_t primaryLength;
+        SearchKind kind;
+    };
+
+    void add(SearchKind kind, uint32_t id, const std::string& primary, const std::string& context);
+    void finish();
+    std::string_view wordText(const Word& word) const { return std::string_view(documents[word.document].text).substr(word.offset, word.length); }
+    std::pair<size_t, size_t> prefixRange(const std::string& prefix) const;
+
+    std::vector<Document> documents;  // artists, then albums, then songs: ties rank in that order
+    std::vector<Word> words;          // every word of every document, sorted by its text
+    std::vector<uint32_t> gramKeys;   // sorted trigrams, three bytes packed into the low 24 bits
+    std::vector<uint32_t> gramStarts; // postings of gramKeys[i] are [gramStarts[i], gramStarts[i + 1])
+    std::vector<uint32_t> postings;   // document ids, ascending within each trigram
+    // Ranked results of each one-letter query (ASCII letters and digits), the widest prefix
+    // ranges there are: the first keystroke of a search costs a copy
+    std::vector<std::vector<SearchResult>> letterResults;
+
+    // Per-query scratch, one slot per document (reset by bumping the stamp)
+    struct Slot {
+        uint32_t stamp;
+        int score;
+    };
+    mutable std::vector<Slot> slots;
+    mutable uint32_t stamp = 0;
+};
+
+#endif // SEARCH_INDEX_HPP
@@ -0,0 +1,57 @@
+#ifndef SEARCH_PANE_HPP
+#define SEARCH_PANE_HPP
+
+#include <ncurses.h>
+#include <future>
+#include <string>
+#include <vector>
+#include "library.hpp"
+#include "listView.hpp"
+#include "lyricsIndex.hpp"
+#include "searchIndex.hpp"
+
+// The search overlay: a query line over a ranked result list, re-ranked on every keystroke.
+// It lives inside the main loop like the menus (keys are fed to it while it is open), so
+// playback, gapless splices and the status bar carry on while the user types. The index is
+// built off the UI thread whenever the session gets a library. Tab switches to searching the
+// lyrics through the cache's lyrics index, matching the typed words as a phrase.
+class SearchPane {
+public:
+    // Starts indexing `library`, which must stay in place until forgetLibrary(), and maps the
+    // lyrics index (lyrics search stays unavailable without one)
+    void indexLibrary(const Library& library, const std::string& lyricsIndexPath);
+    // Waits for a build still reading the library, closes the pane and drops the index
+    void forgetLibrary();
+
+    void open();
+    void close();
+    bool active() const { return win != nullptr; }
+
+    // Typing edits the query, Up / Down move, Tab toggles lyrics search, Escape closes; true
+    // when Enter picked a result
+    bool handleKey(int ch);
+    SearchResult picked() const;
+
+    // Also called after the panels underneath were redrawn, the overlay goes back on top
+    void draw();
+    void resize();
+
+private:
+    void runQuery();
+    void place();
+
+    const Library* library = nullptr;
+    SearchIndex index;
+    LyricsIndex lyrics;
+    std::vector<uint32_t> lyricsTracks;  // library id of every lyrics index track, or INDEX_NOT_FOUND
+    bool searchingLyrics = false;
+    std::future<void> building;
+    WINDOW* win = nullptr;
+    ListView list;
+    std::string query;
+    std::vector<SearchResult> results;
+    std::vector<uint32_t> occurrences;  // per result, in lyrics search
+    double queryMicros = 0.0;
+};
+
+#endif // SEARCH_PANE_HPP
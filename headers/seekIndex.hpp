@@ -0,0 +1,78 @@
+#ifndef SEEK_INDEX_HPP
+#define SEEK_INDEX_HPP
+
+#include <SFML/Audio.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Frame offset tables for long mp3s, one sidecar per inode in info/seek/.
+// Written at cache time from walkMp3Frames(): every framesPerEntry-th frame (about a
+// second of audio) records the byte offset its header starts at. Playback opens a new
+// decoder at the entry just before the seek target instead of letting the decoder walk
+// every frame from the start, which is what makes VBR files without a TOC slow to seek.
+// Little endian like library.idx; the header remembers size and mtime of the mp3 so an
+// edited file simply stops using its stale table.
+
+const char SEEK_INDEX_MAGIC[8] = {'L', 'M', 'U', 'S', 'S', 'E', 'E', 'K'};
+const uint32_t SEEK_INDEX_VERSION = 1;
+// Shorter songs seek fast enough without a table, and the build reads the whole file
+const uint32_t SEEK_INDEX_MIN_MS = 10 * 60 * 1000;
+
+struct SeekIndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sampleRate;
+    uint32_t samplesPerFrame;  // per channel
+    uint32_t framesPerEntry;
+    uint32_t entryCount;       // followed by uint32_t offsets[entryCount]
+    uint32_t reserved;
+    uint64_t fileSize;
+    int64_t mtime;
+};
+
+struct SeekIndex {
+    uint32_t sampleRate = 0;
+    uint32_t samplesPerFrame = 0;
+    uint32_t framesPerEntry = 0;
+    std::vector<uint32_t> offsets;
+
+    // Entry at or before `frame` (a per-channel sample position): where its mp3 frame starts
+    // in the file and which sample that frame decodes to
+    bool lookup(uint64_t frame, uint64_t& byteOffset, uint64_t& startFrame) const;
+};
+
+std::string seekIndexPath(const std::string& seekIndexDir, uint64_t inode);
+bool isMp3Path(const std::string& path);
+
+// Cache side: true when the sidecar exists and matches the mp3's current size / mtime
+bool seekIndexFresh(const std::string& mp3Path, const std::string& indexPath);
+bool buildSeekIndex(const std::string& mp3Path, const std::string& indexPath);
+
+// Playback side: null when the track has no usable table (not an mp3, short, stale)
+std::shared_ptr<const SeekIndex> loadSeekIndex(const std::string& mp3Path, const std::string& seekIndexDir);
+
+// The part of a file from `start` on, presented to sf::InputSoundFile as a whole file
+class FileSliceStream : public sf::InputStream {
+public:
+    FileSliceStream() = default;
+    ~FileSliceStream();
+    FileSliceStream(const FileSliceStream&) = delete;
+    FileSliceStream& operator=(const FileSliceStream&) = delete;
+
+    bool open(const std::string& path, uint64_t start);
+
+    sf::Int64 read(void* data, sf::Int64 size) override;
+    sf::Int64 seek(sf::Int64 position) override;
+    sf::Int64 tell() override;
+    sf::Int64 getSize() override;
+
+private:
+    int fd = -1;
+    uint64_t sliceStart = 0;
+    uint64_t sliceSize = 0;
+    uint64_t position = 0;
+};
+
+#endif // SEEK_INDEX_HPP
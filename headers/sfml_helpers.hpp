@@ -5,13 +5,21 @@
 #include <cstring>
 #include <iostream>
 #include <algorithm>
+#include <functional>
+#include "library.hpp"
+#include "playQueue.hpp"
+#include "loudness.hpp"
+#include "playbackEngine.hpp"
+#include "trackLoader.hpp"
 
-void playMusic(sf::Music& music, const std::string& songPath);
-void nextSong(sf::Music& music, const std::vector<std::string>& songs, int& currentSongIndex);
-void previousSong(sf::Music& music, const std::vector<std::string>& songs, int& currentSongIndex);
-void adjustVolume(sf::Music& music, float volumeChange);
-void toggleMute(sf::Music& music, bool isMuted);
-void seekSong(sf::Music& music, int seekVal, bool forward);
-std::string getSongDuration(const std::string& songPath);
+void playMusic(TrackLoader& loader, const std::string& songPath, uint32_t trackId);
+bool startLoadedSong(PlaybackEngine& music, TrackLoader& loader, const Library& library, const PlayQueue& queue, NormalizeMode normalize);
+void queueNextSong(PlaybackEngine& music, const Library& library, const PlayQueue& queue, NormalizeMode normalize);
+float songGain(const Library& library, uint32_t trackId, NormalizeMode normalize, bool shuffled);
+uint32_t nextSong(TrackLoader& loader, const Library& library, PlayQueue& queue);
+uint32_t previousSong(TrackLoader& loader, const Library& library, PlayQueue& queue);
+void adjustVolume(PlaybackEngine& music, float volumeChange);
+void toggleMute(PlaybackEngine& music, bool isMuted);
+void seekSong(PlaybackEngine& music, int seekVal, bool forward);
 
 #endif
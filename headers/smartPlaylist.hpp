@@ -0,0 +1,103 @@
+#ifndef SMART_PLAYLIST_HPP
+#define SMART_PLAYLIST_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "library.hpp"
+
+// Smart playlists: saved queries over the library, kept in ~/.config/litemus/playlists.json as
+//   [{"name": "Sixties jazz", "query": "genre = \"Jazz\" AND year >= 1960 AND year < 1970"}, ...]
+// and evaluated again whenever the library is (re)loaded, so they follow the songs directory.
+//
+//   query := and ("OR" and)*
+//   and   := not ("AND" not)*
+//   not   := "NOT" not | "(" query ")" | field op value
+//
+// Text fields (artist, album, genre, title) take a double quoted string, compared folded like
+// the library search: case, accents and punctuation do not matter, `~` / `!~` match anywhere
+// inside. Numeric fields (year, duration) take =, !=, <, <=, >, >= and a number, durations in
+// seconds or as m:ss; a track without a year or duration fails every test on it. Keywords are
+// case-insensitive.
+
+enum class QueryField : uint8_t { Artist, Album, Genre, Title, Year, Duration };
+enum class QueryOp : uint8_t { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual, Contains, NotContains };
+
+struct QueryPredicate {
+    QueryField field;
+    QueryOp op;
+    std::string text;  // folded, for text fields
+    uint32_t number;   // year, or duration in seconds
+};
+
+// Postfix: a predicate pushes the mask of the tracks it holds for, AND / OR combine the top two
+// masks and NOT flips the top one
+enum class QueryStep : uint8_t { Predicate, And, Or, Not };
+
+struct QueryInstruction {
+    QueryStep step;
+    uint32_t predicate;  // into SmartQuery::predicates, for Predicate steps
+};
+
+struct SmartQuery {
+    std::vector<QueryPredicate> predicates;
+    std::vector<QueryInstruction> program;
+};
+
+// False with `error` (what went wrong and at which character) when `text` is not a query
+bool parseSmartQuery(const std::string& text, SmartQuery& query, std::string& error);
+
+// The attributes queries filter on, one flat array per attribute indexed by track id. Text
+// attributes are ids into folded dictionaries (artists, albums, genres): a text predicate is
+// decided once per distinct value, then every track looks its value's answer up. Titles are
+// folded into one buffer, so `~` is a single substring scan over all of them. Each predicate
+// is a branch-free loop over its column filling a byte per track, AND / OR / NOT combine
+// those masks the same way.
+class TrackTable {
+public:
+    // Folding every title is most of the build, so it can be left out when no query reads them
+    void build(const Library& library, bool withTitles = true);
+
+    // Ids of the tracks `query` holds for, ascending: artist / album / track order
+    std::vector<uint32_t> evaluate(const SmartQuery& query) const;
+
+private:
+    // Folded strings back to back, each followed by a '\0' that foldSearchText never produces
+    struct TextColumn {
+        std::string text;
+        std::vector<uint32_t> starts;  // entry i is text[starts[i], starts[i + 1] - 1), one start past the last
+
+        void clear();
+        void add(const std::string& value);
+        void match(const QueryPredicate& predicate, uint8_t* matches) const;  // one byte per entry
+    };
+
+    void evaluatePredicate(const QueryPredicate& predicate, uint8_t* matches, std::vector<uint8_t>& scratch) const;
+
+    uint32_t trackCount = 0;
+    std::vector<uint32_t> artists;
+    std::vector<uint32_t> albums;
+    std::vector<uint32_t> genres;
+    std::vector<uint32_t> years;      // 0 when undated
+    std::vector<uint32_t> durations;  // seconds, 0 when unknown
+    TextColumn artistNames;
+    TextColumn albumNames;
+    TextColumn genreNames;
+    TextColumn titles;  // empty unless built withTitles
+};
+
+struct SmartPlaylist {
+    std::string name;
+    std::string text;
+    SmartQuery query;
+    std::string error;  // set when the query does not parse; such a playlist matches nothing
+};
+
+// Reads playlists.json; a missing file is no playlists. False with `error` when the file is
+// not the expected array of {"name", "query"} objects
+bool loadSmartPlaylists(const std::string& path, std::vector<SmartPlaylist>& playlists, std::string& error);
+
+// Evaluates every playlist against `library` and makes the results its Playlist view
+void applySmartPlaylists(Library& library, const std::vector<SmartPlaylist>& playlists);
+
+#endif // SMART_PLAYLIST_HPP
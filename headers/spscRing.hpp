@@ -0,0 +1,72 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Lock-free single-producer / single-consumer ring of trivially copyable items.
+// head and tail only ever grow; the producer owns head, the consumer owns tail, and
+// each side reads the other's counter with acquire so the copied items are visible.
+// push() / pop() move as many items as fit or are available and never block.
+template <typename T>
+class SpscRing {
+public:
+    // Not thread safe: both sides must be idle
+    void reset(size_t newCapacity) {
+        items.assign(newCapacity == 0 ? 1 : newCapacity, T());
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    void clear() {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    size_t push(const T* data, size_t count) {
+        size_t writeAt = head.load(std::memory_order_relaxed);
+        size_t readAt = tail.load(std::memory_order_acquire);
+        count = std::min(count, items.size() - (writeAt - readAt));
+        copyIn(data, writeAt, count);
+        head.store(writeAt + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t pop(T* out, size_t count) {
+        size_t readAt = tail.load(std::memory_order_relaxed);
+        size_t writeAt = head.load(std::memory_order_acquire);
+        count = std::min(count, writeAt - readAt);
+        copyOut(out, readAt, count);
+        tail.store(readAt + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t size() const {
+        size_t readAt = tail.load(std::memory_order_acquire);  // tail first: head can only be further
+        return head.load(std::memory_order_acquire) - readAt;
+    }
+    size_t space() const { return items.size() - size(); }
+    size_t capacity() const { return items.size(); }
+
+private:
+    // At most two runs each: up to the end of the storage, then from its start
+    void copyIn(const T* data, size_t position, size_t count) {
+        size_t start = position % items.size();
+        size_t first = std::min(count, items.size() - start);
+        std::copy(data, data + first, items.begin() + start);
+        std::copy(data + first, data + count, items.begin());
+    }
+    void copyOut(T* out, size_t position, size_t count) const {
+        size_t start = position % items.size();
+        size_t first = std::min(count, items.size() - start);
+        std::copy(items.begin() + start, items.begin() + start + first, out);
+        std::copy(items.begin(), items.begin() + (count - first), out + first);
+    }
+
+    std::vector<T> items;
+    std::atomic<size_t> head{0};  // items ever written
+    std::atomic<size_t> tail{0};  // items ever read
+};
+
+#endif // SPSC_RING_HPP
@@ -0,0 +1,258 @@
+#include "../audioHeaders.hpp"
+#include "../fileWindow.hpp"
+#include <cstring>
+#include <vector>
+
+struct Mp3FrameHeader {
+    uint32_t sampleRate;
+    uint32_t samples;   // per channel, per frame
+    uint32_t length;    // bytes, header included
+    bool mpeg1;
+    bool mono;
+};
+
+static bool parseMp3Header(const uint8_t* h, Mp3FrameHeader& out) {
+    if (h[0] != 0xFF || (h[1] & 0xE0) != 0xE0) {
+        return false;
+    }
+    int versionBits = (h[1] >> 3) & 3;  // 0: MPEG2.5, 1: reserved, 2: MPEG2, 3: MPEG1
+    int layerBits = (h[1] >> 1) & 3;    // 1: layer III, 2: layer II, 3: layer I
+    int bitrateIndex = h[2] >> 4;
+    int sampleRateIndex = (h[2] >> 2) & 3;
+    int padding = (h[2] >> 1) & 1;
+    if (versionBits == 1 || layerBits == 0 || bitrateIndex == 0 || bitrateIndex == 15 || sampleRateIndex == 3) {
+        return false; // reserved values, or free format which has no usable frame length
+    }
+
+    static const uint16_t bitrates[5][15] = {
+        {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},  // MPEG1 layer I
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},     // MPEG1 layer II
+        {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},      // MPEG1 layer III
+        {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},     // MPEG2/2.5 layer I
+        {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},          // MPEG2/2.5 layer II & III
+    };
+    static const uint32_t sampleRates[3] = {44100, 48000, 32000};
+
+    int layer = 4 - layerBits;
+    bool mpeg1 = (versionBits == 3);
+    int table = mpeg1 ? layer - 1 : (layer == 1 ? 3 : 4);
+    uint32_t bitrate = bitrates[table][bitrateIndex] * 1000;
+
+    out.mpeg1 = mpeg1;
+    out.sampleRate = sampleRates[sampleRateIndex] >> (mpeg1 ? 0 : (versionBits == 2 ? 1 : 2));
+    out.mono = ((h[3] >> 6) & 3) == 3;
+    if (layer == 1) {
+        out.samples = 384;
+        out.length = (12 * bitrate / out.sampleRate + padding) * 4;
+    } else {
+        out.samples = (layer == 3 && !mpeg1) ? 576 : 1152;
+        out.length = (out.samples / 8) * bitrate / out.sampleRate + padding;
+    }
+    return out.length >= 4;
+}
+
+// Sequential reader over large chunks, so walking every frame header of a long mp3
+// costs one pread per chunk rather than one per frame
+class ChunkReader {
+public:
+    explicit ChunkReader(const std::string& path) {
+        fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0) {
+            fileSize = static_cast<uint64_t>(st.st_size);
+        }
+    }
+    ~ChunkReader() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    ChunkReader(const ChunkReader&) = delete;
+    ChunkReader& operator=(const ChunkReader&) = delete;
+
+    uint64_t size() const { return fileSize; }
+
+    // Pointer to n bytes at pos, nullptr past the end of the file
+    const uint8_t* at(uint64_t pos, size_t n) {
+        if (fd < 0 || pos + n > fileSize) {
+            return nullptr;
+        }
+        if (pos < bufferStart || pos + n > bufferStart + buffer.size()) {
+            buffer.resize(chunkSize);
+            ssize_t got = pread(fd, buffer.data(), chunkSize, static_cast<off_t>(pos));
+            if (got < static_cast<ssize_t>(n)) {
+                buffer.clear();
+                return nullptr;
+            }
+            buffer.resize(static_cast<size_t>(got));
+            bufferStart = pos;
+        }
+        return buffer.data() + (pos - bufferStart);
+    }
+
+private:
+    static const size_t chunkSize = 256 * 1024;
+    int fd = -1;
+    uint64_t fileSize = 0;
+    uint64_t bufferStart = 0;
+    std::vector<uint8_t> buffer;
+};
+
+static uint64_t skipId3v2(ChunkReader& reader) {
+    const uint8_t* h = reader.at(0, 10);
+    if (!h || memcmp(h, "ID3", 3) != 0) {
+        return 0;
+    }
+    uint64_t size = ((h[6] & 0x7f) << 21) | ((h[7] & 0x7f) << 14) | ((h[8] & 0x7f) << 7) | (h[9] & 0x7f);
+    return 10 + size + ((h[5] & 0x10) ? 10 : 0);
+}
+
+// First offset holding two consecutive valid frame headers (guards against false syncs in junk)
+static bool findFirstFrame(ChunkReader& reader, uint64_t& pos, Mp3FrameHeader& header) {
+    const uint64_t searchLimit = pos + 64 * 1024;
+    for (; pos < searchLimit; ++pos) {
+        const uint8_t* h = reader.at(pos, 4);
+        if (!h) {
+            return false;
+        }
+        if (!parseMp3Header(h, header)) {
+            continue;
+        }
+        Mp3FrameHeader next;
+        const uint8_t* n = reader.at(pos + header.length, 4);
+        if (!n || (parseMp3Header(n, next) && next.sampleRate == header.sampleRate)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool walkMp3Frames(const std::string& filePath, const std::function<void(uint64_t offset, uint32_t samples, uint32_t sampleRate)>& onFrame) {
+    ChunkReader reader(filePath);
+    uint64_t pos = skipId3v2(reader);
+    Mp3FrameHeader header;
+    if (!findFirstFrame(reader, pos, header)) {
+        return false;
+    }
+    while (true) {
+        const uint8_t* h = reader.at(pos, 4);
+        if (!h || memcmp(h, "TAG", 3) == 0 || memcmp(h, "APET", 4) == 0 || !parseMp3Header(h, header)) {
+            break;
+        }
+        onFrame(pos, header.samples, header.sampleRate);
+        pos += header.length;
+    }
+    return true;
+}
+
+static uint32_t readBE32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+static uint32_t toMs(uint64_t samples, uint32_t sampleRate) {
+    return sampleRate == 0 ? 0 : static_cast<uint32_t>(samples * 1000 / sampleRate);
+}
+
+static uint32_t mp3DurationMs(const std::string& filePath) {
+    ChunkReader reader(filePath);
+    uint64_t pos = skipId3v2(reader);
+    Mp3FrameHeader header;
+    if (!findFirstFrame(reader, pos, header)) {
+        return 0;
+    }
+
+    // Xing / Info frame right after the side information of the first frame
+    uint32_t sideInfo = header.mpeg1 ? (header.mono ? 17 : 32) : (header.mono ? 9 : 17);
+    const uint8_t* frame = reader.at(pos, header.length);
+    if (frame && 4 + sideInfo + 8 <= header.length) {
+        const uint8_t* xing = frame + 4 + sideInfo;
+        if (memcmp(xing, "Xing", 4) == 0 || memcmp(xing, "Info", 4) == 0) {
+            uint32_t flags = readBE32(xing + 4);
+            if ((flags & 1) && 4 + sideInfo + 12 <= header.length) {
+                uint64_t samples = static_cast<uint64_t>(readBE32(xing + 8)) * header.samples;
+                // LAME extension follows the optional Xing fields: encoder delay and padding
+                uint32_t lameOffset = 8 + 4 + ((flags & 2) ? 4 : 0) + ((flags & 4) ? 100 : 0) + ((flags & 8) ? 4 : 0);
+                if (4 + sideInfo + lameOffset + 24 <= header.length) {
+                    const uint8_t* lame = xing + lameOffset;
+                    if (memcmp(lame, "LAME", 4) == 0 || memcmp(lame, "Lavf", 4) == 0 || memcmp(lame, "Lavc", 4) == 0) {
+                        uint32_t delay = (lame[21] << 4) | (lame[22] >> 4);
+                        uint32_t padding = ((lame[22] & 0x0F) << 8) | lame[23];
+                        if (delay + padding < samples) {
+                            samples -= delay + padding;
+                        }
+                    }
+                }
+                return toMs(samples, header.sampleRate);
+            }
+        }
+        // VBRI (Fraunhofer) always sits 32 bytes after the header
+        if (4 + 32 + 18 <= header.length && memcmp(frame + 36, "VBRI", 4) == 0) {
+            uint64_t frames = readBE32(frame + 36 + 14);
+            return toMs(frames * header.samples, header.sampleRate);
+        }
+    }
+
+    // No VBR header: count every frame, exact for CBR and VBR alike
+    uint64_t samples = 0;
+    uint32_t sampleRate = header.sampleRate;
+    walkMp3Frames(filePath, [&](uint64_t, uint32_t frameSamples, uint32_t) { samples += frameSamples; });
+    return toMs(samples, sampleRate);
+}
+
+static uint32_t flacDurationMs(const FileWindow& file, uint64_t pos) {
+    std::string block;
+    // "fLaC", then STREAMINFO is always the first metadata block (4 byte header + 34 bytes)
+    if (!file.read(pos, 4 + 4 + 34, block) || block.compare(0, 4, "fLaC") != 0 || (block[4] & 0x7F) != 0) {
+        return 0;
+    }
+    const uint8_t* info = reinterpret_cast<const uint8_t*>(block.data()) + 8;
+    uint32_t sampleRate = (info[10] << 12) | (info[11] << 4) | (info[12] >> 4);
+    uint64_t totalSamples = (static_cast<uint64_t>(info[13] & 0x0F) << 32) | readBE32(info + 14);
+    return toMs(totalSamples, sampleRate);
+}
+
+static uint32_t wavDurationMs(const FileWindow& file) {
+    uint64_t pos = 12;
+    uint32_t byteRate = 0;
+    std::string chunk;
+    for (int chunks = 0; chunks < 256 && file.read(pos, 8, chunk); ++chunks) {
+        const uint8_t* h = reinterpret_cast<const uint8_t*>(chunk.data());
+        uint32_t len = h[4] | (h[5] << 8) | (h[6] << 16) | (static_cast<uint32_t>(h[7]) << 24);
+        if (chunk.compare(0, 4, "fmt ") == 0 && file.read(pos + 8, 12, chunk)) {
+            const uint8_t* fmt = reinterpret_cast<const uint8_t*>(chunk.data());
+            byteRate = fmt[8] | (fmt[9] << 8) | (fmt[10] << 16) | (static_cast<uint32_t>(fmt[11]) << 24);
+        } else if (chunk.compare(0, 4, "data") == 0) {
+            uint64_t dataSize = len;
+            if (len == 0 || len == 0xFFFFFFFF || pos + 8 + dataSize > file.size()) {
+                dataSize = file.size() - (pos + 8); // streamed or truncated wav
+            }
+            return byteRate == 0 ? 0 : static_cast<uint32_t>(dataSize * 1000 / byteRate);
+        }
+        pos += 8 + static_cast<uint64_t>(len) + (len & 1);
+    }
+    return 0;
+}
+
+uint32_t probeDurationMs(const std::string& filePath) {
+    FileWindow file(filePath, 4096);
+    std::string magic;
+    if (!file.isOpen() || !file.read(0, 12, magic)) {
+        return 0;
+    }
+    if (magic.compare(0, 4, "fLaC") == 0) {
+        return flacDurationMs(file, 0);
+    }
+    if (magic.compare(0, 4, "RIFF") == 0 && magic.compare(8, 4, "WAVE") == 0) {
+        return wavDurationMs(file);
+    }
+    if (magic.compare(0, 3, "ID3") == 0) {
+        const uint8_t* h = reinterpret_cast<const uint8_t*>(magic.data());
+        uint64_t tagEnd = 10 + (((h[6] & 0x7f) << 21) | ((h[7] & 0x7f) << 14) | ((h[8] & 0x7f) << 7) | (h[9] & 0x7f)) + ((h[5] & 0x10) ? 10 : 0);
+        uint32_t flac = flacDurationMs(file, tagEnd);
+        if (flac > 0) {
+            return flac;
+        }
+    }
+    return mp3DurationMs(filePath);
+}
@@ -0,0 +1,96 @@
+#include "../compositor.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+struct Panel {
+    WINDOW* win;
+    bool dirty;
+};
+
+static std::vector<Panel> panels;
+static std::vector<WINDOW*> overlays;  // in the order they were marked, last one ends up on top
+static FrameStats stats = {false, 0, 0, 0};
+static int threadIoFd = -1;
+
+void compositorAddPanel(WINDOW* win) {
+    panels.push_back({win, true});
+}
+
+void markDirty(WINDOW* win) {
+    for (Panel& panel : panels) {
+        if (panel.win == win) {
+            panel.dirty = true;
+            return;
+        }
+    }
+    if (std::find(overlays.begin(), overlays.end(), win) == overlays.end()) {
+        overlays.push_back(win);
+    }
+}
+
+void markAllDirty() {
+    for (Panel& panel : panels) {
+        touchwin(panel.win);
+        panel.dirty = true;
+    }
+}
+
+void compositorForget(WINDOW* win) {
+    overlays.erase(std::remove(overlays.begin(), overlays.end(), win), overlays.end());
+}
+
+// "wchar:" of /proc/thread-self/io: bytes this thread handed to write(2). doupdate() runs
+// on the main thread and does nothing but write the terminal, so the delta is the frame.
+static unsigned long long threadBytesWritten() {
+    char buffer[512];
+    ssize_t length = pread(threadIoFd, buffer, sizeof(buffer) - 1, 0);
+    if (length <= 0) {
+        return 0;
+    }
+    buffer[length] = '\0';
+    const char* field = strstr(buffer, "wchar:");
+    return field ? strtoull(field + 6, nullptr, 10) : 0;
+}
+
+bool enableFrameByteCounter() {
+    threadIoFd = open("/proc/thread-self/io", O_RDONLY | O_CLOEXEC);
+    if (threadIoFd < 0) {
+        return false;  // no task I/O accounting in this kernel
+    }
+    stats.counting = true;
+    return true;
+}
+
+FrameStats frameStats() {
+    return stats;
+}
+
+void flushFrame() {
+    bool anyDirty = !overlays.empty();
+    for (Panel& panel : panels) {
+        if (panel.dirty) {
+            wnoutrefresh(panel.win);
+            panel.dirty = false;
+            anyDirty = true;
+        }
+    }
+    for (WINDOW* overlay : overlays) {
+        wnoutrefresh(overlay);
+    }
+    overlays.clear();
+    if (!anyDirty) {
+        return;
+    }
+
+    unsigned long long before = stats.counting ? threadBytesWritten() : 0;
+    doupdate();
+    if (stats.counting) {
+        stats.lastFrameBytes = threadBytesWritten() - before;
+        stats.totalBytes += stats.lastFrameBytes;
+    }
+    ++stats.frames;
+}
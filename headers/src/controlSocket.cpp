@@ -0,0 +1,190 @@
+#include "../controlSocket.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// A client that never sends a newline is dropped instead of growing its buffer forever
+static const size_t MAX_REQUEST_BYTES = 4096;
+
+static bool socketAddress(const std::string& path, struct sockaddr_un& address) {
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+// Replies are a few hundred bytes; a client that stops reading is simply cut off
+static bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t written = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        sent += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+ControlServer::~ControlServer() {
+    for (Client& client : clients) {
+        close(client.fd);
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+}
+
+bool ControlServer::open(const std::string& path) {
+    struct sockaddr_un address;
+    if (!socketAddress(path, address) || daemonListening(path)) {
+        return false;
+    }
+    unlink(path.c_str());  // left behind by a daemon that did not exit cleanly
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        return false;
+    }
+    // Only the owner may drive the player
+    mode_t previousMask = umask(0077);
+    bool bound = bind(listenFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0;
+    umask(previousMask);
+    if (!bound || listen(listenFd, 16) != 0) {
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    socketPath = path;
+    return true;
+}
+
+std::vector<int> ControlServer::fds() const {
+    std::vector<int> result;
+    result.push_back(listenFd);
+    for (const Client& client : clients) {
+        result.push_back(client.fd);
+    }
+    return result;
+}
+
+void ControlServer::service(const std::function<std::string(const std::string&)>& handler) {
+    int fd;
+    while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        clients.push_back({fd, std::string()});
+    }
+
+    for (size_t i = 0; i < clients.size();) {
+        Client& client = clients[i];
+        bool alive = true;
+        bool hungUp = false;
+        char buffer[1024];
+        while (true) {
+            ssize_t got = recv(client.fd, buffer, sizeof(buffer), 0);
+            if (got > 0) {
+                client.pending.append(buffer, static_cast<size_t>(got));
+                continue;
+            }
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got == 0) {
+                hungUp = true;  // what it sent before hanging up still runs below
+            } else {
+                alive = errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            break;
+        }
+
+        size_t start = 0;
+        size_t newline;
+        while (alive && (newline = client.pending.find('\n', start)) != std::string::npos) {
+            std::string line = client.pending.substr(start, newline - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            start = newline + 1;
+            std::string reply = handler(line) + "\n";
+            // `echo next | nc -U` hangs up before the reply: it may go nowhere, the commands run anyway
+            if (!sendAll(client.fd, reply) && !hungUp) {
+                alive = false;
+            }
+        }
+        client.pending.erase(0, start);
+        if (client.pending.size() > MAX_REQUEST_BYTES || hungUp) {
+            alive = false;
+        }
+
+        if (alive) {
+            ++i;
+        } else {
+            close(client.fd);
+            clients.erase(clients.begin() + i);
+        }
+    }
+}
+
+ControlClient::~ControlClient() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool ControlClient::connect(const std::string& path) {
+    struct sockaddr_un address;
+    if (!socketAddress(path, address)) {
+        return false;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+bool ControlClient::request(const std::string& line, std::string& reply, int timeoutMs) {
+    if (fd < 0 || !sendAll(fd, line + "\n")) {
+        return false;
+    }
+    size_t newline;
+    while ((newline = pending.find('\n')) == std::string::npos) {
+        struct pollfd readable = {fd, POLLIN, 0};
+        int ready = poll(&readable, 1, timeoutMs);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+        char buffer[1024];
+        ssize_t got = ready > 0 ? recv(fd, buffer, sizeof(buffer), 0) : -1;
+        if (got <= 0) {
+            close(fd);  // timed out or gone: a late reply must not answer the next request
+            fd = -1;
+            return false;
+        }
+        pending.append(buffer, static_cast<size_t>(got));
+    }
+    reply = pending.substr(0, newline);
+    pending.erase(0, newline + 1);
+    return true;
+}
+
+bool daemonListening(const std::string& path) {
+    ControlClient probe;
+    return probe.connect(path);
+}
@@ -0,0 +1,276 @@
+#include "../daemon.hpp"
+#include <cmath>
+#include <csignal>
+#include <iostream>
+#include <sstream>
+#include <sys/signalfd.h>
+#include <unistd.h>
+#include "nlohmann/json.hpp"
+#include "../controlSocket.hpp"
+#include "../library.hpp"
+#include "../loopEvents.hpp"
+#include "../playQueue.hpp"
+#include "../sfml_helpers.hpp"
+
+using json = nlohmann::json;
+
+// COLORS (ANSI ESCAPE VALUES)
+const std::string RESET = "\033[0m";
+const std::string RED = "\033[31m";
+const std::string PINK = "\033[35m";
+const std::string BOLD = "\033[1m";
+
+// What the main loop of `lmus run` keeps in locals, shared with the command handler
+struct DaemonPlayer {
+    PlaybackEngine& music;
+    TrackLoader& loader;
+    const Library& library;
+    PlayQueue& queue;
+    NormalizeMode normalize;
+    uint32_t currentTrackId = INDEX_NOT_FOUND;
+    bool started = false;  // firstEnterPressed of the UI: something was asked to play
+    bool quitRequested = false;
+};
+
+// "+5" / "-5" are relative, "5" absolute
+static bool parseAmount(const std::string& text, double& value, bool& relative) {
+    if (text.empty()) {
+        return false;
+    }
+    relative = text[0] == '+' || text[0] == '-';
+    try {
+        size_t used;
+        value = std::stod(text, &used);
+        return used == text.size() && std::isfinite(value);
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+static bool parseTrackId(const std::string& text, const Library& library, uint32_t& trackId) {
+    try {
+        size_t used;
+        unsigned long value = std::stoul(text, &used);
+        if (used != text.size() || text[0] == '-' || value >= library.trackCount()) {
+            return false;
+        }
+        trackId = static_cast<uint32_t>(value);
+        return true;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+static std::string statusReply(const DaemonPlayer& player) {
+    const char* state = "stopped";
+    if (player.loader.busy()) {
+        state = "loading";
+    } else if (player.music.getStatus() == sf::SoundSource::Playing) {
+        state = "playing";
+    } else if (player.music.getStatus() == sf::SoundSource::Paused) {
+        state = "paused";
+    }
+    json status = {
+        {"state", state},
+        {"track", nullptr},
+        {"volume", player.music.getVolume()},
+        {"queue", player.queue.size()},
+        {"shuffle", player.queue.shuffled()},
+    };
+    uint32_t trackId = player.currentTrackId;
+    if (trackId != INDEX_NOT_FOUND) {
+        const LibraryTrack& track = player.library.track(trackId);
+        status["track"] = trackId;
+        status["title"] = track.title;
+        status["artist"] = player.library.trackArtist(trackId);
+        status["album"] = player.library.album(track.album).name;
+        status["position"] = player.music.getPlayingOffset().asSeconds();
+        status["duration"] = track.durationMs / 1000.0;
+    }
+    // Tags are not always valid UTF-8: replaced rather than failing the whole reply
+    return "OK " + status.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+// One request line -> one reply line; every action goes through the same helpers as the UI's keys
+static std::string handleCommand(DaemonPlayer& player, const std::string& line) {
+    std::istringstream words(line);
+    std::string verb;
+    std::string argument;
+    std::string extra;
+    words >> verb >> argument >> extra;
+    if (!extra.empty()) {
+        return "ERR too many arguments";
+    }
+    PlaybackEngine& music = player.music;
+    PlayQueue& queue = player.queue;
+
+    if (verb == "status") {
+        return statusReply(player);
+    } else if (verb == "play" && !argument.empty()) {
+        uint32_t trackId;
+        if (!parseTrackId(argument, player.library, trackId)) {
+            return "ERR no track " + argument;
+        }
+        // Like Enter on a song row: the artist's songs become the queue
+        const LibraryArtist& artist = player.library.artist(player.library.track(trackId).artist);
+        std::vector<uint32_t> artistTrackIds;
+        for (uint32_t id = artist.firstTrack; id < artist.firstTrack + artist.trackCount; ++id) {
+            artistTrackIds.push_back(id);
+        }
+        queue.replace(artistTrackIds, trackId);
+        player.currentTrackId = trackId;
+        playMusic(player.loader, player.library.track(trackId).path, trackId);
+        player.started = true;
+    } else if (verb == "play" || verb == "pause" || verb == "toggle") {
+        if (!player.started) {
+            if (verb == "pause" || queue.empty()) {
+                return verb == "pause" ? "OK" : "ERR queue is empty";
+            }
+            player.currentTrackId = queue.current();  // resume the restored queue
+            playMusic(player.loader, player.library.track(player.currentTrackId).path, player.currentTrackId);
+            player.started = true;
+        } else if (music.getStatus() == sf::SoundSource::Paused && verb != "pause") {
+            music.play();
+        } else if (music.getStatus() == sf::SoundSource::Playing && verb != "play") {
+            music.pause();
+        }
+    } else if (verb == "next" || verb == "prev") {
+        if (queue.empty()) {
+            return "ERR queue is empty";
+        }
+        player.currentTrackId = verb == "next" ? nextSong(player.loader, player.library, queue) : previousSong(player.loader, player.library, queue);
+        player.started = true;
+    } else if (verb == "seek") {
+        double seconds;
+        bool relative;
+        if (!parseAmount(argument, seconds, relative)) {
+            return "ERR seek expects [+|-]SECONDS";
+        }
+        if (!player.started || music.getStatus() == sf::SoundSource::Stopped) {
+            return "ERR nothing is playing";
+        }
+        if (relative) {
+            seekSong(music, static_cast<int>(std::abs(seconds)), seconds > 0);
+        } else {
+            music.setPlayingOffset(sf::seconds(static_cast<float>(std::max(0.0, seconds))));
+        }
+    } else if (verb == "volume") {
+        double volume;
+        bool relative;
+        if (!parseAmount(argument, volume, relative)) {
+            return "ERR volume expects [+|-]N";
+        }
+        adjustVolume(music, static_cast<float>(relative ? volume : volume - music.getVolume()));
+    } else if (verb == "enqueue") {
+        uint32_t trackId;
+        if (!parseTrackId(argument, player.library, trackId)) {
+            return "ERR no track " + argument;
+        }
+        if (!queue.append(trackId)) {
+            return "ERR already queued";
+        }
+        queueNextSong(music, player.library, queue, player.normalize);  // the splice target may have changed
+    } else if (verb == "shuffle") {
+        if (argument != "" && argument != "on" && argument != "off") {
+            return "ERR shuffle expects on or off";
+        }
+        queue.setShuffle(argument.empty() ? !queue.shuffled() : argument == "on");
+        queueNextSong(music, player.library, queue, player.normalize);
+    } else if (verb == "quit") {
+        player.quitRequested = true;
+    } else {
+        return "ERR unknown command " + verb;
+    }
+    return "OK";
+}
+
+int lmus_daemon_main(const std::string& songsDirectory, const std::string& indexFilePath, const std::string& queueFilePath, const std::string& seekIndexDir, const std::string& socketPath, float bufferSeconds, uint32_t trackCacheMb, NormalizeMode normalize) {
+    // Blocked before any thread exists so every thread inherits the mask and only the
+    // signalfd sees them: the loop saves the queue and removes the socket on its way out
+    sigset_t quitSignals;
+    sigemptyset(&quitSignals);
+    sigaddset(&quitSignals, SIGINT);
+    sigaddset(&quitSignals, SIGTERM);
+    sigaddset(&quitSignals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &quitSignals, nullptr);
+    int signalFd = signalfd(-1, &quitSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    Library library;
+    {
+        LibraryIndex libraryIndex;
+        if (!libraryIndex.open(indexFilePath) || !library.load(libraryIndex, songsDirectory) || library.trackCount() == 0) {
+            std::cout << RED << BOLD << "[ERROR] Could not open the library index " << indexFilePath << ". Run `lmus --remote-cache` to rebuild the cache." << RESET << std::endl;
+            return -1;
+        }
+    }
+
+    ControlServer server;
+    LoopEvents events;
+    if (signalFd < 0 || !events.open(false)) {
+        std::cout << RED << BOLD << "[ERROR] Could not create the timer / wakeup descriptors for the daemon loop." << RESET << std::endl;
+        return -1;
+    }
+    if (!server.open(socketPath)) {
+        std::cout << RED << BOLD << "[ERROR] Could not listen on " << socketPath << " (is another `lmus daemon` running?)" << RESET << std::endl;
+        close(signalFd);
+        return -1;
+    }
+
+    TrackCache trackCache(static_cast<uint64_t>(trackCacheMb) << 20);  // outlives both loaders
+    PlaybackEngine music(bufferSeconds);
+    music.setSeekIndexDir(seekIndexDir);
+    music.setTrackCache(&trackCache);
+    music.onStreamEvent = [&events]() { events.notifyTrackEnd(); };
+    PlayQueue queue(library.trackCount());
+    queue.load(queueFilePath, library);
+    TrackLoader loader;
+    loader.onLoaded = [&events]() { events.notifyLoaded(); };
+    loader.setSeekIndexDir(seekIndexDir);
+    loader.setTrackCache(&trackCache);
+    DaemonPlayer player{music, loader, library, queue, normalize};
+    bool trackEnding = false;
+
+    std::cout << PINK << BOLD << "[DAEMON] " << library.trackCount() << " songs, listening on " << socketPath << RESET << std::endl;
+
+    while (!player.quitRequested) {
+        std::vector<int> watched = server.fds();
+        watched.push_back(signalFd);
+        events.watchControl(watched);
+        unsigned int ready = events.wait();
+        if (ready & LOOP_EVENT_TRACK_END) {
+            trackEnding = true;
+        }
+        if (ready & LOOP_EVENT_CONTROL) {
+            struct signalfd_siginfo signal;
+            if (read(signalFd, &signal, sizeof(signal)) == sizeof(signal)) {
+                break;
+            }
+            server.service([&player](const std::string& line) { return handleCommand(player, line); });
+        }
+
+        // The rest mirrors the main loop of `lmus run`
+        if ((ready & LOOP_EVENT_LOADED) && startLoadedSong(music, loader, library, queue, normalize)) {
+            trackEnding = false;
+        }
+        if (music.update()) {
+            player.currentTrackId = music.currentTrack();
+            queue.setCurrent(player.currentTrackId);
+            queueNextSong(music, library, queue, normalize);
+            trackEnding = false;
+        }
+        if (music.getStatus() == sf::SoundSource::Stopped && player.started && !loader.busy() && !queue.empty()) {
+            player.currentTrackId = nextSong(loader, library, queue);
+            trackEnding = false;
+        }
+
+        // No progress to draw: the timer only runs while a track drains into the next one
+        bool advancing = music.getStatus() == sf::SoundSource::Stopped && player.started && !loader.busy() && !queue.empty();
+        events.setTickInterval(trackEnding || music.transitionPending() || advancing ? 50 : 0);
+    }
+
+    queue.save(queueFilePath, library);
+    music.stop();
+    close(signalFd);
+    std::cout << PINK << BOLD << "[DAEMON] Stopped, queue saved to " << queueFilePath << RESET << std::endl;
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include "../daemon.hpp"
+#include <iostream>
+#include <ncurses.h>
+#include "nlohmann/json.hpp"
+#include "../compositor.hpp"
+#include "../controlSocket.hpp"
+#include "../loopEvents.hpp"
+#include "../ncurses_helpers.hpp"
+#include "../parsers.hpp"
+
+using json = nlohmann::json;
+
+int lmus_ctl_main(const std::string& socketPath, const std::string& command) {
+    ControlClient client;
+    if (!client.connect(socketPath)) {
+        std::cerr << "[ERROR] No `lmus daemon` is listening on " << socketPath << std::endl;
+        return 1;
+    }
+    std::string reply;
+    if (!client.request(command, reply)) {
+        std::cerr << "[ERROR] The daemon did not answer" << std::endl;
+        return 1;
+    }
+    if (reply.compare(0, 3, "ERR") == 0) {
+        std::cerr << reply << std::endl;
+        return 1;
+    }
+    // "OK" prints nothing, a query prints its JSON
+    if (reply.size() > 3) {
+        std::cout << reply.substr(3) << std::endl;
+    }
+    return 0;
+}
+
+static std::string keyLabel(const std::unordered_map<std::string, int>& keybinds, const std::string& name) {
+    auto found = keybinds.find(name);
+    if (found == keybinds.end()) {
+        return "?";
+    }
+    const char* label = keyname(found->second);
+    return label ? label : "?";
+}
+
+static void drawAttached(WINDOW* win, const std::string& socketPath, const json& status, const std::unordered_map<std::string, int>& keybinds) {
+    werase(win);
+    box(win, 0, 0);
+    wattron(win, A_BOLD);
+    mvwprintw(win, 1, 2, "LITEMUS - attached to %s", socketPath.c_str());
+    wattroff(win, A_BOLD);
+
+    std::string state = status.value("state", "stopped");
+    if (status.contains("title")) {
+        uint32_t positionMs = static_cast<uint32_t>(status.value("position", 0.0) * 1000.0);
+        uint32_t durationMs = static_cast<uint32_t>(status.value("duration", 0.0) * 1000.0);
+        wattron(win, COLOR_PAIR(3));
+        mvwprintw(win, 3, 4, "%s", status.value("title", "").c_str());
+        wattroff(win, COLOR_PAIR(3));
+        mvwprintw(win, 4, 4, "%s - %s", status.value("artist", "").c_str(), status.value("album", "").c_str());
+        mvwprintw(win, 6, 4, "%s  %s / %s", state.c_str(), formatDuration(positionMs).c_str(), formatDuration(durationMs).c_str());
+    } else {
+        mvwprintw(win, 3, 4, "Nothing playing (%s)", state.c_str());
+    }
+    mvwprintw(win, 7, 4, "Volume %.0f, queue of %u songs, shuffle %s", status.value("volume", 0.0), status.value("queue", 0u),
+              status.value("shuffle", false) ? "on" : "off");
+
+    std::string help = keyLabel(keybinds, "toggle_playback") + " play/pause   " + keyLabel(keybinds, "play_next_song") + "/" +
+                       keyLabel(keybinds, "play_prev_song") + " next/prev   arrows seek   " + keyLabel(keybinds, "increase_volume") + "/" +
+                       keyLabel(keybinds, "decrease_volume") + " volume   " + keyLabel(keybinds, "toggle_shuffle") + " shuffle   " +
+                       keyLabel(keybinds, "quit") + " detach";
+    mvwprintw(win, 9, 4, "%s", help.c_str());
+    markDirty(win);
+}
+
+// Playback keys of the full UI, as daemon requests; everything else is ignored here
+static std::string keyCommand(int ch, std::unordered_map<std::string, int>& keybinds) {
+    if (ch == keybinds["toggle_playback"]) return "toggle";
+    if (ch == keybinds["play_next_song"]) return "next";
+    if (ch == keybinds["play_prev_song"]) return "prev";
+    if (ch == KEY_RIGHT || ch == keybinds["key_right"]) return "seek +5";
+    if (ch == KEY_LEFT || ch == keybinds["key_left"]) return "seek -5";
+    if (ch == keybinds["forward_seek_song_60s"]) return "seek +60";
+    if (ch == keybinds["backward_seek_song_60s"]) return "seek -60";
+    if (ch == keybinds["replay_current_song"]) return "seek 0";
+    if (ch == keybinds["increase_volume"]) return "volume +10";
+    if (ch == keybinds["decrease_volume"]) return "volume -10";
+    if (ch == keybinds["toggle_shuffle"]) return "shuffle";
+    return "";
+}
+
+int lmus_attach_main(const std::string& socketPath, std::unordered_map<std::string, int>& keybinds) {
+    ControlClient client;
+    if (!client.connect(socketPath)) {
+        std::cerr << "[ERROR] No `lmus daemon` is listening on " << socketPath << std::endl;
+        return 1;
+    }
+    ncursesSetup();
+    nodelay(stdscr, TRUE);
+    WINDOW* win = newwin(11, COLS, 0, 0);
+    compositorAddPanel(win);
+    LoopEvents events;
+    if (!events.open()) {
+        endwin();
+        std::cerr << "[ERROR] Could not create the timer / wakeup descriptors for the main loop." << std::endl;
+        return -1;
+    }
+    events.setTickInterval(1000);  // the position moves on the daemon's side
+
+    bool connected = true;
+    bool detaching = false;
+    std::string reply;
+    while (connected && !detaching) {
+        int ch;
+        while ((ch = getch()) != ERR) {
+            if (ch == KEY_RESIZE) {
+                clearok(curscr, TRUE);
+                wresize(win, 11, COLS);
+                markAllDirty();
+            } else if (ch == keybinds["quit"] || ch == keybinds["force_quit"]) {
+                detaching = true;
+            } else {
+                std::string command = keyCommand(ch, keybinds);
+                // A refused request ("nothing is playing") changes nothing, the status shows why
+                connected = command.empty() || client.request(command, reply);
+            }
+        }
+        if (detaching || !connected || !(connected = client.request("status", reply))) {
+            break;
+        }
+        json status = json::parse(reply.compare(0, 3, "OK ") == 0 ? reply.substr(3) : "{}", nullptr, false);
+        drawAttached(win, socketPath, status.is_object() ? status : json::object(), keybinds);
+        flushFrame();
+        if (events.wait() & LOOP_EVENT_HANGUP) {
+            break;
+        }
+    }
+
+    delwin(win);
+    endwin();
+    if (!connected) {
+        std::cerr << "[ERROR] The daemon on " << socketPath << " went away" << std::endl;
+        return 1;
+    }
+    std::cout << "Detached, the daemon keeps playing. `lmus ctl quit` stops it." << std::endl;
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "../dirScanner.hpp"
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Returns the index of the matching extension or -1
+static int matchExtension(const char* name, size_t nameLen, const std::vector<std::string>& extensions) {
+    if (name[0] == '.') {
+        return -1; // hidden files were never picked up by the shell glob either
+    }
+    for (size_t i = 0; i < extensions.size(); ++i) {
+        const std::string& ext = extensions[i];
+        if (nameLen > ext.size() && memcmp(name + nameLen - ext.size(), ext.data(), ext.size()) == 0) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+#ifdef SYS_getdents64
+struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[256]; // actually d_reclen - 19 bytes, NUL terminated
+};
+
+static bool scanWithGetdents(const std::string& dirPath, const std::vector<std::string>& extensions, std::vector<std::pair<int, FileRecord>>& found, size_t& entriesSeen) {
+    int dirFd = open(dirPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirFd < 0) {
+        return false;
+    }
+
+    alignas(linux_dirent64) char buffer[64 * 1024];
+    while (true) {
+        long nread = syscall(SYS_getdents64, dirFd, buffer, sizeof(buffer));
+        if (nread < 0) {
+            close(dirFd);
+            return false;
+        }
+        if (nread == 0) {
+            break;
+        }
+        for (long pos = 0; pos < nread;) {
+            auto* entry = reinterpret_cast<linux_dirent64*>(buffer + pos);
+            pos += entry->d_reclen;
+            entriesSeen++;
+
+            if (entry->d_type != DT_REG && entry->d_type != DT_LNK && entry->d_type != DT_UNKNOWN) {
+                continue;
+            }
+            int extIndex = matchExtension(entry->d_name, strlen(entry->d_name), extensions);
+            if (extIndex < 0) {
+                continue;
+            }
+
+            struct stat st;
+            if (fstatat(dirFd, entry->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) {
+                continue;
+            }
+            found.push_back({extIndex, {st.st_ino, entry->d_name, st.st_size, st.st_mtime}});
+        }
+    }
+
+    close(dirFd);
+    return true;
+}
+#endif
+
+static void scanWithFilesystem(const std::string& dirPath, const std::vector<std::string>& extensions, std::vector<std::pair<int, FileRecord>>& found, size_t& entriesSeen) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dirPath, ec)) {
+        entriesSeen++;
+        std::string name = entry.path().filename().string();
+        int extIndex = matchExtension(name.c_str(), name.size(), extensions);
+        if (extIndex < 0) {
+            continue;
+        }
+        struct stat st;
+        if (stat(entry.path().c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+            continue;
+        }
+        found.push_back({extIndex, {st.st_ino, name, st.st_size, st.st_mtime}});
+    }
+}
+
+std::vector<FileRecord> scanSongDirectory(const std::string& dirPath, const std::vector<std::string>& extensions, ScanStats& stats) {
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<std::pair<int, FileRecord>> found;
+    size_t entriesSeen = 0;
+
+#ifdef SYS_getdents64
+    if (!scanWithGetdents(dirPath, extensions, found, entriesSeen)) {
+        found.clear();
+        entriesSeen = 0;
+        scanWithFilesystem(dirPath, extensions, found, entriesSeen);
+    }
+#else
+    scanWithFilesystem(dirPath, extensions, found, entriesSeen);
+#endif
+
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+        if (a.first != b.first) return a.first < b.first;
+        return a.second.path < b.second.path;
+    });
+
+    std::vector<FileRecord> records;
+    records.reserve(found.size());
+    for (auto& item : found) {
+        records.push_back(std::move(item.second));
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    stats.entriesSeen = entriesSeen;
+    stats.elapsedSeconds = elapsed.count();
+    stats.entriesPerSecond = stats.elapsedSeconds > 0.0 ? entriesSeen / stats.elapsedSeconds : 0.0;
+    return records;
+}
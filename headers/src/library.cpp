@@ -0,0 +1,336 @@
+#include "../library.hpp"
+#include "../parsers.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <numeric>
+#include <unordered_map>
+
+// The whole session indexes these spans without further checks, so a corrupt index is refused here
+static bool spanFits(uint32_t first, uint32_t count, uint32_t size) {
+    return first <= size && count <= size - first;
+}
+
+bool Library::load(const LibraryIndex& index, const std::string& songsDirectory) {
+    tracks.clear();
+    albums.clear();
+    artists.clear();
+    menuOrder.clear();
+    menuPositions.clear();
+    menuNames.clear();
+    views = {};
+    playlistNames.clear();
+    if (!index.isOpen()) {
+        return false;
+    }
+
+    artists.reserve(index.artistCount());
+    for (uint32_t id = 0; id < index.artistCount(); ++id) {
+        const IndexArtist& a = index.artist(id);
+        if (!spanFits(a.firstTrack, a.trackCount, index.trackCount()) || !spanFits(a.firstAlbum, a.albumCount, index.albumCount())) {
+            return false;
+        }
+        artists.push_back({std::string(index.str(a.name)), a.firstAlbum, a.albumCount, a.firstTrack, a.trackCount});
+    }
+
+    albums.reserve(index.albumCount());
+    for (uint32_t id = 0; id < index.albumCount(); ++id) {
+        const IndexAlbum& a = index.album(id);
+        if (!spanFits(a.firstTrack, a.trackCount, index.trackCount()) || a.artist >= index.artistCount()) {
+            return false;
+        }
+        albums.push_back({std::string(index.str(a.name)), std::string(index.str(a.date).substr(0, 4)), a.artist, a.firstTrack, a.trackCount, a.loudness, a.peak});
+    }
+
+    tracks.reserve(index.trackCount());
+    for (uint32_t id = 0; id < index.trackCount(); ++id) {
+        const IndexTrack& t = index.track(id);
+        if (t.artist >= index.artistCount() || t.album >= index.albumCount()) {
+            return false;
+        }
+        LibraryTrack track;
+        track.title = std::string(index.str(t.title));
+        track.path = songsDirectory + std::string(index.str(t.fileName));
+        track.genre = std::string(index.str(t.genre));
+        track.date = std::string(index.str(t.date));
+        track.duration = formatDuration(t.durationMs);
+        track.artist = t.artist;
+        track.album = t.album;
+        track.disc = t.disc;
+        track.number = t.track;
+        track.durationMs = t.durationMs;
+        track.inode = t.inode;
+        track.lyricsOffset = t.lyricsOffset;
+        track.lyricsLength = t.lyricsLength;
+        track.loudness = t.loudness;
+        track.peak = t.peak;
+        tracks.push_back(std::move(track));
+    }
+
+    menuOrder.reserve(index.artistCount());
+    menuNames.reserve(index.artistCount());
+    menuPositions.assign(index.artistCount(), 0);
+    for (uint32_t position = 0; position < index.artistCount(); ++position) {
+        uint32_t id = index.artistAt(position);
+        if (id >= artists.size()) {
+            return false;
+        }
+        menuOrder.push_back(id);
+        menuPositions[id] = position;
+        menuNames.push_back(artists[id].name);
+    }
+    buildViews();
+    return true;
+}
+
+std::string Library::groupName(BrowseMode mode, const BrowseGroup& group) const {
+    std::string name;
+    appendGroupName(mode, group, name);
+    return name;
+}
+
+// Appends a decimal number without going through a temporary string
+static void appendNumber(std::string& text, uint32_t value) {
+    char digits[16];
+    int length = snprintf(digits, sizeof(digits), "%u", value);
+    text.append(digits, static_cast<size_t>(length));
+}
+
+void Library::appendGroupName(BrowseMode mode, const BrowseGroup& group, std::string& text) const {
+    switch (mode) {
+        case BrowseMode::Album:
+            text += albums[group.key].name;
+            text += " - ";
+            text += artists[albums[group.key].artist].name;
+            break;
+        case BrowseMode::Genre:
+            text += genreNames[group.key].empty() ? "(no genre)" : genreNames[group.key];
+            break;
+        case BrowseMode::Year:
+            if (group.key == 0) {
+                text += "Undated";
+            } else {
+                appendNumber(text, group.key);
+                text += 's';
+            }
+            break;
+        case BrowseMode::Playlist:
+            text += playlistNames[group.key];
+            break;
+        default:
+            text += artists[group.key].name;
+            break;
+    }
+}
+
+void Library::appendSectionLabel(BrowseMode mode, const BrowseSection& section, std::string& text) const {
+    if (mode == BrowseMode::Year) {
+        if (section.key == 0) {
+            text += "Undated";
+        } else {
+            appendNumber(text, section.key);
+        }
+        return;
+    }
+    const LibraryAlbum& album = albums[section.key];
+    // genres and playlists mix artists, the other views already name the artist in the left pane
+    if (mode == BrowseMode::Genre || mode == BrowseMode::Playlist) {
+        text += artists[album.artist].name;
+        text += " - ";
+    }
+    text += album.name;
+    text += " (";
+    text += album.year;
+    text += ')';
+}
+
+// Four digit year at the start of a date tag ("1994", "1994-05-02"), 0 when there is none
+static uint32_t tagYear(const std::string& date) {
+    if (date.size() < 4) {
+        return 0;
+    }
+    uint32_t year = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (!isdigit(static_cast<unsigned char>(date[i]))) {
+            return 0;
+        }
+        year = year * 10 + static_cast<uint32_t>(date[i] - '0');
+    }
+    return year;
+}
+
+static std::string lowerCase(const std::string& text) {
+    std::string lower = text;
+    for (char& c : lower) {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return lower;
+}
+
+// Cuts `ids`, already in browse order, into the view: a new group wherever groupKey changes
+// and a new section wherever sectionKey changes inside a group
+template <typename GroupKey, typename SectionKey>
+static void cutView(BrowseView& view, std::vector<uint32_t> ids, GroupKey groupKey, SectionKey sectionKey) {
+    for (uint32_t i = 0; i < ids.size(); ++i) {
+        uint32_t id = ids[i];
+        bool newGroup = i == 0 || groupKey(id) != groupKey(ids[i - 1]);
+        if (newGroup) {
+            view.groups.push_back({groupKey(id), i, 0, static_cast<uint32_t>(view.sections.size()), 0, 0});
+        }
+        if (newGroup || sectionKey(id) != sectionKey(ids[i - 1])) {
+            view.sections.push_back({sectionKey(id), i, 0});
+            view.groups.back().sectionCount++;
+        }
+        view.groups.back().count++;
+        view.sections.back().count++;
+    }
+    view.tracks = std::move(ids);
+}
+
+void Library::buildViews() {
+    std::vector<uint32_t> ids(tracks.size());
+    std::iota(ids.begin(), ids.end(), 0);
+
+    // Artists: tracks are stored in artist / album order already, groups follow the menu
+    BrowseView& byArtist = views[static_cast<size_t>(BrowseMode::Artist)];
+    byArtist.tracks = ids;
+    byArtist.sections.reserve(albums.size());
+    for (uint32_t id = 0; id < albums.size(); ++id) {
+        byArtist.sections.push_back({id, albums[id].firstTrack, albums[id].trackCount});
+    }
+    for (uint32_t id : menuOrder) {
+        const LibraryArtist& artist = artists[id];
+        byArtist.groups.push_back({id, artist.firstTrack, artist.trackCount, artist.firstAlbum, artist.albumCount, 0});
+    }
+
+    // Albums: by name across all artists, one section each. Sorted on the first eight bytes of
+    // the lowercased name packed big-endian (only names sharing all eight compare their text);
+    // the same name under several artists keeps artist order
+    std::vector<std::string> albumKeys(albums.size());
+    std::vector<std::pair<uint64_t, uint32_t>> keyed(albums.size());
+    for (uint32_t id = 0; id < albums.size(); ++id) {
+        albumKeys[id] = lowerCase(albums[id].name);
+        uint64_t key = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            key = (key << 8) | (i < albumKeys[id].size() ? static_cast<unsigned char>(albumKeys[id][i]) : 0u);
+        }
+        keyed[id] = {key, id};
+    }
+    std::sort(keyed.begin(), keyed.end(), [&albumKeys](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) {
+        if (a.first != b.first) {
+            return a.first < b.first;
+        }
+        int order = albumKeys[a.second].compare(albumKeys[b.second]);
+        return order != 0 ? order < 0 : a.second < b.second;
+    });
+    std::vector<uint32_t> albumTracks;
+    albumTracks.reserve(tracks.size());
+    for (const auto& entry : keyed) {
+        uint32_t id = entry.second;
+        for (uint32_t track = albums[id].firstTrack; track < albums[id].firstTrack + albums[id].trackCount; ++track) {
+            albumTracks.push_back(track);
+        }
+    }
+    auto trackAlbum = [this](uint32_t track) { return tracks[track].album; };
+    cutView(views[static_cast<size_t>(BrowseMode::Album)], std::move(albumTracks), trackAlbum, trackAlbum);
+
+    // Genres: spellings differing in case are one genre (named by the first met), untagged
+    // tracks come last; albums as sections
+    std::unordered_map<std::string, uint32_t> genreIds;
+    std::vector<std::string> genreKeys;
+    trackGenres.assign(tracks.size(), 0);
+    genreNames.clear();
+    for (uint32_t id = 0; id < tracks.size(); ++id) {
+        auto found = genreIds.emplace(lowerCase(tracks[id].genre), static_cast<uint32_t>(genreKeys.size()));
+        if (found.second) {
+            genreKeys.push_back(found.first->first);
+            genreNames.push_back(tracks[id].genre);
+        }
+        trackGenres[id] = found.first->second;
+    }
+    std::vector<uint32_t> genreOrder(genreKeys.size());
+    std::iota(genreOrder.begin(), genreOrder.end(), 0);
+    std::sort(genreOrder.begin(), genreOrder.end(), [&genreKeys](uint32_t a, uint32_t b) {
+        return genreKeys[a].empty() != genreKeys[b].empty() ? genreKeys[b].empty() : genreKeys[a] < genreKeys[b];
+    });
+    std::vector<uint32_t> genreRanks(genreKeys.size());
+    for (uint32_t rank = 0; rank < genreOrder.size(); ++rank) {
+        genreRanks[genreOrder[rank]] = rank;
+    }
+    std::vector<uint32_t> genreTracks = ids;
+    std::stable_sort(genreTracks.begin(), genreTracks.end(), [&](uint32_t a, uint32_t b) {
+        return genreRanks[trackGenres[a]] < genreRanks[trackGenres[b]];
+    });
+    cutView(views[static_cast<size_t>(BrowseMode::Genre)], std::move(genreTracks), [this](uint32_t track) { return trackGenres[track]; }, trackAlbum);
+
+    // Years: decades, oldest first and undated tracks last, with a section per year
+    trackYears.assign(tracks.size(), 0);
+    for (uint32_t id = 0; id < tracks.size(); ++id) {
+        uint32_t year = tagYear(tracks[id].date);
+        trackYears[id] = year != 0 ? year : tagYear(albums[tracks[id].album].year);
+    }
+    std::vector<uint32_t> yearTracks = ids;
+    std::stable_sort(yearTracks.begin(), yearTracks.end(), [this](uint32_t a, uint32_t b) {
+        return trackYears[a] - 1 < trackYears[b] - 1;  // 0 wraps around: undated sorts last
+    });
+    cutView(views[static_cast<size_t>(BrowseMode::Year)], std::move(yearTracks),
+            [this](uint32_t track) { return trackYears[track] / 10 * 10; }, [this](uint32_t track) { return trackYears[track]; });
+
+    for (BrowseView& view : views) {
+        setTitleWidths(view);
+    }
+}
+
+void Library::setTitleWidths(BrowseView& view) const {
+    for (BrowseGroup& group : view.groups) {
+        size_t width = 0;
+        for (uint32_t i = group.first; i < group.first + group.count; ++i) {
+            const LibraryTrack& track = tracks[view.tracks[i]];
+            width = std::max(width, track.title.length() + track.duration.length() + 10);
+        }
+        group.titleWidth = static_cast<uint32_t>(width);
+    }
+}
+
+// Playlists may share tracks, so each is cut on its own: its matches (in id order, hence
+// artist / album order) become one group with a section per album
+void Library::setPlaylists(const std::vector<std::string>& names, const std::vector<std::vector<uint32_t>>& matches) {
+    BrowseView& byPlaylist = views[static_cast<size_t>(BrowseMode::Playlist)];
+    byPlaylist = {};
+    playlistNames = names;
+    for (uint32_t position = 0; position < names.size(); ++position) {
+        const std::vector<uint32_t>& ids = matches[position];
+        uint32_t first = static_cast<uint32_t>(byPlaylist.tracks.size());
+        byPlaylist.groups.push_back({position, first, static_cast<uint32_t>(ids.size()), static_cast<uint32_t>(byPlaylist.sections.size()), 0, 0});
+        for (uint32_t i = 0; i < ids.size(); ++i) {
+            if (i == 0 || tracks[ids[i]].album != tracks[ids[i - 1]].album) {
+                byPlaylist.sections.push_back({tracks[ids[i]].album, first + i, 0});
+                byPlaylist.groups.back().sectionCount++;
+            }
+            byPlaylist.sections.back().count++;
+        }
+        byPlaylist.tracks.insert(byPlaylist.tracks.end(), ids.begin(), ids.end());
+    }
+    setTitleWidths(byPlaylist);
+}
+
+bool loadLibraryFile(Library& library, const std::string& indexFilePath, const std::string& songsDirectory) {
+    LibraryIndex libraryIndex;
+    return libraryIndex.open(indexFilePath) && library.load(libraryIndex, songsDirectory) && library.trackCount() > 0;
+}
+
+std::vector<uint32_t> mapTrackIds(const Library& from, const Library& to) {
+    std::unordered_map<uint64_t, uint32_t> byInode;
+    byInode.reserve(to.trackCount());
+    for (uint32_t id = 0; id < to.trackCount(); ++id) {
+        byInode.emplace(to.track(id).inode, id);
+    }
+    std::vector<uint32_t> ids(from.trackCount(), INDEX_NOT_FOUND);
+    for (uint32_t id = 0; id < from.trackCount(); ++id) {
+        auto found = byInode.find(from.track(id).inode);
+        if (found != byInode.end()) {
+            ids[id] = found->second;
+        }
+    }
+    return ids;
+}
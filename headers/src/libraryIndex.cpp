@@ -0,0 +1,65 @@
+#include "../libraryIndex.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+LibraryIndex::~LibraryIndex() {
+    close();
+}
+
+void LibraryIndex::close() {
+    if (base) {
+        munmap(base, mappedSize);
+    }
+    base = nullptr;
+    mappedSize = 0;
+    header = nullptr;
+}
+
+// true when count elements of elemSize starting at offset fit inside size
+static bool tableFits(uint64_t offset, uint64_t count, uint64_t elemSize, uint64_t size) {
+    return offset <= size && count <= (size - offset) / elemSize;
+}
+
+bool LibraryIndex::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(IndexHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd); // the mapping keeps the file alive
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    base = mapped;
+    mappedSize = st.st_size;
+
+    const char* bytes = static_cast<const char*>(base);
+    header = reinterpret_cast<const IndexHeader*>(bytes);
+    uint64_t size = mappedSize;
+    if (memcmp(header->magic, LIBRARY_INDEX_MAGIC, sizeof(LIBRARY_INDEX_MAGIC)) != 0 || header->version != LIBRARY_INDEX_VERSION ||
+        !tableFits(header->artistsOffset, header->artistCount, sizeof(IndexArtist), size) ||
+        !tableFits(header->artistOrderOffset, header->artistCount, sizeof(uint32_t), size) ||
+        !tableFits(header->albumsOffset, header->albumCount, sizeof(IndexAlbum), size) ||
+        !tableFits(header->tracksOffset, header->trackCount, sizeof(IndexTrack), size) ||
+        !tableFits(header->heapOffset, header->heapSize, 1, size)) {
+        close();
+        return false;
+    }
+
+    artists = reinterpret_cast<const IndexArtist*>(bytes + header->artistsOffset);
+    artistOrder = reinterpret_cast<const uint32_t*>(bytes + header->artistOrderOffset);
+    albums = reinterpret_cast<const IndexAlbum*>(bytes + header->albumsOffset);
+    tracks = reinterpret_cast<const IndexTrack*>(bytes + header->tracksOffset);
+    heap = bytes + header->heapOffset;
+    heapSize = header->heapSize;
+    return true;
+}
@@ -0,0 +1,44 @@
+#include "../libraryRefresh.hpp"
+
+LibraryRefresh::~LibraryRefresh() {
+    if (worker.joinable()) {
+        // The scan stops between passes, or once its workers finish the files in hand; every
+        // cache file is renamed into place whole, so none is left half written
+        cancelled = true;
+        worker.join();
+    }
+}
+
+void LibraryRefresh::start(ScanJob scan, const std::string& indexFilePath, const std::string& songsDirectory) {
+    worker = std::thread([this, scan, indexFilePath, songsDirectory]() {
+        CacheSummary summary;
+        scan(summary, cancelled);
+        std::unique_ptr<Library> library;
+        if (summary.changed && !cancelled) {
+            library.reset(new Library);
+            if (!loadLibraryFile(*library, indexFilePath, songsDirectory)) {
+                library.reset();  // the session keeps the snapshot it opened with
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            fresh = std::move(library);
+            result = summary;
+            finished = true;
+        }
+        if (onFinished) {
+            onFinished();
+        }
+    });
+}
+
+bool LibraryRefresh::take(std::unique_ptr<Library>& library, CacheSummary& summary) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!finished) {
+        return false;
+    }
+    library = std::move(fresh);
+    summary = result;
+    finished = false;
+    return true;
+}
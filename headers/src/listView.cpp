@@ -0,0 +1,107 @@
+#include "../listView.hpp"
+#include "../compositor.hpp"
+
+static const char* const CURSOR_MARK = " ->";
+static const int MARK_WIDTH = 3;
+static const int FIRST_ROW_LINE = 2;  // line 0 is the border / title, line 1 stays blank
+
+void ListView::setRows(size_t rowCount, RowSource rowSource) {
+    count = rowCount;
+    source = std::move(rowSource);
+    cur = 0;
+    top = 0;
+    while (cur < count && !selectable(cur)) {
+        ++cur;
+    }
+    if (cur == count) {
+        cur = 0;
+    }
+}
+
+bool ListView::selectable(size_t row) const {
+    return !source.selectable || source.selectable(row);
+}
+
+int ListView::visibleRows() const {
+    if (!win) {
+        return 0;
+    }
+    int height = getmaxy(win);
+    return height - FIRST_ROW_LINE - 1 > 0 ? height - FIRST_ROW_LINE - 1 : 0;
+}
+
+void ListView::scrollToCursor() {
+    size_t rows = static_cast<size_t>(visibleRows());
+    if (rows == 0) {
+        return;
+    }
+    if (cur < top) {
+        top = cur;
+    } else if (cur >= top + rows) {
+        top = cur - rows + 1;
+    }
+    // A header directly above the cursor is pulled into view with it
+    if (top > 0 && top == cur && !selectable(top - 1)) {
+        --top;
+    }
+}
+
+bool ListView::setCursor(size_t row) {
+    if (row >= count || !selectable(row)) {
+        return false;
+    }
+    cur = row;
+    scrollToCursor();
+    return true;
+}
+
+bool ListView::moveDown() {
+    for (size_t row = cur + 1; row < count; ++row) {
+        if (selectable(row)) {
+            cur = row;
+            scrollToCursor();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ListView::moveUp() {
+    for (size_t row = cur; row-- > 0;) {
+        if (selectable(row)) {
+            cur = row;
+            scrollToCursor();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ListView::draw() {
+    if (!win) {
+        return;
+    }
+    int width = getmaxx(win) - 2;  // inside the left / right borders
+    int rows = visibleRows();
+    if (width <= MARK_WIDTH || rows == 0) {
+        return;
+    }
+    scrollToCursor();
+
+    for (int line = 0; line < rows; ++line) {
+        int y = FIRST_ROW_LINE + line;
+        mvwhline(win, y, 1, ' ', width);
+        size_t row = top + static_cast<size_t>(line);
+        if (row >= count) {
+            continue;
+        }
+        scratch.clear();
+        source.text(row, scratch);
+        chtype attr = row == cur ? fore : (selectable(row) ? back : grey);
+        mvwaddstr(win, y, 1, row == cur ? CURSOR_MARK : "   ");
+        wattron(win, attr);
+        mvwaddnstr(win, y, 1 + MARK_WIDTH, scratch.c_str(), width - MARK_WIDTH);
+        wattroff(win, attr);
+    }
+    markDirty(win);
+}
@@ -16,53 +16,6 @@ const string BOLD = "\033[1m";
 const vector<string> extensions = {".mp3", ".wav", ".flac"};
 
 
-struct SongMetadata {
-    string fileName;
-    string inode;
-    string artist;
-    string album;
-    string title;
-    int disc;
-    int track;
-    string genre;
-    string date;
-    string lyrics;
-};
-
-// Function to get the list of inodes
-vector<string> getInodes() {
-    vector<string> inodes;
-    for (const string& ext : extensions) {
-        const string output_cmd = "ls -i *" + ext + " | awk '{print $1}'";
-        string output = executeCommand(output_cmd);
-        stringstream ss(output);
-        string inode;
-
-        while (getline(ss, inode, '\n')) {
-            if (!inode.empty()) {
-                inodes.push_back(inode);
-            }
-        }
-    }
-    return inodes;
-}
-
-
-// Function to get the file name from an inode
-string getFileNameFromInode(const string& inode) {
-    string findCmd = "find . -type f -inum " + inode + " | sed 's|\\./||'";
-    string result = executeCommand(findCmd);
-
-    stringstream ss(result);
-    string fileName;
-    getline(ss, fileName, '\n');
-    if (fileName.empty()) {
-        printErrorAndExit("[ERROR] No file found with the given inode.");
-    }
-
-    return fileName;
-}
-
 // Function to escape special characters in filename
 string escapeSpecialCharacters(const string& fileName) {
     string escapedFileName;
@@ -78,15 +31,36 @@ string escapeSpecialCharacters(const string& fileName) {
 
 
 
-void storeMetadataJSON(const string& inode, const string& fileName, json& artistsArray, vector<SongMetadata>& songMetadata, const string debugFile) {
-    // Escape special characters in the filename
-    string escapedFileName = escapeSpecialCharacters(fileName);
-
-    // Construct the ffprobe command with the escaped filename
-    string metadataCmd = "ffprobe -v quiet -print_format json -show_format '" + escapedFileName + "'";
-    string metadataInfo = executeCommand(metadataCmd);
+static string toLowerKey(string key) {
+    transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return tolower(c); });
+    return key;
+}
 
-    auto metadata = json::parse(metadataInfo);
+// Runs on the extraction workers: touches no shared state, the debug log
+// lines are handed back in logText for the owning thread to write. The file is read from
+// songDirectory, the metadata keeps the bare fileName the library joins back onto it
+SongMetadata storeMetadataJSON(const string& inode, const string& songDirectory, const string& fileName, string& logText) {
+    const string filePath = songDirectory + fileName;
+    TagMap tags;
+    string tagSource;
+    if (!readNativeTags(filePath, tags, tagSource)) {
+        // Escape special characters in the filename
+        string escapedFileName = escapeSpecialCharacters(filePath);
+
+        // Construct the ffprobe command with the escaped filename
+        string metadataCmd = "ffprobe -v quiet -print_format json -show_format '" + escapedFileName + "'";
+        string metadataInfo = executeCommand(metadataCmd);
+
+        json metadata = json::parse(metadataInfo, nullptr, false);
+        if (!metadata.is_discarded() && metadata.contains("format") && metadata["format"].contains("tags")) {
+            for (const auto& [key, value] : metadata["format"]["tags"].items()) {
+                if (value.is_string()) {
+                    tags[toLowerKey(key)] = value.get<string>();
+                }
+            }
+        }
+        tagSource = "ffprobe";
+    }
 
     string artist = "Unknown_Artist";
     string album = "Unknown_Album";
@@ -98,126 +72,92 @@ void storeMetadataJSON(const string& inode, const string& fileName, json& artist
     string lyrics = "";
 
     // Log the metadata extraction process
-    ofstream logFile(debugFile, ios::app);
-    if (logFile.is_open()) {
-        logFile << "Storing Metadata for: " << fileName << endl;
-        logFile << "Inode: " << inode << endl;
-
-        if (metadata["format"]["tags"].contains("artist") || metadata["format"]["tags"].contains("ARTIST")) {
-            artist = metadata["format"]["tags"].contains("artist") ? 
-                     metadata["format"]["tags"]["artist"].get<string>() : 
-                     metadata["format"]["tags"]["ARTIST"].get<string>();
-            logFile << "Artist: extracted successfully +" << endl;
+    ostringstream logFile;
+    logFile << "Storing Metadata for: " << fileName << endl;
+    logFile << "Inode: " << inode << endl;
+    logFile << "Tags: " << tagSource << endl;
+
+    auto extractString = [&](const string& key, const string& label, string& field) {
+        auto it = tags.find(key);
+        if (it != tags.end()) {
+            field = it->second;
+            logFile << label << ": extracted successfully +" << endl;
         } else {
-            logFile << "Artist: extraction failed -" << endl;
+            logFile << label << ": extraction failed -" << endl;
         }
-
-        if (metadata["format"]["tags"].contains("album") || metadata["format"]["tags"].contains("ALBUM")) {
-            album = metadata["format"]["tags"].contains("album") ? 
-                    metadata["format"]["tags"]["album"].get<string>() : 
-                    metadata["format"]["tags"]["ALBUM"].get<string>();
-            logFile << "Album: extracted successfully +" << endl;
-        } else {
-            logFile << "Album: extraction failed -" << endl;
-        }
-
-        if (metadata["format"]["tags"].contains("title") || metadata["format"]["tags"].contains("TITLE")) {
-            title = metadata["format"]["tags"].contains("title") ? 
-                    metadata["format"]["tags"]["title"].get<string>() : 
-                    metadata["format"]["tags"]["TITLE"].get<string>();
-            logFile << "Title: extracted successfully +" << endl;
-        } else {
-            logFile << "Title: extraction failed -" << endl;
-        }
-
-        if (metadata["format"]["tags"].contains("disc") || metadata["format"]["tags"].contains("DISC")) {
-            string discStr = metadata["format"]["tags"].contains("disc") ? 
-                             metadata["format"]["tags"]["disc"].get<string>() : 
-                             metadata["format"]["tags"]["DISC"].get<string>();
-            try {
-                disc = std::stoi(discStr);
-                logFile << "Disc: extracted successfully +" << endl;
-            } catch (const std::invalid_argument&) {
-                logFile << "Disc: extraction failed -" << endl;
-            }
-        } else {
-            logFile << "Disc: extraction failed -" << endl;
-        }
-
-        if (metadata["format"]["tags"].contains("track") || metadata["format"]["tags"].contains("TRACK")) {
-            string trackStr = metadata["format"]["tags"].contains("track") ? 
-                              metadata["format"]["tags"]["track"].get<string>() : 
-                              metadata["format"]["tags"]["TRACK"].get<string>();
-            try {
-                track = std::stoi(trackStr);
-                logFile << "Track: extracted successfully +" << endl;
-            } catch (const std::invalid_argument&) {
-                logFile << "Track: extraction failed -" << endl;
+    };
+    auto extractNumber = [&](const string& key, const string& label, int& field) {
+        auto it = tags.find(key);
+        try {
+            if (it == tags.end()) {
+                throw std::invalid_argument(key);
             }
-        } else {
-            logFile << "Track: extraction failed -" << endl;
-        }
-
-        if (metadata["format"]["tags"].contains("genre") || metadata["format"]["tags"].contains("GENRE")) {
-            genre = metadata["format"]["tags"].contains("genre") ? 
-                    metadata["format"]["tags"]["genre"].get<string>() : 
-                    metadata["format"]["tags"]["GENRE"].get<string>();
-            logFile << "Genre: extracted successfully +" << endl;
-        } else {
-            logFile << "Genre: extraction failed -" << endl;
-        }
-
-        if (metadata["format"]["tags"].contains("date") || metadata["format"]["tags"].contains("DATE")) {
-            date = metadata["format"]["tags"].contains("date") ? 
-                   metadata["format"]["tags"]["date"].get<string>() : 
-                   metadata["format"]["tags"]["DATE"].get<string>();
-            logFile << "Date: extracted successfully +" << endl;
-        } else {
-            logFile << "Date: extraction failed -" << endl;
+            field = std::stoi(it->second);
+            logFile << label << ": extracted successfully +" << endl;
+        } catch (const std::exception&) {
+            logFile << label << ": extraction failed -" << endl;
         }
+    };
+
+    extractString("artist", "Artist", artist);
+    extractString("album", "Album", album);
+    extractString("title", "Title", title);
+    extractNumber("disc", "Disc", disc);
+    extractNumber("track", "Track", track);
+    extractString("genre", "Genre", genre);
+    extractString("date", "Date", date);
+
+    // USLT frames come out as lyrics-<lang> (lyrics-XXX when the language is unset)
+    auto lyricsIt = tags.lower_bound("lyrics");
+    if (lyricsIt != tags.end() && lyricsIt->first.compare(0, 6, "lyrics") == 0) {
+        lyrics = lyricsIt->second;
+        logFile << "Lyrics: extracted successfully +" << endl;
+    } else {
+        logFile << "Lyrics: extraction failed -" << endl;
+    }
 
-        if (metadata["format"]["tags"].contains("lyrics-XXX") || metadata["format"]["tags"].contains("LYRICS-XXX")) {
-            lyrics = metadata["format"]["tags"].contains("lyrics-XXX") ? 
-                     metadata["format"]["tags"]["lyrics-XXX"].get<string>() : 
-                     metadata["format"]["tags"]["LYRICS-XXX"].get<string>();
-            logFile << "Lyrics: extracted successfully +" << endl;
+    // Headers first; only files whose headers do not tell get decoded, and only here at scan time
+    uint32_t durationMs = probeDurationMs(filePath);
+    if (durationMs > 0) {
+        logFile << "Duration: " << durationMs << " ms (headers)" << endl;
+    } else {
+        sf::InputSoundFile soundFile;
+        if (soundFile.openFromFile(filePath)) {
+            durationMs = static_cast<uint32_t>(soundFile.getDuration().asMilliseconds());
+            logFile << "Duration: " << durationMs << " ms (decoder)" << endl;
         } else {
-            logFile << "Lyrics: extraction failed -" << endl;
+            logFile << "Duration: extraction failed -" << endl;
         }
-
-        logFile << "--------------------------------------" << endl;
-        logFile.close();
-    } else {
-        cerr << "Unable to open debug log file" << endl;
     }
 
-    // Check if artist is already in the array
-    if (find(artistsArray.begin(), artistsArray.end(), artist) == artistsArray.end()) {
-        artistsArray.push_back(artist);
-    }
+    logFile << "--------------------------------------" << endl;
+    logText = logFile.str();
 
-    // Store metadata
-    songMetadata.push_back({fileName, inode, artist, album, title, disc, track, genre, date, lyrics});
+    return {fileName, inode, artist, album, title, disc, track, genre, date, lyrics, durationMs, LOUDNESS_NOT_MEASURED, LOUDNESS_NOT_MEASURED};
 }
 
+// The store functions return false when their file could not be written and leave reporting
+// it to lmus_cache_main, which must not exit behind a running session
+
 // Function to save artists to a file
-void saveArtistsToFile(const json& artistsArray, const string& filePath) {
+bool saveArtistsToFile(const json& artistsArray, const string& filePath) {
     ofstream outFile(filePath, ios::trunc);
-    if (outFile.is_open()) {
-        outFile << artistsArray.dump(4);
-        outFile.close();
-    } else {
-        printErrorAndExit("[ERROR] Unable to save artists to file: " + filePath);
+    if (!outFile.is_open()) {
+        return false;
     }
+    outFile << artistsArray.dump(4);
+    outFile.close();
+    return static_cast<bool>(outFile);
 }
 
-void saveSongDirToFile(const std::string& songDirPath, const string& songDirectory) {
+bool saveSongDirToFile(const std::string& songDirPath, const string& songDirectory) {
   std::fstream songDirFile(songDirPath, std::ios::out);
   if (!songDirFile) {
-      printErrorAndExit("[ERROR] Unable to save song directory to file: songDirectory.txt");
+      return false;
   }
   songDirFile << songDirectory;
   songDirFile.close();
+  return static_cast<bool>(songDirFile);
 }
 
 // Function to print artists
@@ -228,7 +168,7 @@ void printArtists(const json& artistsArray) {
     }
 }
 
-void storeSongsJSON(const string& filePath, const vector<SongMetadata>& songMetadata, const string debugFile) {
+bool storeSongsJSON(const string& filePath, const vector<SongMetadata>& songMetadata, const string debugFile, ostream& log) {
     json songsJson;
 
     for (const auto& song : songMetadata) {
@@ -242,8 +182,20 @@ void storeSongsJSON(const string& filePath, const vector<SongMetadata>& songMeta
                 {"track", song.track},
                 {"genre", song.genre},
                 {"date", song.date},
-                {"lyrics", song.lyrics}
+                {"duration", song.durationMs}
             };
+            // The text itself lives in lyrics.dat, this file only points at it
+            if (song.lyricsLength > 0) {
+                songInfo["lyricsOffset"] = song.lyricsOffset;
+                songInfo["lyricsLength"] = song.lyricsLength;
+            }
+            // JSON has no NaN: unmeasured songs simply have no loudness / peak keys
+            if (!std::isnan(song.loudness)) {
+                songInfo["loudness"] = song.loudness;
+            }
+            if (!std::isnan(song.peak)) {
+                songInfo["peak"] = song.peak;
+            }
 
             // Ensure the artist exists in the JSON structure
             if (!songsJson.contains(song.artist)) {
@@ -268,7 +220,7 @@ void storeSongsJSON(const string& filePath, const vector<SongMetadata>& songMeta
             // Assign songInfo to the track index
             songsJson[song.artist][song.album][song.disc - 1][song.track - 1] = songInfo;
         } else {
-            cerr << "Skipping invalid song metadata: " << song.fileName << endl;
+            log << "Skipping invalid song metadata: " << song.fileName << endl;
             // Print out the metadata for debugging
             ofstream logFile(debugFile, ios::trunc);
             if (logFile.is_open()) {
@@ -280,50 +232,427 @@ void storeSongsJSON(const string& filePath, const vector<SongMetadata>& songMeta
     }
 
     ofstream outFile(filePath, ios::trunc);
-    if (outFile.is_open()) {
-        outFile << songsJson.dump(4);
-        outFile.close();
-    } else {
-        printErrorAndExit("[ERROR] Unable to save song names to file: " + filePath);
+    if (!outFile.is_open()) {
+        return false;
     }
+    outFile << songsJson.dump(4);
+    outFile.close();
+    return static_cast<bool>(outFile);
+}
+
+// Sort songMetadata by artist, album, disc, and track
+void sortSongMetadata(vector<SongMetadata>& songMetadata) {
+    sort(songMetadata.begin(), songMetadata.end(), [](const SongMetadata& a, const SongMetadata& b) {
+        if (a.artist != b.artist) return a.artist < b.artist;
+        if (a.album != b.album) return a.album < b.album;
+        if (a.disc != b.disc) return a.disc < b.disc;
+        return a.track < b.track;
+    });
 }
 
-// Function to compare two inode vectors
-bool compareInodeVectors(const vector<string>& vec1, const vector<string>& vec2) {
-    if (vec1.size() != vec2.size()) {
+// Writes the mmap-able library index (see libraryIndex.hpp) from the sorted metadata.
+// Tracks follow the same rules as storeSongsJSON: invalid entries are skipped and a repeated
+// artist/album/disc/track slot keeps the last song, so both files list the same tracks.
+bool storeLibraryIndex(const string& filePath, const vector<SongMetadata>& songMetadata, const json& artistsArray) {
+    vector<const SongMetadata*> songs;
+    songs.reserve(songMetadata.size());
+    for (const auto& song : songMetadata) {
+        if (song.artist.empty() || song.album.empty() || song.disc <= 0 || song.track <= 0) {
+            continue;
+        }
+        if (!songs.empty()) {
+            const SongMetadata* last = songs.back();
+            if (last->artist == song.artist && last->album == song.album && last->disc == song.disc && last->track == song.track) {
+                songs.back() = &song;
+                continue;
+            }
+        }
+        songs.push_back(&song);
+    }
+
+    string heap;
+    unordered_map<string, IndexString> interned;
+    auto addString = [&](const string& value) {
+        auto it = interned.find(value);
+        if (it != interned.end()) {
+            return it->second;
+        }
+        IndexString ref{static_cast<uint32_t>(heap.size()), static_cast<uint32_t>(value.size())};
+        heap += value;
+        interned.emplace(value, ref);
+        return ref;
+    };
+
+    vector<IndexArtist> artists;
+    vector<IndexAlbum> albums;
+    vector<IndexTrack> tracks;
+    tracks.reserve(songs.size());
+    for (const SongMetadata* song : songs) {
+        uint32_t trackId = static_cast<uint32_t>(tracks.size());
+        if (artists.empty() || heap.compare(artists.back().name.offset, artists.back().name.length, song->artist) != 0) {
+            artists.push_back({addString(song->artist), static_cast<uint32_t>(albums.size()), 0, trackId, 0});
+        }
+        IndexArtist& artist = artists.back();
+        if (artist.albumCount == 0 || heap.compare(albums.back().name.offset, albums.back().name.length, song->album) != 0) {
+            albums.push_back({addString(song->album), addString(song->date), static_cast<uint32_t>(artists.size() - 1), trackId, 0, LOUDNESS_NOT_MEASURED, LOUDNESS_NOT_MEASURED, 0});
+            artist.albumCount++;
+        }
+        albums.back().trackCount++;
+        artist.trackCount++;
+
+        IndexTrack track{};
+        track.title = addString(song->title);
+        track.fileName = addString(song->fileName);
+        track.genre = addString(song->genre);
+        track.date = addString(song->date);
+        track.artist = static_cast<uint32_t>(artists.size() - 1);
+        track.album = static_cast<uint32_t>(albums.size() - 1);
+        track.disc = static_cast<uint32_t>(song->disc);
+        track.track = static_cast<uint32_t>(song->track);
+        track.inode = strtoull(song->inode.c_str(), nullptr, 10);
+        track.lyricsOffset = song->lyricsOffset;
+        track.lyricsLength = song->lyricsLength;
+        track.durationMs = song->durationMs == DURATION_NOT_CACHED ? 0 : song->durationMs;
+        track.loudness = song->loudness;
+        track.peak = song->peak;
+        tracks.push_back(track);
+    }
+
+    // Album gain comes from the album's tracks; its peak is the loudest track's
+    for (IndexAlbum& album : albums) {
+        vector<float> lufs;
+        vector<uint32_t> durations;
+        float peak = LOUDNESS_NOT_MEASURED;
+        for (uint32_t id = album.firstTrack; id < album.firstTrack + album.trackCount; ++id) {
+            lufs.push_back(tracks[id].loudness);
+            durations.push_back(tracks[id].durationMs);
+            peak = fmax(peak, tracks[id].peak);  // fmax skips NaN
+        }
+        album.loudness = combineLoudness(lufs, durations);
+        album.peak = peak;
+    }
+
+    // Menu order: artists.json order, for artists that still own tracks
+    vector<uint32_t> artistOrder;
+    for (const auto& name : artistsArray) {
+        string artistName = name.get<string>();
+        auto it = lower_bound(artists.begin(), artists.end(), artistName, [&](const IndexArtist& a, const string& key) {
+            return heap.compare(a.name.offset, a.name.length, key) < 0;
+        });
+        if (it != artists.end() && heap.compare(it->name.offset, it->name.length, artistName) == 0) {
+            artistOrder.push_back(static_cast<uint32_t>(it - artists.begin()));
+        }
+    }
+
+    // Every artist needs a menu slot; ones missing from artists.json go at the end
+    vector<bool> listed(artists.size(), false);
+    for (uint32_t id : artistOrder) listed[id] = true;
+    for (uint32_t id = 0; id < artists.size(); ++id) {
+        if (!listed[id]) artistOrder.push_back(id);
+    }
+
+    IndexHeader header{};
+    memcpy(header.magic, LIBRARY_INDEX_MAGIC, sizeof(header.magic));
+    header.version = LIBRARY_INDEX_VERSION;
+    header.trackCount = static_cast<uint32_t>(tracks.size());
+    header.artistCount = static_cast<uint32_t>(artists.size());
+    header.albumCount = static_cast<uint32_t>(albums.size());
+
+    auto align8 = [](uint64_t offset) { return (offset + 7) & ~static_cast<uint64_t>(7); };
+    uint64_t offset = align8(sizeof(IndexHeader));
+    header.artistsOffset = offset;
+    offset = align8(offset + artists.size() * sizeof(IndexArtist));
+    header.artistOrderOffset = offset;
+    offset = align8(offset + artists.size() * sizeof(uint32_t));
+    header.albumsOffset = offset;
+    offset = align8(offset + albums.size() * sizeof(IndexAlbum));
+    header.tracksOffset = offset;
+    offset = align8(offset + tracks.size() * sizeof(IndexTrack));
+    header.heapOffset = offset;
+    header.heapSize = heap.size();
+
+    // Written to a temporary file and renamed, so a reader never maps a half written index
+    const string tempPath = filePath + ".tmp";
+    ofstream outFile(tempPath, ios::binary | ios::trunc);
+    if (!outFile.is_open()) {
         return false;
     }
-    for (size_t i = 0; i < vec1.size(); ++i) {
-        if (vec1[i] != vec2[i]) {
-            return false;
+    auto writeAt = [&](uint64_t position, const void* data, size_t size) {
+        static const char zeros[8] = {};
+        while (static_cast<uint64_t>(outFile.tellp()) < position) {
+            outFile.write(zeros, min<uint64_t>(8, position - outFile.tellp()));
         }
+        outFile.write(static_cast<const char*>(data), size);
+    };
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.artistsOffset, artists.data(), artists.size() * sizeof(IndexArtist));
+    writeAt(header.artistOrderOffset, artistOrder.data(), artistOrder.size() * sizeof(uint32_t));
+    writeAt(header.albumsOffset, albums.data(), albums.size() * sizeof(IndexAlbum));
+    writeAt(header.tracksOffset, tracks.data(), tracks.size() * sizeof(IndexTrack));
+    writeAt(header.heapOffset, heap.data(), heap.size());
+    outFile.close();
+    if (!outFile || rename(tempPath.c_str(), filePath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
     }
     return true;
 }
 
+// Splits the current scan against the previous snapshot.
+// A file counts as modified when its inode survived but its size or mtime moved.
+CacheDiff diffInodeSnapshots(const vector<FileRecord>& records, const vector<InodeSnapshot>& previous) {
+    unordered_map<string, const InodeSnapshot*> previousByInode;
+    previousByInode.reserve(previous.size());
+    for (const InodeSnapshot& snapshot : previous) {
+        previousByInode[snapshot.inode] = &snapshot;
+    }
+
+    CacheDiff diff;
+    unordered_set<string> seen;
+    seen.reserve(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        string inode = to_string(records[i].inode);
+        seen.insert(inode);
+        auto it = previousByInode.find(inode);
+        if (it == previousByInode.end()) {
+            diff.added.push_back(i);
+        } else if (it->second->size != static_cast<long long>(records[i].size) || it->second->mtime != static_cast<long long>(records[i].mtime)) {
+            diff.modified.push_back(i);
+        }
+    }
+    for (const InodeSnapshot& snapshot : previous) {
+        if (seen.find(snapshot.inode) == seen.end()) {
+            diff.removed.push_back(snapshot.inode);
+        }
+    }
+    return diff;
+}
+
 // Function to load previous inodes from file
-vector<string> loadPreviousInodes(const string& filePath) {
-    vector<string> previousInodes;
+// Caches written before sizes and mtimes were tracked hold plain inode strings,
+// those come back with size/mtime of -1 so every file is treated as modified once
+vector<InodeSnapshot> loadPreviousInodes(const string& filePath) {
+    vector<InodeSnapshot> previousInodes;
     ifstream inFile(filePath);
     if (inFile.is_open()) {
-        json inodesJson;
-        inFile >> inodesJson;
+        json inodesJson = json::parse(inFile, nullptr, false);
         inFile.close();
-        previousInodes = inodesJson.get<vector<string>>();
+        if (!inodesJson.is_array()) {
+            return previousInodes;
+        }
+        for (const auto& entry : inodesJson) {
+            if (entry.is_string()) {
+                previousInodes.push_back({entry.get<string>(), -1, -1});
+            } else if (entry.is_object() && entry.contains("inode")) {
+                previousInodes.push_back({entry["inode"].get<string>(), entry.value("size", -1LL), entry.value("mtime", -1LL)});
+            }
+        }
     }
     return previousInodes;
 }
 
 // Function to save current inodes to file
-void saveCurrentInodes(const vector<string>& inodes, const string& filePath) {
-    json inodesJson = inodes;
+bool saveCurrentInodes(const vector<FileRecord>& records, const string& filePath) {
+    json inodesJson = json::array();
+    for (const FileRecord& record : records) {
+        inodesJson.push_back({
+            {"inode", to_string(record.inode)},
+            {"size", static_cast<long long>(record.size)},
+            {"mtime", static_cast<long long>(record.mtime)}
+        });
+    }
     ofstream outFile(filePath, ios::trunc);
-    if (outFile.is_open()) {
-        outFile << inodesJson.dump(4);
-        outFile.close();
-    } else {
-        printErrorAndExit("[ERROR] Unable to save inodes to file: " + filePath);
+    if (!outFile.is_open()) {
+        return false;
+    }
+    outFile << inodesJson.dump(4);
+    outFile.close();
+    return static_cast<bool>(outFile);
+}
+
+// Writes lyrics.dat (see lyricsStore.hpp) and points every song with lyrics at its entry.
+// Freshly extracted songs bring their text; a cached song's entry is copied byte for byte out
+// of the previous file, which is read only there (its inode must still match, else the entry
+// is dropped). Written to a temporary file and renamed like the library index.
+bool storeLyricsFile(const string& filePath, vector<SongMetadata>& songMetadata, LyricsStoreStats& stats) {
+    int previous = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    LyricsStoreHeader previousHeader{};
+    if (previous >= 0 && (pread(previous, &previousHeader, sizeof(previousHeader), 0) != static_cast<ssize_t>(sizeof(previousHeader)) ||
+                          memcmp(previousHeader.magic, LYRICS_STORE_MAGIC, sizeof(previousHeader.magic)) != 0)) {
+        close(previous);
+        previous = -1;
+    }
+
+    const string tempPath = filePath + ".tmp";
+    ofstream outFile(tempPath, ios::binary | ios::trunc);
+    if (!outFile.is_open()) {
+        if (previous >= 0) {
+            close(previous);
+        }
+        return false;
+    }
+    LyricsStoreHeader header{};
+    memcpy(header.magic, LYRICS_STORE_MAGIC, sizeof(header.magic));
+    header.version = LYRICS_STORE_VERSION;
+    outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    stats = LyricsStoreStats();
+    string entry;  // inode and text of a copied entry, reused
+    uint64_t offset = sizeof(header);
+    for (SongMetadata& song : songMetadata) {
+        uint64_t inode = strtoull(song.inode.c_str(), nullptr, 10);
+        uint64_t previousOffset = song.lyricsOffset;
+        uint32_t previousLength = song.lyricsLength;
+        song.lyricsOffset = 0;
+        song.lyricsLength = 0;
+        if (!song.lyrics.empty()) {
+            if (song.lyrics.size() > UINT32_MAX) {
+                continue;
+            }
+            outFile.write(reinterpret_cast<const char*>(&inode), sizeof(inode));
+            outFile.write(song.lyrics.data(), song.lyrics.size());
+            song.lyricsLength = static_cast<uint32_t>(song.lyrics.size());
+            stats.written++;
+        } else if (previous >= 0 && previousLength > 0 && previousOffset >= sizeof(LyricsStoreHeader)) {
+            entry.resize(sizeof(inode) + previousLength);
+            uint64_t entryInode;
+            if (pread(previous, &entry[0], entry.size(), static_cast<off_t>(previousOffset)) != static_cast<ssize_t>(entry.size()) ||
+                (memcpy(&entryInode, entry.data(), sizeof(entryInode)), entryInode != inode)) {
+                continue;
+            }
+            outFile.write(entry.data(), entry.size());
+            song.lyricsLength = previousLength;
+            stats.copied++;
+        } else {
+            continue;
+        }
+        song.lyricsOffset = offset;
+        offset += sizeof(inode) + song.lyricsLength;
     }
+    if (previous >= 0) {
+        close(previous);
+    }
+    outFile.close();
+    if (!outFile || rename(tempPath.c_str(), filePath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Rebuilds lyrics.idx from the lyrics.dat storeLyricsFile just wrote, one index track per
+// entry. Entries are tied to the library by inode, so this only runs when the lyrics changed.
+void storeLyricsSearchIndex(const string& filePath, const string& lyricsFilePath, const vector<SongMetadata>& songMetadata) {
+    string lyricsData;
+    ifstream lyricsFile(lyricsFilePath, ios::binary);
+    if (lyricsFile.is_open()) {
+        lyricsData.assign(istreambuf_iterator<char>(lyricsFile), istreambuf_iterator<char>());
+    }
+    vector<string_view> lyrics;
+    vector<uint64_t> inodes;
+    for (const SongMetadata& song : songMetadata) {
+        if (song.lyricsLength == 0 || song.lyricsOffset + sizeof(uint64_t) + song.lyricsLength > lyricsData.size()) {
+            continue;
+        }
+        lyrics.emplace_back(lyricsData.data() + song.lyricsOffset + sizeof(uint64_t), song.lyricsLength);
+        inodes.push_back(strtoull(song.inode.c_str(), nullptr, 10));
+    }
+    // Only lyrics search depends on it: without it the session just reports no lyrics index
+    if (!storeLyricsIndex(filePath, lyrics, inodes)) {
+        std::remove(filePath.c_str());
+    }
+}
+
+// Reads song_names.json back into flat metadata so unchanged files need no re-extraction.
+// Lyrics stay in lyrics.dat, only their entries are carried; caches from before it kept the
+// text inline, that comes back as freshly extracted text.
+vector<SongMetadata> loadCachedSongs(const string& filePath) {
+    vector<SongMetadata> songs;
+    ifstream inFile(filePath);
+    if (!inFile.is_open()) {
+        return songs;
+    }
+    json songsJson = json::parse(inFile, nullptr, false);
+    if (!songsJson.is_object()) {
+        return songs;
+    }
+    for (auto artistIt = songsJson.begin(); artistIt != songsJson.end(); ++artistIt) {
+        for (auto albumIt = artistIt.value().begin(); albumIt != artistIt.value().end(); ++albumIt) {
+            for (const auto& disc : albumIt.value()) {
+                for (const auto& songInfo : disc) {
+                    if (songInfo.empty()) {
+                        continue;
+                    }
+                    songs.push_back({
+                        songInfo.value("filename", ""),
+                        songInfo.value("inode", ""),
+                        artistIt.key(),
+                        albumIt.key(),
+                        songInfo.value("title", ""),
+                        songInfo.value("disc", 1),
+                        songInfo.value("track", 1),
+                        songInfo.value("genre", ""),
+                        songInfo.value("date", ""),
+                        songInfo.value("lyrics", ""),
+                        songInfo.value("duration", DURATION_NOT_CACHED),
+                        songInfo.value("loudness", LOUDNESS_NOT_MEASURED),
+                        songInfo.value("peak", LOUDNESS_NOT_MEASURED),
+                        songInfo.value("lyricsOffset", static_cast<uint64_t>(0)),
+                        songInfo.value("lyricsLength", static_cast<uint32_t>(0))
+                    });
+                }
+            }
+        }
+    }
+    return songs;
+}
+
+unsigned int defaultJobCount() {
+    unsigned int cores = thread::hardware_concurrency();
+    return cores == 0 ? 1 : cores;
+}
+
+// The worker pool of every pass over the files: work(slot) runs for each slot < count on up to
+// --jobs threads (0: one per core), touching only what that slot owns. onDone(slot, done) runs on
+// the calling thread as slots finish, in completion order, so progress and logs need no locking.
+// Once `cancel` is set no further slot is started; false then, as some slots never ran
+bool runOnWorkers(size_t count, unsigned int jobs, const function<void(size_t)>& work, const function<void(size_t, size_t)>& onDone, const atomic<bool>* cancel) {
+    if (count == 0) {
+        return true;
+    }
+    unsigned int workerCount = min<size_t>(jobs == 0 ? defaultJobCount() : jobs, count);
+    ConcurrentQueue<size_t> finished(workerCount * 2);
+    atomic<size_t> nextSlot{0};
+    atomic<unsigned int> running{workerCount};
+    vector<thread> workers;
+    for (unsigned int w = 0; w < workerCount; ++w) {
+        workers.emplace_back([&]() {
+            size_t slot;
+            while (!(cancel && cancel->load()) && (slot = nextSlot.fetch_add(1)) < count) {
+                work(slot);
+                finished.push(slot);
+            }
+            if (running.fetch_sub(1) == 1) {
+                finished.close();  // the last one out: nothing more will arrive
+            }
+        });
+    }
+    size_t done = 0;
+    size_t slot;
+    while (finished.pop(slot)) {
+        onDone(slot, ++done);
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    return done == count;
+}
+
+// "\r[LABEL] Did 3 of 10 things", rewritten in place as a pass advances
+function<void(size_t, size_t)> progressLine(ostream& log, const string& label, size_t total, const string& noun) {
+    return [&log, label, total, noun](size_t, size_t done) {
+        log << "\r" << PINK << label << " " << done << " of " << total << " " << noun << RESET << flush;
+    };
 }
 
 void drawProgressBar(WINDOW* win, int y, int x, float progress) {
@@ -338,48 +667,31 @@ void drawProgressBar(WINDOW* win, int y, int x, float progress) {
     wrefresh(win);
 }
 
-int lmus_cache_main(std::string& songDirectory, const std::string homeDir, const std::string cacheLitemusDirectory, const std::string configLitemusDirectory, const std::string cacheInfoDirectory, const std::string songCacheInfoFile, const std::string artistsFilePath, const std::string songDirPathCache, const std::string debugFile) {
-
-    // DIRECTORY VARIABLES
-    const string cacheDirectory = homeDir + "/.cache/"; 
-    cout << BLUE <<  BOLD << "----------------- LITEMUS -- CACHE -- START ------------------" << RESET << endl;
-    changeDirectory(songDirectory);
-    createDirectory(cacheDirectory);
-    createDirectory(cacheLitemusDirectory);
-    createDirectory(configLitemusDirectory);
-    createDirectory(cacheInfoDirectory);
-
-    vector<string> inodes = getInodes();
-    vector<SongMetadata> songMetadata;
-
-    if (inodes.empty()) {
-        cerr << RED << "No inodes found." << RESET << endl;
-        return 1;
+// Probes records[indices[i]] for every i on the worker pool, showing the cache TUI unless it
+// runs behind a session that owns the terminal. The result is parallel to indices.
+vector<SongMetadata> extractSongs(const vector<FileRecord>& records, const vector<size_t>& indices, const string& songDirectory, unsigned int jobs, const string& debugFile, bool showProgress, const atomic<bool>* cancel) {
+    vector<SongMetadata> extracted;
+    if (indices.empty()) {
+        return extracted;
     }
 
-    // Load previous inodes from song_cache_info_file if it exists
-    vector<string> previousInodes = loadPreviousInodes(songCacheInfoFile);
-    json artistsArray;
-
-    // Compare current inodes with previous inodes
-    if (compareInodeVectors(inodes, previousInodes)) {
-        cout << PINK << BOLD << "[CACHE] No changes in song files. Exiting without caching." << RESET << endl;
-        cout << BLUE << BOLD << "----------------- LITEMUS -- CACHE -- OVER -------------------" << RESET << endl;
-    } else {
-        int cachedSongCount = 0;
-        time_t startTime = time(nullptr); // record the start time
+    int cachedSongCount = 0;
+    time_t startTime = time(nullptr); // record the start time
+    WINDOW* progressWin = nullptr;
+    WINDOW* fileWin = nullptr;
+    if (showProgress) {
         setlocale(LC_ALL, "");
         initscr();
         noecho();
         cbreak();
         curs_set(0);
-        
+
         // Create windows for TUI
         int height = 10;
         int width = 60;
         int start_y = 1;
         int start_x = (COLS - width) / 2;
-        WINDOW* progressWin = newwin(height, width, start_y, start_x);
+        progressWin = newwin(height, width, start_y, start_x);
         box(progressWin, 0, 0);
         mvwprintw(progressWin, 1, 1, "LiteMus Cache Process");
         wrefresh(progressWin);
@@ -388,63 +700,354 @@ int lmus_cache_main(std::string& songDirectory, const std::string homeDir, const
         int fileWinWidth = 100;
         int fileWinStartY = start_y + height + 1;
         int fileWinStartX = start_x - 20;
-        WINDOW* fileWin = newwin(fileWinHeight, fileWinWidth, fileWinStartY, fileWinStartX);
+        fileWin = newwin(fileWinHeight, fileWinWidth, fileWinStartY, fileWinStartX);
         box(fileWin, 0, 0);
         wrefresh(fileWin);
+    }
 
-        for (const std::string& inode : inodes) {
-            string fileName = getFileNameFromInode(inode);
+    ofstream logFile(debugFile, ios::app);
+    if (!logFile.is_open() && showProgress) {
+        cerr << "Unable to open debug log file" << endl;
+    }
+
+    // Workers run the tag extraction into their own slots, this thread alone owns the progress
+    // windows and the debug log. Results arrive in completion order; logs are flushed in scan
+    // order so debug.log comes out the same regardless of --jobs
+    extracted.resize(indices.size());
+    vector<string> pendingLogs(indices.size());
+    vector<bool> arrived(indices.size(), false);
+    size_t nextToFlush = 0;
+
+    runOnWorkers(indices.size(), jobs, [&](size_t slot) {
+        const FileRecord& record = records[indices[slot]];
+        extracted[slot] = storeMetadataJSON(to_string(record.inode), songDirectory, record.path, pendingLogs[slot]);
+    }, [&](size_t slot, size_t done) {
+        if (showProgress) {
+            const string& fileName = extracted[slot].fileName;
             string finalFileName = fileName.length() > 75 ? fileName.substr(0, 75) + "..." : fileName;
             // Clear previous filename and print new filename
             wclear(fileWin);
             box(fileWin, 0, 0);
             mvwprintw(fileWin, 1, 1, "==> %s", finalFileName.c_str());
             wrefresh(fileWin);
+        }
+
+        arrived[slot] = true;
+        while (nextToFlush < indices.size() && arrived[nextToFlush]) {
+            if (logFile.is_open()) {
+                logFile << pendingLogs[nextToFlush];
+            }
+            pendingLogs[nextToFlush].clear();
+            nextToFlush++;
+        }
+
+        cachedSongCount = static_cast<int>(done);
+        if (!showProgress) {
+            return;
+        }
+        time_t currentTime = time(nullptr);
+
+        double elapsedSeconds = difftime(currentTime, startTime);
+        double songsPerSecond = cachedSongCount / elapsedSeconds;
+        double remainingSongs = indices.size() - cachedSongCount;
+        double estimatedTimeRemaining = remainingSongs / songsPerSecond;
+
+        // format the estimated time remaining
+        int minutes = static_cast<int>(estimatedTimeRemaining) % 3600 / 60;
+        int seconds = static_cast<int>(estimatedTimeRemaining) % 60;
+        char timeRemainingStr[32];
+        sprintf(timeRemainingStr, "Time to cook: %02d:%02d", minutes, seconds);
+        mvwprintw(progressWin, 3, 1, timeRemainingStr);
+
+        float progress = static_cast<float>(cachedSongCount) / indices.size();
+        mvwprintw(progressWin, 2, 1, "Progress: %0.2f%%", progress*100);
+        drawProgressBar(progressWin, 5, 1, progress);
+    }, cancel);
+    logFile.close();
+
+    if (showProgress) {
+        delwin(fileWin);
+        delwin(progressWin);
+        endwin();
+    }
+    return extracted;
+}
+
+// Decodes songs[indices[i]] in full for the loudness pass, on the same kind of worker pool as the
+// tag extraction: the pass is bound by decoding, so it scales with --jobs like the probing does
+void measureSongsLoudness(vector<SongMetadata>& songs, const vector<size_t>& indices, const string& songDirectory, unsigned int jobs, ostream& log, const atomic<bool>* cancel) {
+    if (indices.empty()) {
+        return;
+    }
+    runOnWorkers(indices.size(), jobs, [&](size_t slot) {
+        SongMetadata& song = songs[indices[slot]];  // every worker owns distinct songs
+        LoudnessResult result;
+        if (measureLoudness(songDirectory + song.fileName, result)) {
+            song.loudness = result.integratedLufs;
+            song.peak = result.peak;
+        } else {
+            song.peak = 0.f;  // undecodable: looked at, plays without a gain
+        }
+    }, progressLine(log, "[LOUDNESS] Measured", indices.size(), "songs"), cancel);
+    log << endl;
+}
+
+bool wantsSeekIndex(const string& fileName, uint32_t durationMs) {
+    return durationMs != DURATION_NOT_CACHED && durationMs >= SEEK_INDEX_MIN_MS && isMp3Path(fileName);
+}
+
+// Walks the frames of every pending mp3 (header reads only, nothing is decoded) on the same
+// kind of worker pool as the loudness pass
+void buildSeekIndexes(const vector<SeekIndexJob>& pending, const string& seekDirectory, unsigned int jobs, ostream& log, const atomic<bool>* cancel) {
+    if (pending.empty()) {
+        return;
+    }
+    runOnWorkers(pending.size(), jobs, [&](size_t slot) {
+        // A file without a usable table simply seeks the slow way
+        buildSeekIndex(pending[slot].path, seekIndexPath(seekDirectory, pending[slot].inode));
+    }, progressLine(log, "[SEEK] Indexed", pending.size(), "long mp3s"), cancel);
+    log << endl;
+}
 
-            storeMetadataJSON(inode, fileName, artistsArray, songMetadata, debugFile);
-            cachedSongCount++;
-            time_t currentTime = time(nullptr);
+int lmus_cache_main(std::string& songDirectory, const std::string homeDir, const std::string cacheLitemusDirectory, const std::string configLitemusDirectory, const std::string cacheInfoDirectory, const std::string songCacheInfoFile, const std::string artistsFilePath, const std::string songDirPathCache, const std::string debugFile, unsigned int jobs, bool analyzeLoudness, bool quiet, CacheSummary* summary, const atomic<bool>* cancel) {
+    // A quiet run happens behind a session that owns the terminal: nothing may reach it. Its
+    // own reports are discarded here, SFML's (sf::err) go to debug.log where the session sent them
+    static ostream discard(nullptr);
+    ostream& log = quiet ? discard : cout;
+    CacheSummary ignored;
+    CacheSummary& result = summary ? *summary : ignored;
+    // A cache file that cannot be written ends the run: on the console with the message as
+    // always, a quiet run hands it to the session instead of exiting under it
+    auto storeFailed = [&](const string& message) {
+        if (!quiet) {
+            printErrorAndExit("[ERROR] " + message);
+        }
+        result.error = message;
+        return 1;
+    };
+    // Checked between the passes (and by their workers): a cancelled run stops before it
+    // writes anything, the cache it leaves is the previous one
+    auto cancelled = [cancel]() { return cancel && cancel->load(); };
+
+    // DIRECTORY VARIABLES
+    const string cacheDirectory = homeDir + "/.cache/"; 
+    const string songsFilePath = cacheInfoDirectory + "/song_names.json";
+    const string indexFilePath = cacheInfoDirectory + "/library.idx";
+    const string lyricsIndexFilePath = cacheInfoDirectory + "/lyrics.idx";
+    const string lyricsFilePath = cacheInfoDirectory + "/lyrics.dat";
+    const string seekDirectory = cacheInfoDirectory + "/seek/";
+    log << BLUE <<  BOLD << "----------------- LITEMUS -- CACHE -- START ------------------" << RESET << endl;
+    if (quiet) {
+        // Same steps without their console reports (or exit on failure): the session keeps running.
+        // No chdir either, it would move the session's working directory under its other threads;
+        // every path below is built from songDirectory
+        for (const string& directory : {cacheDirectory, cacheLitemusDirectory, configLitemusDirectory, cacheInfoDirectory, seekDirectory}) {
+            mkdir(directory.c_str(), 0755);
+        }
+    } else {
+        changeDirectory(songDirectory);
+        createDirectory(cacheDirectory);
+        createDirectory(cacheLitemusDirectory);
+        createDirectory(configLitemusDirectory);
+        createDirectory(cacheInfoDirectory);
+        createDirectory(seekDirectory);
+    }
 
-            double elapsedSeconds = difftime(currentTime, startTime);
-            double songsPerSecond = cachedSongCount / elapsedSeconds;
-            double remainingSongs = inodes.size() - cachedSongCount;
-            double estimatedTimeRemaining = remainingSongs / songsPerSecond;
+    ScanStats scanStats;
+    vector<FileRecord> records = scanSongDirectory(songDirectory, extensions, scanStats);
+    log << PINK << "[SCAN] " << scanStats.entriesSeen << " entries in " << fixed << setprecision(2) << scanStats.elapsedSeconds * 1000.0
+         << " ms (" << static_cast<long>(scanStats.entriesPerSecond) << " entries/s)" << RESET << endl;
 
-            // format the estimated time remaining
-            int minutes = static_cast<int>(estimatedTimeRemaining) % 3600 / 60;
-            int seconds = static_cast<int>(estimatedTimeRemaining) % 60;
-            char timeRemainingStr[32];
-            sprintf(timeRemainingStr, "Time to cook: %02d:%02d", minutes, seconds);
-            mvwprintw(progressWin, 3, 1, timeRemainingStr);
+    if (records.empty()) {
+        log << RED << "No inodes found." << RESET << endl;
+        return 1;
+    }
+    if (cancelled()) {
+        return 1;
+    }
 
-            float progress = static_cast<float>(cachedSongCount) / inodes.size();
-            mvwprintw(progressWin, 2, 1, "Progress: %0.2f%%", progress*100);
-            drawProgressBar(progressWin, 5, 1, progress);
+    // Load previous inodes from song_cache_info_file if it exists
+    vector<InodeSnapshot> previousInodes = loadPreviousInodes(songCacheInfoFile);
+    CacheDiff diff = diffInodeSnapshots(records, previousInodes);
+    result.added = diff.added.size();
+    result.modified = diff.modified.size();
+    result.removed = diff.removed.size();
+
+    bool durationsMissing = false;
+    bool loudnessMissing = false;
+    if (diff.empty()) {
+        LibraryIndex existingIndex;
+        // lyrics.dat and lyrics.idx are written with library.idx, a cache from before they existed rebuilds all three
+        bool indexMissing = !existingIndex.open(indexFilePath) || access(lyricsIndexFilePath.c_str(), F_OK) != 0 ||
+                            access(lyricsFilePath.c_str(), F_OK) != 0;
+        vector<SongMetadata> cachedSongs;
+        if (indexMissing || analyzeLoudness) {
+            cachedSongs = loadCachedSongs(songsFilePath);
+        }
+        if (analyzeLoudness) {
+            loudnessMissing = any_of(cachedSongs.begin(), cachedSongs.end(), [](const SongMetadata& song) {
+                return std::isnan(song.peak);
+            });
+        }
+        if (indexMissing && !loudnessMissing) {
+            // Cache written before library.idx existed (or by another version), rebuild only the index
+            durationsMissing = any_of(cachedSongs.begin(), cachedSongs.end(), [](const SongMetadata& song) {
+                return song.durationMs == DURATION_NOT_CACHED;
+            });
+            if (!durationsMissing) {
+                sortSongMetadata(cachedSongs);
+                LyricsStoreStats lyricsStats;
+                if (!storeLyricsFile(lyricsFilePath, cachedSongs, lyricsStats)) {
+                    return storeFailed("Unable to save lyrics to file: " + lyricsFilePath);
+                }
+                storeLyricsSearchIndex(lyricsIndexFilePath, lyricsFilePath, cachedSongs);
+                // its lyrics now point into lyrics.dat
+                if (!storeSongsJSON(songsFilePath, cachedSongs, debugFile, log)) {
+                    return storeFailed("Unable to save song names to file: " + songsFilePath);
+                }
+                ifstream artistsFile(artistsFilePath);
+                json artistsArray = json::parse(artistsFile, nullptr, false);
+                if (!storeLibraryIndex(indexFilePath, cachedSongs, artistsArray.is_array() ? artistsArray : json::array())) {
+                    return storeFailed("Unable to save library index to file: " + indexFilePath);
+                }
+                result.changed = true;
+                log << PINK << BOLD << "[CACHE] Rebuilt library index " << indexFilePath << RESET << endl;
+            }
         }
+        if (!durationsMissing && !loudnessMissing) {
+            // Tables of an unchanged library only go missing when info/seek/ was cleared
+            vector<SeekIndexJob> unindexed;
+            if (existingIndex.open(indexFilePath)) {
+                for (uint32_t id = 0; id < existingIndex.trackCount(); ++id) {
+                    const IndexTrack& track = existingIndex.track(id);
+                    string filePath = songDirectory + string(existingIndex.str(track.fileName));
+                    if (wantsSeekIndex(filePath, track.durationMs) && !seekIndexFresh(filePath, seekIndexPath(seekDirectory, track.inode))) {
+                        unindexed.push_back({filePath, track.inode});
+                    }
+                }
+            }
+            buildSeekIndexes(unindexed, seekDirectory, jobs, log, cancel);
+            log << PINK << BOLD << "[CACHE] No changes in song files. Exiting without caching." << RESET << endl;
+            log << BLUE << BOLD << "----------------- LITEMUS -- CACHE -- OVER -------------------" << RESET << endl;
+            return 0;
+        }
+        // song_names.json predates cached durations (or lacks loudness for --loudness): fall through
+        // and fill in only what is missing, once
+    }
 
-        saveArtistsToFile(artistsArray, artistsFilePath);
+    // Unchanged files keep the metadata already in song_names.json
+    unordered_map<string, SongMetadata> cachedByInode;
+    size_t previousLyricsEntries = 0;
+    if (!previousInodes.empty()) {
+        for (SongMetadata& song : loadCachedSongs(songsFilePath)) {
+            previousLyricsEntries += song.lyricsLength > 0 ? 1 : 0;
+            string inode = song.inode;
+            cachedByInode.emplace(move(inode), move(song));
+        }
+    }
 
-        // Sort songMetadata by artist, album, disc, and track
-        sort(songMetadata.begin(), songMetadata.end(), [](const SongMetadata& a, const SongMetadata& b) {
-            if (a.artist != b.artist) return a.artist < b.artist;
-            if (a.album != b.album) return a.album < b.album;
-            if (a.disc != b.disc) return a.disc < b.disc;
-            return a.track < b.track;
-        });
+    vector<bool> needsExtraction(records.size(), false);
+    for (size_t index : diff.added) needsExtraction[index] = true;
+    for (size_t index : diff.modified) needsExtraction[index] = true;
+    vector<size_t> toExtract;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (!needsExtraction[i]) {
+            auto cached = cachedByInode.find(to_string(records[i].inode));
+            // in the snapshot but never made it into song_names.json, or cached before durations were
+            needsExtraction[i] = cached == cachedByInode.end() || cached->second.durationMs == DURATION_NOT_CACHED;
+        }
+        if (needsExtraction[i]) {
+            toExtract.push_back(i);
+        }
+    }
 
-        storeSongsJSON(cacheInfoDirectory + "/song_names.json", songMetadata, debugFile);
+    log << PINK << BOLD << "[CACHE] " << diff.added.size() << " added, " << diff.modified.size() << " modified, "
+         << diff.removed.size() << " removed -> probing " << toExtract.size() << " of " << records.size() << " files" << RESET << endl;
 
-        // Save current inodes for future comparison
-        saveCurrentInodes(inodes, songCacheInfoFile);
-        saveSongDirToFile(songDirPathCache, songDirectory);
+    vector<SongMetadata> extracted = extractSongs(records, toExtract, songDirectory, jobs, debugFile, !quiet, cancel);
+    if (cancelled()) {
+        return 1;
+    }
 
-        endwin();
+    // Merge in scan order so artists.json keeps the order a full rebuild would give
+    vector<SongMetadata> songMetadata;
+    songMetadata.reserve(records.size());
+    json artistsArray = json::array();
+    unordered_set<string> seenArtists;
+    size_t extractedIndex = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (needsExtraction[i]) {
+            songMetadata.push_back(move(extracted[extractedIndex++]));
+        } else {
+            SongMetadata& cached = cachedByInode[to_string(records[i].inode)];
+            cached.fileName = records[i].path; // renames keep the inode
+            songMetadata.push_back(move(cached));
+        }
+        // First time this artist is seen: a set lookup, the array keeps the order
+        if (seenArtists.insert(songMetadata.back().artist).second) {
+            artistsArray.push_back(songMetadata.back().artist);
+        }
+    }
+
+    if (analyzeLoudness) {
+        vector<size_t> unmeasured;
+        for (size_t i = 0; i < songMetadata.size(); ++i) {
+            if (std::isnan(songMetadata[i].peak)) {
+                unmeasured.push_back(i);
+            }
+        }
+        log << PINK << BOLD << "[LOUDNESS] " << unmeasured.size() << " of " << songMetadata.size() << " songs need a loudness pass" << RESET << endl;
+        measureSongsLoudness(songMetadata, unmeasured, songDirectory, jobs, log, cancel);
+    }
+
+    vector<SeekIndexJob> unindexed;
+    for (size_t i = 0; i < songMetadata.size(); ++i) {
+        const SongMetadata& song = songMetadata[i];
+        string filePath = songDirectory + song.fileName;
+        if (wantsSeekIndex(filePath, song.durationMs) && !seekIndexFresh(filePath, seekIndexPath(seekDirectory, records[i].inode))) {
+            unindexed.push_back({filePath, records[i].inode});
+        }
+    }
+    buildSeekIndexes(unindexed, seekDirectory, jobs, log, cancel);
+    if (cancelled()) {
+        return 1;
+    }
+    for (const string& inode : diff.removed) {
+        std::remove(seekIndexPath(seekDirectory, stoull(inode)).c_str());
+    }
 
+    if (!saveArtistsToFile(artistsArray, artistsFilePath)) {
+        return storeFailed("Unable to save artists to file: " + artistsFilePath);
+    }
 
-        cout << endl << GREEN << BOLD << "[SUCCESS] Total of " << cachedSongCount << " songs have been cached!!" << endl;
-        cout << PINK << BOLD << "[CACHE] Songs' cache has been stored in " << cacheInfoDirectory << RESET << endl;
-        cout << BLUE <<  BOLD << "----------------- LITEMUS -- CACHE -- OVER -------------------" << RESET << endl;
+    sortSongMetadata(songMetadata);
+    LyricsStoreStats lyricsStats;
+    if (!storeLyricsFile(lyricsFilePath, songMetadata, lyricsStats)) {
+        return storeFailed("Unable to save lyrics to file: " + lyricsFilePath);
+    }
+    // lyrics.idx goes by inode: unless an entry was added, dropped or re-extracted it still fits
+    if (lyricsStats.written > 0 || lyricsStats.copied != previousLyricsEntries || access(lyricsIndexFilePath.c_str(), F_OK) != 0) {
+        storeLyricsSearchIndex(lyricsIndexFilePath, lyricsFilePath, songMetadata);
     }
+    if (!storeSongsJSON(songsFilePath, songMetadata, debugFile, log)) {
+        return storeFailed("Unable to save song names to file: " + songsFilePath);
+    }
+    if (!storeLibraryIndex(indexFilePath, songMetadata, artistsArray)) {
+        return storeFailed("Unable to save library index to file: " + indexFilePath);
+    }
+    result.changed = true;
+
+    // Save current inodes for future comparison
+    if (!saveCurrentInodes(records, songCacheInfoFile)) {
+        return storeFailed("Unable to save inodes to file: " + songCacheInfoFile);
+    }
+    if (!saveSongDirToFile(songDirPathCache, songDirectory)) {
+        return storeFailed("Unable to save song directory to file: songDirectory.txt");
+    }
+
+    log << endl << GREEN << BOLD << "[SUCCESS] Total of " << songMetadata.size() << " songs have been cached!!" << endl;
+    log << PINK << BOLD << "[CACHE] Songs' cache has been stored in " << cacheInfoDirectory << RESET << endl;
+    log << BLUE <<  BOLD << "----------------- LITEMUS -- CACHE -- OVER -------------------" << RESET << endl;
 
     return 0;
 }
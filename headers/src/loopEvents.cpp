@@ -0,0 +1,109 @@
+#include "../loopEvents.hpp"
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+LoopEvents::~LoopEvents() {
+    if (timerFd >= 0) {
+        close(timerFd);
+    }
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+    if (loadedFd >= 0) {
+        close(loadedFd);
+    }
+    if (libraryFd >= 0) {
+        close(libraryFd);
+    }
+}
+
+bool LoopEvents::open(bool watchInput) {
+    input = watchInput;
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    loadedFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    libraryFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return timerFd >= 0 && wakeFd >= 0 && loadedFd >= 0 && libraryFd >= 0;
+}
+
+void LoopEvents::setTickInterval(unsigned int milliseconds) {
+    if (milliseconds == tickInterval) {
+        return;
+    }
+    tickInterval = milliseconds;
+    struct itimerspec spec = {};
+    spec.it_interval.tv_sec = milliseconds / 1000;
+    spec.it_interval.tv_nsec = static_cast<long>(milliseconds % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;  // all zero disarms
+    timerfd_settime(timerFd, 0, &spec, nullptr);
+}
+
+void LoopEvents::watchControl(const std::vector<int>& fds) {
+    controlFds = fds;
+}
+
+void LoopEvents::notifyTrackEnd() {
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written; // a full counter still wakes the loop
+}
+
+void LoopEvents::notifyLoaded() {
+    uint64_t one = 1;
+    ssize_t written = write(loadedFd, &one, sizeof(one));
+    (void)written;
+}
+
+void LoopEvents::notifyLibrary() {
+    uint64_t one = 1;
+    ssize_t written = write(libraryFd, &one, sizeof(one));
+    (void)written;
+}
+
+unsigned int LoopEvents::wait() {
+    // A negative descriptor is skipped by poll(): no stdin for a headless loop
+    std::vector<struct pollfd> fds = {
+        {input ? STDIN_FILENO : -1, POLLIN, 0},
+        {timerFd, POLLIN, 0},
+        {wakeFd, POLLIN, 0},
+        {loadedFd, POLLIN, 0},
+        {libraryFd, POLLIN, 0},
+    };
+    for (int fd : controlFds) {
+        fds.push_back({fd, POLLIN, 0});
+    }
+    int ready = poll(fds.data(), fds.size(), -1);
+    if (ready < 0) {
+        // EINTR: ncurses' SIGWINCH handler ran, KEY_RESIZE is waiting in getch()
+        return errno == EINTR ? LOOP_EVENT_INPUT : 0;
+    }
+
+    unsigned int events = 0;
+    uint64_t count;
+    if (fds[0].revents & POLLIN) {
+        events |= LOOP_EVENT_INPUT;
+    } else if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) {
+        events |= LOOP_EVENT_HANGUP;
+    }
+    if ((fds[1].revents & POLLIN) && read(timerFd, &count, sizeof(count)) == sizeof(count)) {
+        events |= LOOP_EVENT_TICK;
+    }
+    if ((fds[2].revents & POLLIN) && read(wakeFd, &count, sizeof(count)) == sizeof(count)) {
+        events |= LOOP_EVENT_TRACK_END;
+    }
+    if ((fds[3].revents & POLLIN) && read(loadedFd, &count, sizeof(count)) == sizeof(count)) {
+        events |= LOOP_EVENT_LOADED;
+    }
+    if ((fds[4].revents & POLLIN) && read(libraryFd, &count, sizeof(count)) == sizeof(count)) {
+        events |= LOOP_EVENT_LIBRARY;
+    }
+    for (size_t i = 5; i < fds.size(); ++i) {
+        if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+            events |= LOOP_EVENT_CONTROL;  // a hung up client is read (EOF) and dropped by its owner
+        }
+    }
+    return events;
+}
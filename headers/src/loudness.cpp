@@ -0,0 +1,241 @@
+#include "../loudness.hpp"
+#include <algorithm>
+#include <cstdlib>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// BS.1770 constants: -0.691 dB offset, gates at -70 LUFS absolute and -10 LU relative
+static const double LUFS_OFFSET = -0.691;
+static const double ABSOLUTE_GATE_LUFS = -70.0;
+static const double RELATIVE_GATE_LU = -10.0;
+static const size_t SUB_BLOCKS_PER_BLOCK = 4;  // 400 ms blocks, 100 ms hop
+
+static double energyToLufs(double meanSquare) {
+    return LUFS_OFFSET + 10.0 * std::log10(meanSquare);
+}
+
+static double lufsToEnergy(double lufs) {
+    return std::pow(10.0, (lufs - LUFS_OFFSET) / 10.0);
+}
+
+// Biquad coefficients of the K-weighting pre-filter (high shelf, then high pass) for any sample
+// rate, derived from the analog prototypes the way libebur128 does it
+LoudnessMeter::LoudnessMeter(unsigned int channelCount, unsigned int sampleRate)
+    : channels(channelCount), subBlockFrames(std::max(1u, sampleRate / 10)) {
+    double f0 = 1681.974450955533;
+    double gainDb = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = std::tan(M_PI * f0 / sampleRate);
+    double vh = std::pow(10.0, gainDb / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    shelf[0] = (vh + vb * k / q + k * k) / a0;
+    shelf[1] = 2.0 * (k * k - vh) / a0;
+    shelf[2] = (vh - vb * k / q + k * k) / a0;
+    shelf[3] = 2.0 * (k * k - 1.0) / a0;
+    shelf[4] = (1.0 - k / q + k * k) / a0;
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = std::tan(M_PI * f0 / sampleRate);
+    a0 = 1.0 + k / q + k * k;
+    highPass[0] = 1.0;
+    highPass[1] = -2.0;
+    highPass[2] = 1.0;
+    highPass[3] = 2.0 * (k * k - 1.0) / a0;
+    highPass[4] = (1.0 - k / q + k * k) / a0;
+
+    // Channels are filtered in pairs, an odd last channel gets a silent partner
+    size_t padded = (channels + 1) & ~1u;
+    state.assign(padded * 4, 0.0);
+    squares.assign(padded, 0.0);
+    weights.assign(padded, 1.0);
+    if (channels == 5 || channels == 6) {
+        // L R C (LFE) Ls Rs: the surrounds weigh +1.5 dB, the LFE not at all
+        weights[channels - 2] = 1.41;
+        weights[channels - 1] = 1.41;
+        if (channels == 6) {
+            weights[3] = 0.0;
+        }
+    }
+}
+
+void LoudnessMeter::addFrames(const sf::Int16* samples, size_t frameCount) {
+    size_t padded = squares.size();
+    const double scale = 1.0 / 32768.0;
+    while (frameCount > 0) {
+        size_t run = std::min(frameCount, subBlockFrames - framesInSubBlock);
+        for (size_t i = 0; i < run * channels; ++i) {
+            peak = std::max(peak, std::abs(static_cast<int>(samples[i])));
+        }
+
+#if defined(__SSE2__)
+        // Filter state stays in registers for the whole run; denormals from decaying silence
+        // would otherwise cost more than the filtering itself
+        unsigned int csr = _mm_getcsr();
+        _mm_setcsr(csr | 0x8040);  // flush-to-zero | denormals-are-zero
+        const __m128d vscale = _mm_set1_pd(scale);
+        const __m128d sb0 = _mm_set1_pd(shelf[0]), sb1 = _mm_set1_pd(shelf[1]), sb2 = _mm_set1_pd(shelf[2]);
+        const __m128d sa1 = _mm_set1_pd(shelf[3]), sa2 = _mm_set1_pd(shelf[4]);
+        const __m128d hb0 = _mm_set1_pd(highPass[0]), hb1 = _mm_set1_pd(highPass[1]), hb2 = _mm_set1_pd(highPass[2]);
+        const __m128d ha1 = _mm_set1_pd(highPass[3]), ha2 = _mm_set1_pd(highPass[4]);
+        for (size_t pair = 0; pair < channels; pair += 2) {
+            __m128d s1 = _mm_loadu_pd(&state[pair]);
+            __m128d s2 = _mm_loadu_pd(&state[padded + pair]);
+            __m128d h1 = _mm_loadu_pd(&state[padded * 2 + pair]);
+            __m128d h2 = _mm_loadu_pd(&state[padded * 3 + pair]);
+            __m128d acc = _mm_loadu_pd(&squares[pair]);
+            bool full = pair + 1 < channels;
+            const sf::Int16* in = samples + pair;
+            for (size_t f = 0; f < run; ++f, in += channels) {
+                __m128d x = _mm_mul_pd(_mm_set_pd(full ? in[1] : 0.0, in[0]), vscale);
+                __m128d y = _mm_add_pd(_mm_mul_pd(sb0, x), s1);
+                s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(sb1, x), _mm_mul_pd(sa1, y)), s2);
+                s2 = _mm_sub_pd(_mm_mul_pd(sb2, x), _mm_mul_pd(sa2, y));
+                __m128d z = _mm_add_pd(_mm_mul_pd(hb0, y), h1);
+                h1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(hb1, y), _mm_mul_pd(ha1, z)), h2);
+                h2 = _mm_sub_pd(_mm_mul_pd(hb2, y), _mm_mul_pd(ha2, z));
+                acc = _mm_add_pd(acc, _mm_mul_pd(z, z));
+            }
+            _mm_storeu_pd(&state[pair], s1);
+            _mm_storeu_pd(&state[padded + pair], s2);
+            _mm_storeu_pd(&state[padded * 2 + pair], h1);
+            _mm_storeu_pd(&state[padded * 3 + pair], h2);
+            _mm_storeu_pd(&squares[pair], acc);
+        }
+        _mm_setcsr(csr);
+#else
+        for (size_t c = 0; c < channels; ++c) {
+            double s1 = state[c], s2 = state[padded + c], h1 = state[padded * 2 + c], h2 = state[padded * 3 + c];
+            double acc = squares[c];
+            const sf::Int16* in = samples + c;
+            for (size_t f = 0; f < run; ++f, in += channels) {
+                double x = *in * scale;
+                double y = shelf[0] * x + s1;
+                s1 = shelf[1] * x - shelf[3] * y + s2;
+                s2 = shelf[2] * x - shelf[4] * y;
+                double z = highPass[0] * y + h1;
+                h1 = highPass[1] * y - highPass[3] * z + h2;
+                h2 = highPass[2] * y - highPass[4] * z;
+                acc += z * z;
+            }
+            state[c] = s1;
+            state[padded + c] = s2;
+            state[padded * 2 + c] = h1;
+            state[padded * 3 + c] = h2;
+            squares[c] = acc;
+        }
+#endif
+
+        samples += run * channels;
+        frameCount -= run;
+        framesInSubBlock += run;
+        if (framesInSubBlock == subBlockFrames) {
+            closeSubBlock();
+        }
+    }
+}
+
+void LoudnessMeter::closeSubBlock() {
+    double energy = 0.0;
+    for (size_t c = 0; c < channels; ++c) {
+        energy += weights[c] * squares[c];
+        squares[c] = 0.0;
+    }
+    subBlockEnergy.push_back(energy);
+    framesInSubBlock = 0;
+}
+
+// A trailing partial sub-block is left out, like any block shorter than 400 ms
+LoudnessResult LoudnessMeter::finish() const {
+    LoudnessResult result;
+    result.peak = peak / 32768.f;
+    if (subBlockEnergy.size() < SUB_BLOCKS_PER_BLOCK) {
+        return result;
+    }
+
+    std::vector<double> blocks;
+    blocks.reserve(subBlockEnergy.size());
+    double absoluteGate = lufsToEnergy(ABSOLUTE_GATE_LUFS);
+    double window = 0.0;
+    for (size_t i = 0; i < subBlockEnergy.size(); ++i) {
+        window += subBlockEnergy[i];
+        if (i >= SUB_BLOCKS_PER_BLOCK) {
+            window -= subBlockEnergy[i - SUB_BLOCKS_PER_BLOCK];
+        }
+        if (i + 1 >= SUB_BLOCKS_PER_BLOCK) {
+            double meanSquare = std::max(0.0, window) / (SUB_BLOCKS_PER_BLOCK * subBlockFrames);
+            if (meanSquare > absoluteGate) {
+                blocks.push_back(meanSquare);
+            }
+        }
+    }
+    if (blocks.empty()) {
+        return result;  // silence: nothing to normalise
+    }
+
+    double sum = 0.0;
+    for (double block : blocks) {
+        sum += block;
+    }
+    double relativeGate = lufsToEnergy(energyToLufs(sum / blocks.size()) + RELATIVE_GATE_LU);
+    double gatedSum = 0.0;
+    size_t gatedCount = 0;
+    for (double block : blocks) {
+        if (block > relativeGate) {
+            gatedSum += block;
+            ++gatedCount;
+        }
+    }
+    result.integratedLufs = static_cast<float>(energyToLufs(gatedSum / gatedCount));
+    return result;
+}
+
+bool measureLoudness(const std::string& filePath, LoudnessResult& result) {
+    sf::InputSoundFile file;
+    if (!file.openFromFile(filePath) || file.getChannelCount() == 0 || file.getSampleRate() == 0) {
+        return false;
+    }
+    unsigned int channels = file.getChannelCount();
+    LoudnessMeter meter(channels, file.getSampleRate());
+    std::vector<sf::Int16> buffer(static_cast<size_t>(file.getSampleRate()) * channels);  // one second
+    uint64_t total = 0;
+    sf::Uint64 read;
+    while ((read = file.read(buffer.data(), buffer.size())) > 0) {
+        meter.addFrames(buffer.data(), static_cast<size_t>(read / channels));
+        total += read;
+    }
+    if (total == 0) {
+        return false;
+    }
+    result = meter.finish();
+    return true;
+}
+
+// The album's blocks are not kept around, so its loudness is the power mean of its tracks
+// weighted by their length, which matches gating the whole album closely for consistent masters
+float combineLoudness(const std::vector<float>& lufs, const std::vector<uint32_t>& durationsMs) {
+    double energy = 0.0;
+    double weight = 0.0;
+    for (size_t i = 0; i < lufs.size(); ++i) {
+        if (std::isnan(lufs[i])) {
+            continue;
+        }
+        double duration = std::max<uint32_t>(durationsMs[i], 1);
+        energy += duration * lufsToEnergy(lufs[i]);
+        weight += duration;
+    }
+    return weight > 0.0 ? static_cast<float>(energyToLufs(energy / weight)) : LOUDNESS_NOT_MEASURED;
+}
+
+float normalizationGain(float lufs, float peak) {
+    if (std::isnan(lufs)) {
+        return 1.f;
+    }
+    float gain = std::pow(10.f, (LOUDNESS_TARGET_LUFS - lufs) / 20.f);
+    if (!std::isnan(peak) && peak > 0.f) {
+        gain = std::min(gain, 1.f / peak);
+    }
+    return gain;
+}
@@ -0,0 +1,363 @@
+#include "../lyricsIndex.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+#include "../searchIndex.hpp"
+
+static const size_t MAX_PREFIX_TERMS = 64;  // words an unfinished last word may stand for
+static const size_t MIN_PREFIX_LENGTH = 3;  // shorter last words only match themselves
+
+std::vector<std::string> lyricsTerms(const std::string& text) {
+    std::vector<std::string> words;
+    std::string folded = foldSearchText(text);
+    size_t start = 0;
+    for (size_t i = 0; i <= folded.size(); ++i) {
+        if (i == folded.size() || folded[i] == ' ') {
+            if (i > start) {
+                words.push_back(folded.substr(start, i - start));
+            }
+            start = i + 1;
+        }
+    }
+    return words;
+}
+
+static void putVarint(std::string& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// false on a truncated or overlong value: the mapping is never read past `end`
+static bool getVarint(const uint8_t*& at, const uint8_t* end, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (at == end) {
+            return false;
+        }
+        uint8_t byte = *at++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool storeLyricsIndex(const std::string& path, const std::vector<std::string_view>& lyrics, const std::vector<uint64_t>& inodes) {
+    struct TermPostings {
+        std::string bytes;
+        uint32_t lastTrack = 0;
+        uint32_t trackCount = 0;
+    };
+    std::unordered_map<std::string, TermPostings> postingsByTerm;
+    std::unordered_map<std::string, std::vector<uint32_t>> positions;  // of the track being added
+    std::string block;
+    for (uint32_t track = 0; track < lyrics.size(); ++track) {
+        if (lyrics[track].empty()) {
+            continue;
+        }
+        positions.clear();
+        std::vector<std::string> words = lyricsTerms(std::string(lyrics[track]));
+        for (uint32_t position = 0; position < words.size(); ++position) {
+            positions[words[position]].push_back(position);
+        }
+        // Tracks are added in id order, so every term's postings stay sorted by track
+        for (const auto& entry : positions) {
+            TermPostings& term = postingsByTerm[entry.first];
+            block.clear();
+            uint32_t previous = 0;
+            for (uint32_t position : entry.second) {
+                putVarint(block, position - previous);
+                previous = position;
+            }
+            putVarint(term.bytes, track - term.lastTrack);
+            putVarint(term.bytes, static_cast<uint32_t>(block.size()));
+            term.bytes += block;
+            term.lastTrack = track;
+            term.trackCount++;
+        }
+    }
+
+    std::vector<const std::string*> termNames;
+    termNames.reserve(postingsByTerm.size());
+    for (const auto& entry : postingsByTerm) {
+        termNames.push_back(&entry.first);
+    }
+    std::sort(termNames.begin(), termNames.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+
+    std::vector<LyricsTerm> terms;
+    terms.reserve(termNames.size());
+    std::string heap;
+    std::string postingsBlock;
+    for (const std::string* name : termNames) {
+        const TermPostings& postings = postingsByTerm[*name];
+        terms.push_back({static_cast<uint32_t>(heap.size()), static_cast<uint32_t>(name->size()), postings.trackCount,
+                         static_cast<uint32_t>(postings.bytes.size()), static_cast<uint64_t>(postingsBlock.size())});
+        heap += *name;
+        postingsBlock += postings.bytes;
+    }
+
+    LyricsIndexHeader header{};
+    memcpy(header.magic, LYRICS_INDEX_MAGIC, sizeof(header.magic));
+    header.version = LYRICS_INDEX_VERSION;
+    header.trackCount = static_cast<uint32_t>(inodes.size());
+    header.termCount = static_cast<uint32_t>(terms.size());
+    auto align8 = [](uint64_t offset) { return (offset + 7) & ~static_cast<uint64_t>(7); };
+    uint64_t offset = align8(sizeof(LyricsIndexHeader));
+    header.inodesOffset = offset;
+    offset = align8(offset + inodes.size() * sizeof(uint64_t));
+    header.termsOffset = offset;
+    offset = align8(offset + terms.size() * sizeof(LyricsTerm));
+    header.postingsOffset = offset;
+    header.postingsSize = postingsBlock.size();
+    offset = align8(offset + postingsBlock.size());
+    header.heapOffset = offset;
+    header.heapSize = heap.size();
+
+    const std::string tempPath = path + ".tmp";
+    std::ofstream outFile(tempPath, std::ios::binary | std::ios::trunc);
+    if (!outFile.is_open()) {
+        return false;
+    }
+    auto writeAt = [&](uint64_t position, const void* data, size_t size) {
+        static const char zeros[8] = {};
+        while (static_cast<uint64_t>(outFile.tellp()) < position) {
+            outFile.write(zeros, std::min<uint64_t>(8, position - outFile.tellp()));
+        }
+        outFile.write(static_cast<const char*>(data), size);
+    };
+    writeAt(0, &header, sizeof(header));
+    writeAt(header.inodesOffset, inodes.data(), inodes.size() * sizeof(uint64_t));
+    writeAt(header.termsOffset, terms.data(), terms.size() * sizeof(LyricsTerm));
+    writeAt(header.postingsOffset, postingsBlock.data(), postingsBlock.size());
+    writeAt(header.heapOffset, heap.data(), heap.size());
+    outFile.close();
+    if (!outFile || rename(tempPath.c_str(), path.c_str()) != 0) {
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+LyricsIndex::~LyricsIndex() {
+    close();
+}
+
+void LyricsIndex::close() {
+    if (base) {
+        munmap(base, mappedSize);
+    }
+    base = nullptr;
+    mappedSize = 0;
+    header = nullptr;
+}
+
+// true when count elements of elemSize starting at offset fit inside size
+static bool tableFits(uint64_t offset, uint64_t count, uint64_t elemSize, uint64_t size) {
+    return offset <= size && count <= (size - offset) / elemSize;
+}
+
+bool LyricsIndex::open(const std::string& path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(LyricsIndexHeader)) {
+        ::close(fd);
+        return false;
+    }
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // the mapping keeps the file alive
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    base = mapped;
+    mappedSize = st.st_size;
+
+    const char* bytes = static_cast<const char*>(base);
+    header = reinterpret_cast<const LyricsIndexHeader*>(bytes);
+    uint64_t size = mappedSize;
+    if (memcmp(header->magic, LYRICS_INDEX_MAGIC, sizeof(LYRICS_INDEX_MAGIC)) != 0 || header->version != LYRICS_INDEX_VERSION ||
+        !tableFits(header->inodesOffset, header->trackCount, sizeof(uint64_t), size) ||
+        !tableFits(header->termsOffset, header->termCount, sizeof(LyricsTerm), size) ||
+        !tableFits(header->postingsOffset, header->postingsSize, 1, size) ||
+        !tableFits(header->heapOffset, header->heapSize, 1, size)) {
+        close();
+        return false;
+    }
+    inodes = reinterpret_cast<const uint64_t*>(bytes + header->inodesOffset);
+    terms = reinterpret_cast<const LyricsTerm*>(bytes + header->termsOffset);
+    postings = reinterpret_cast<const uint8_t*>(bytes + header->postingsOffset);
+    heap = bytes + header->heapOffset;
+    return true;
+}
+
+bool LyricsIndex::termValid(const LyricsTerm& term) const {
+    return static_cast<uint64_t>(term.textOffset) + term.textLength <= header->heapSize &&
+           term.postingsOffset <= header->postingsSize && term.postingsLength <= header->postingsSize - term.postingsOffset;
+}
+
+std::vector<LyricsMatch> LyricsIndex::findPhrase(const std::string& phrase, size_t limit) const {
+    std::vector<LyricsMatch> matches;
+    std::vector<std::string> words = lyricsTerms(phrase);
+    if (!isOpen() || words.empty() || limit == 0) {
+        return matches;
+    }
+    const LyricsTerm* termsEnd = terms + header->termCount;
+    auto termBefore = [this](const LyricsTerm& term, const std::string& word) {
+        return termValid(term) && termText(term) < word;
+    };
+
+    // One slot per query word: its term, or the terms an unfinished last word may be
+    struct Slot {
+        std::vector<const LyricsTerm*> terms;
+        uint64_t tracks = 0;
+    };
+    std::vector<Slot> slots(words.size());
+    for (size_t i = 0; i < words.size(); ++i) {
+        const std::string& word = words[i];
+        bool prefix = i + 1 == words.size() && word.size() >= MIN_PREFIX_LENGTH;
+        for (const LyricsTerm* term = std::lower_bound(terms, termsEnd, word, termBefore);
+             term != termsEnd && slots[i].terms.size() < MAX_PREFIX_TERMS && termValid(*term); ++term) {
+            std::string_view text = termText(*term);
+            if (prefix ? text.compare(0, word.size(), word) != 0 : text != word) {
+                break;
+            }
+            slots[i].terms.push_back(term);
+            slots[i].tracks += term->trackCount;
+        }
+        if (slots[i].terms.empty()) {
+            return matches;  // a word no lyric has
+        }
+    }
+
+    // Tracks holding every word come first, from the position blocks alone: the rarest slot
+    // names the candidates and each other slot keeps those it also holds. Positions are only
+    // decoded for the tracks left, into buffers reused from track to track
+    struct Block {
+        uint32_t track;
+        const uint8_t* begin;
+        const uint8_t* end;
+    };
+    auto byTrack = [](const Block& a, const Block& b) { return a.track < b.track; };
+    // Calls visit(track, block, blockEnd) for each track of the term, in track order
+    auto walkPostings = [this](const LyricsTerm& term, auto visit) {
+        const uint8_t* at = postings + term.postingsOffset;
+        const uint8_t* end = at + term.postingsLength;
+        uint32_t track = 0;
+        uint32_t delta;
+        uint32_t length;
+        while (at < end && getVarint(at, end, delta) && getVarint(at, end, length) && length <= static_cast<uint64_t>(end - at)) {
+            track += delta;
+            visit(track, at, at + length);
+            at += length;
+        }
+    };
+
+    std::vector<size_t> order(slots.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&slots](size_t a, size_t b) { return slots[a].tracks < slots[b].tracks; });
+
+    std::vector<std::vector<Block>> blocks(slots.size());  // per slot, by track
+    std::vector<uint32_t> candidates;
+    std::vector<char> held;
+    for (size_t k = 0; k < order.size(); ++k) {
+        size_t slot = order[k];
+        held.assign(candidates.size(), 0);
+        for (const LyricsTerm* term : slots[slot].terms) {
+            size_t next = 0;
+            walkPostings(*term, [&](uint32_t track, const uint8_t* block, const uint8_t* blockEnd) {
+                if (k == 0) {
+                    if (track < header->trackCount) {
+                        blocks[slot].push_back({track, block, blockEnd});
+                    }
+                    return;
+                }
+                while (next < candidates.size() && candidates[next] < track) {
+                    ++next;
+                }
+                if (next < candidates.size() && candidates[next] == track) {
+                    blocks[slot].push_back({track, block, blockEnd});
+                    held[next] = 1;
+                }
+            });
+        }
+        if (slots[slot].terms.size() > 1) {
+            std::stable_sort(blocks[slot].begin(), blocks[slot].end(), byTrack);
+        }
+        if (k == 0) {
+            for (const Block& block : blocks[slot]) {
+                if (candidates.empty() || candidates.back() != block.track) {
+                    candidates.push_back(block.track);
+                }
+            }
+        } else {
+            size_t kept = 0;
+            for (size_t i = 0; i < candidates.size(); ++i) {
+                if (held[i]) {
+                    candidates[kept++] = candidates[i];
+                }
+            }
+            candidates.resize(kept);
+        }
+        if (candidates.empty()) {
+            return matches;
+        }
+    }
+
+    std::vector<size_t> cursors(slots.size(), 0);
+    std::vector<std::vector<uint32_t>> positions(slots.size());  // of the current track, per slot
+    for (uint32_t track : candidates) {
+        for (size_t slot = 0; slot < slots.size(); ++slot) {
+            const std::vector<Block>& slotBlocks = blocks[slot];
+            size_t& cursor = cursors[slot];
+            cursor = std::lower_bound(slotBlocks.begin() + cursor, slotBlocks.end(), Block{track, nullptr, nullptr}, byTrack) - slotBlocks.begin();
+            positions[slot].clear();
+            size_t decoded = 0;
+            for (; cursor < slotBlocks.size() && slotBlocks[cursor].track == track; ++cursor, ++decoded) {
+                const uint8_t* at = slotBlocks[cursor].begin;
+                uint32_t position = 0;
+                uint32_t delta;
+                while (at < slotBlocks[cursor].end && getVarint(at, slotBlocks[cursor].end, delta)) {
+                    position += delta;
+                    positions[slot].push_back(position);
+                }
+            }
+            if (decoded > 1) {
+                std::sort(positions[slot].begin(), positions[slot].end());
+            }
+        }
+
+        // Word i of the phrase has to sit at position p + i
+        uint32_t occurrences = 0;
+        for (uint32_t start : positions[0]) {
+            bool whole = true;
+            for (size_t i = 1; i < slots.size() && whole; ++i) {
+                whole = std::binary_search(positions[i].begin(), positions[i].end(), start + static_cast<uint32_t>(i));
+            }
+            occurrences += whole ? 1 : 0;
+        }
+        if (occurrences > 0) {
+            matches.push_back({track, occurrences});
+        }
+    }
+    size_t count = std::min(limit, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + count, matches.end(), [](const LyricsMatch& a, const LyricsMatch& b) {
+        return a.occurrences != b.occurrences ? a.occurrences > b.occurrences : a.track < b.track;
+    });
+    matches.resize(count);
+    return matches;
+}
@@ -0,0 +1,88 @@
+#include "../lyricsPane.hpp"
+#include "../compositor.hpp"
+#include "../ncurses_helpers.hpp"
+#include "../parsers.hpp"
+
+void LyricsPane::open(WINDOW* parentWin, const std::string& lyrics, const std::string& songName, const std::string& artistName) {
+    if (win && parentWin != parent) {
+        close();
+    }
+    parent = parentWin;
+    lines = splitStringByNewlines(lyrics);
+    song = songName;
+    artist = artistName;
+    startLine = 0;
+    if (!win) {
+        place();
+    }
+}
+
+void LyricsPane::close() {
+    if (!win) {
+        return;
+    }
+    compositorForget(win);
+    compositorForget(warningWin);
+    delwin(win);
+    delwin(warningWin);
+    win = nullptr;
+    warningWin = nullptr;
+    markAllDirty();
+}
+
+// Lyrics fill the parent inside its border, the warning box sits in the middle of the screen
+void LyricsPane::place() {
+    int height, width;
+    getmaxyx(parent, height, width);
+    win = derwin(parent, height - 2, width - 2, 1, 1);
+
+    int warningWidth = COLS * 0.34;
+    int warningHeight = LINES * 0.38;
+    warningWin = newwin(warningHeight, warningWidth, (LINES - warningHeight) / 2, (COLS - warningWidth) / 2 + 10);
+}
+
+void LyricsPane::resize() {
+    if (!win) {
+        return;
+    }
+    compositorForget(win);
+    compositorForget(warningWin);
+    delwin(win);
+    delwin(warningWin);
+    place();
+}
+
+bool LyricsPane::handleKey(int ch) {
+    switch (ch) {
+        case KEY_UP:
+        case 'j':
+            if (startLine > 0) {
+                startLine--;
+            }
+            return true;
+        case KEY_DOWN:
+        case 'k':
+            if (startLine + getmaxy(parent) - 2 < static_cast<int>(lines.size())) {
+                startLine++;
+            }
+            return true;
+        case '1':
+            close();
+            return true;
+        default:
+            return false;
+    }
+}
+
+void LyricsPane::draw(const std::unordered_map<std::string, int>& keybinds) {
+    if (!win) {
+        return;
+    }
+    werase(parent);
+    box(parent, 0, 0);
+    mvwprintw(parent, 0, 2, " Lyrics: ");
+    printMultiLine(win, lines, startLine, song, artist);
+    markDirty(parent);
+    markDirty(win);
+    displayWindow(warningWin, "warning", keybinds);
+}
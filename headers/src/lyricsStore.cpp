@@ -0,0 +1,34 @@
+#include "../lyricsStore.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool readLyrics(const std::string& path, uint64_t offset, uint32_t length, uint64_t inode, std::string& lyrics) {
+    lyrics.clear();
+    if (length == 0 || offset < sizeof(LyricsStoreHeader)) {
+        return false;
+    }
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    // The inode and the text in one read
+    std::string entry(sizeof(uint64_t) + length, '\0');
+    size_t done = 0;
+    while (done < entry.size()) {
+        ssize_t got = pread(fd, &entry[done], entry.size() - done, static_cast<off_t>(offset + done));
+        if (got <= 0) {
+            break;
+        }
+        done += static_cast<size_t>(got);
+    }
+    close(fd);
+    uint64_t entryInode;
+    memcpy(&entryInode, entry.data(), sizeof(entryInode));
+    if (done != entry.size() || entryInode != inode) {
+        return false;
+    }
+    entry.erase(0, sizeof(uint64_t));
+    lyrics = std::move(entry);
+    return true;
+}
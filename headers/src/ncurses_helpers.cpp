@@ -1,5 +1,6 @@
 #include "../ncurses_helpers.hpp"
 #include "../parsers.hpp"
+#include "../compositor.hpp"
 
 #define GREY_BACKGROUND_COLOR 7
 #define LIGHT_GREEN_COLOR 8
@@ -38,12 +39,12 @@ void updateWindowDimensions(int& menu_height, int& menu_width, int& title_height
 }
 
 void ncursesWinControl(WINDOW* artist_menu_win, WINDOW* song_menu_win, WINDOW* status_win, WINDOW* title_win, const std::string& choice) {
-  // Refresh all windows
+  // Queue all windows for the next frame
   if (choice == "refresh") {
-    wrefresh(artist_menu_win);
-    wrefresh(song_menu_win);
-    wrefresh(status_win);
-    wrefresh(title_win);
+    markDirty(artist_menu_win);
+    markDirty(song_menu_win);
+    markDirty(status_win);
+    markDirty(title_win);
   }
   else if (choice == "box") {
     box(artist_menu_win, 0, 0);
@@ -107,10 +108,15 @@ void displayWindow(WINDOW* menu_win, const std::string window, const std::unorde
         ss << "    Force Quit          -- (" << asciiToChar(keybinds, "force_quit") << ")" << std::endl;
         ss << "    Next Song           -- (" << asciiToChar(keybinds, "play_next_song") << ")" << std::endl;
         ss << "    Previous Song       -- (" << asciiToChar(keybinds, "play_prev_song") << ")" << std::endl;
+        ss << "    Add to queue        -- (" << asciiToChar(keybinds, "append_to_queue") << ")" << std::endl;
+        ss << "    Play next in queue  -- (" << asciiToChar(keybinds, "play_song_next") << ")" << std::endl;
+        ss << "    Remove from queue   -- (" << asciiToChar(keybinds, "remove_from_queue") << ")" << std::endl;
+        ss << "    Toggle shuffle      -- (" << asciiToChar(keybinds, "toggle_shuffle") << ")" << std::endl;
         ss << "    Increase Volume     -- (" << asciiToChar(keybinds, "increase_volume") << ")" << std::endl;
         ss << "    Decrease Volume     -- (" << asciiToChar(keybinds, "decrease_volume") << ")" << std::endl;
         ss << "    Toggle mute         -- (" << asciiToChar(keybinds, "toggle_mute") << ")" << std::endl;
-        ss << "    String search       -- (" << asciiToChar(keybinds, "string_search") << ")" << std::endl;
+        ss << "    Search library      -- (" << asciiToChar(keybinds, "string_search") << ")" << std::endl;
+        ss << "    Browse by (cycle)   -- (" << asciiToChar(keybinds, "cycle_browse_mode") << ")" << std::endl;
         ss << "    Toggle Window       -- (" << asciiToChar(keybinds, "toggle_window_focus") << ")" << std::endl;
         ss << "    To show help menu   -- (" << asciiToChar(keybinds, "display_help_controls") << ")" << std::endl;
         ss << "    Lyrics View         -- (" << asciiToChar(keybinds, "display_lyrics_view") << ")" << std::endl;
@@ -119,9 +125,9 @@ void displayWindow(WINDOW* menu_win, const std::string window, const std::unorde
     mvwprintw(menu_win, 2, 4, ss.str().c_str());
     wattroff(menu_win, COLOR_PAIR(3));
     wattron(menu_win, COLOR_PAIR(4) | A_BOLD);
-    mvwprintw(menu_win, 26, 2, "To modify keybinds, check session details for keybinds.json file path!");
+    mvwprintw(menu_win, 30, 2, "To modify keybinds, check session details for keybinds.json file path!");
     wattroff(menu_win, COLOR_PAIR(4) | A_BOLD);
-    wrefresh(menu_win); 
+    markDirty(menu_win);
   }
   else if (window == "warning") {
       wattron(menu_win, COLOR_PAIR(COLOR_RED));
@@ -134,8 +140,8 @@ void displayWindow(WINDOW* menu_win, const std::string window, const std::unorde
       mvwprintw(menu_win, 7, 2, "3. p - Toggle playback");
       mvwprintw(menu_win, 8, 2, "4. 9 - Increase vol");
       mvwprintw(menu_win, 9, 2, "5. 0 - Decrease vol");
-      mvwprintw(menu_win, 12, 2, "Current Song will play in a LOOP if you DO NOT exit lyrics view!!");
-      wrefresh(menu_win);
+      mvwprintw(menu_win, 12, 2, "The queue plays on, the lyrics follow the song!");
+      markDirty(menu_win);
   }
   else if (window == "LyricErr") {
     werase(menu_win);
@@ -143,12 +149,11 @@ void displayWindow(WINDOW* menu_win, const std::string window, const std::unorde
     mvwprintw(menu_win, 0, 2, " Artists: ");
     mvwprintw(menu_win, 2, 20, "NO LYRICS FOR THIS SONG!");
     mvwprintw(menu_win, 4, 20, "Redirecting to main window...");
-    wrefresh(menu_win);
+    markDirty(menu_win);
   }
 }
 
-void ncursesWinLoop(MENU* artistMenu, MENU* songMenu, WINDOW* artist_menu_win, WINDOW* song_menu_win, WINDOW* status_win, WINDOW* title_win, const char* title_content, bool showingArtMen) {
-  ncursesWinControl(artist_menu_win, song_menu_win, status_win, title_win, "refresh");
+void ncursesWinLoop(ListView& artistList, ListView& songList, WINDOW* artist_menu_win, WINDOW* song_menu_win, WINDOW* status_win, WINDOW* title_win, const char* title_content, bool showingArtMen, const char* groupTitle) {
   box(artist_menu_win, 0, 0);
   box(song_menu_win, 0, 0);
   wmove(title_win, 0, 0);
@@ -157,17 +162,18 @@ void ncursesWinLoop(MENU* artistMenu, MENU* songMenu, WINDOW* artist_menu_win, W
   wbkgd(title_win, COLOR_PAIR(5) | A_BOLD);
   wattron(title_win, COLOR_PAIR(6));
   mvwprintw(title_win, 0, 1, title_content);  // Replace with your title
-  showingArtMen ? mvwprintw(artist_menu_win, 0, 2, " Artists: ") : mvwprintw(artist_menu_win, 0, 2, " Help Window: ");
+  showingArtMen ? mvwprintw(artist_menu_win, 0, 2, "%s", groupTitle) : mvwprintw(artist_menu_win, 0, 2, " Help Window: ");
   mvwprintw(song_menu_win, 0, 2, " Songs: ");
   wattroff(title_win, COLOR_PAIR(5));
   wattroff(title_win, COLOR_PAIR(6));
-  wrefresh(title_win);
-  post_menu(artistMenu);  // Post the active menu
-  post_menu(songMenu);
+  if (showingArtMen) {
+    artistList.draw();  // the artist pane may be showing help / session details instead
+  }
+  songList.draw();
   ncursesWinControl(artist_menu_win, song_menu_win, status_win, title_win, "refresh");
 }
 
-void updateStatusBar(WINDOW* status_win, const std::string& songName, const std::string& artistName, const std::string& songGenre, const sf::Music& music, bool firstEnterPressed, bool showingLyrics) {
+void updateStatusBar(WINDOW* status_win, const std::string& songName, const std::string& artistName, const std::string& songGenre, const PlaybackEngine& music, bool firstEnterPressed, bool showingLyrics, bool loading, const std::string& notice) {
     const int maxTotalWidth = 201;  // Maximum width of the status bar
     const std::string separator = "  |  ";
     const int separatorLength = separator.length();
@@ -195,8 +201,10 @@ void updateStatusBar(WINDOW* status_win, const std::string& songName, const std:
     const char* playPauseSymbol;
     if (showingLyrics) {
         playPauseSymbol = "&&";
+    } else if (loading) {
+        playPauseSymbol = "..";
     } else {
-        if (music.getStatus() == sf::Music::Playing) {
+        if (music.getStatus() == sf::SoundSource::Playing) {
             playPauseSymbol = "<>";
         } else {
             playPauseSymbol = "!!";
@@ -216,7 +224,9 @@ void updateStatusBar(WINDOW* status_win, const std::string& songName, const std:
     statusStream << "   " << (firstEnterPressed ? playPauseSymbol : launchSymbol) << separator
                  << (firstEnterPressed ? displayName : launchName) << separator;
     
-    if (firstEnterPressed) {
+    if (firstEnterPressed && loading) {
+        statusStream << " Loading...  ";  // same width as the times it replaces
+    } else if (firstEnterPressed) {
         statusStream << (posMinutes < 10 ? "0" : "") << posMinutes << ":"
                      << (posSeconds < 10 ? "0" : "") << posSeconds << " / "
                      << (durMinutes < 10 ? "0" : "") << durMinutes << ":"
@@ -230,37 +240,41 @@ void updateStatusBar(WINDOW* status_win, const std::string& songName, const std:
     // Get the current status string
     std::string statusBar = statusStream.str();
 
+    // A notice (library rescanned) takes the genre's place while it lasts
+    const std::string& tail = notice.empty() ? songGenre : notice;
+
     // Add whitespace padding to ensure the status bar is 230 characters wide
-    if (statusBar.length() < maxTotalWidth) {
-        statusBar.append(maxTotalWidth - statusBar.length() - songGenre.length(), ' ');
+    if (statusBar.length() + tail.length() < maxTotalWidth) {
+        statusBar.append(maxTotalWidth - statusBar.length() - tail.length(), ' ');
     }
 
     // Append the genre at the end
-    statusBar += separator + songGenre + " ";
+    statusBar += separator + tail + " ";
 
     mvwprintw(status_win, 1, 1, "%s", statusBar.c_str());
 
     wattroff(status_win, COLOR_PAIR(5));
     wattroff(status_win, COLOR_PAIR(6));
-    wrefresh(status_win);
+    markDirty(status_win);
 }
 
-void highlightFocusedWindow(MENU* menu, bool focused) {
+void highlightFocusedWindow(ListView& list, bool focused) {
+    WINDOW* win = list.window();
     if (focused) { 
-        set_menu_fore(menu, COLOR_PAIR(COLOR_RED));  // Set text color to black
-        set_menu_back(menu, COLOR_PAIR(A_NORMAL));  // Set background to grey
-        wattron(menu_win(menu), COLOR_PAIR(LIGHT_GREEN_COLOR));  // Highlight the item
-        box(menu_win(menu), 0, 0);
+        list.setFore(COLOR_PAIR(COLOR_RED));  // Set text color to black
+        list.setBack(COLOR_PAIR(A_NORMAL));  // Set background to grey
+        wattron(win, COLOR_PAIR(LIGHT_GREEN_COLOR));  // Highlight the item
+        box(win, 0, 0);
     } else {
-        set_menu_fore(menu, A_NORMAL);
-        set_menu_back(menu, COLOR_PAIR(A_NORMAL));
-        wattroff(menu_win(menu), COLOR_PAIR(GREY_BACKGROUND_COLOR));
+        list.setFore(A_NORMAL);
+        list.setBack(COLOR_PAIR(A_NORMAL));
+        wattroff(win, COLOR_PAIR(GREY_BACKGROUND_COLOR));
     }
-    wrefresh(menu_win(menu));
+    list.draw();
 }
 
 
-bool showExitConfirmation(WINDOW* parent_win) {
+bool showExitConfirmation() {
     int height = 6;
     int width = 55;
     int start_y = (LINES - height) / 2;
@@ -272,7 +286,8 @@ bool showExitConfirmation(WINDOW* parent_win) {
     mvwprintw(confirm_win, 1, 20, "Exit LITEMUS?");
     mvwprintw(confirm_win, 4, 10, "Yes (Y/Q)                No (N/esc)");
 
-    wrefresh(confirm_win);
+    markDirty(confirm_win);
+    flushFrame();
 
     int ch;
     bool exitConfirmed = false;
@@ -283,8 +298,10 @@ bool showExitConfirmation(WINDOW* parent_win) {
         exitConfirmed = true;
     }
 
+    compositorForget(confirm_win);
     delwin(confirm_win);
-    wrefresh(parent_win); // Refresh the parent window
+    markAllDirty(); // uncover what the dialog was drawn over
+    flushFrame();
 
     return exitConfirmed;
 }
@@ -298,121 +315,46 @@ void printMultiLine(WINDOW* win, const std::vector<std::string>& lines, int star
     }
 }
 
-void ncursesMenuSetup(MENU* Menu, WINDOW* win, int menu_height, int menu_width, const char* type) {
-  set_menu_win(Menu, win);
-  set_menu_sub(Menu, derwin(win, menu_height - 3, menu_width - 2, 2, 1)); 
-  set_menu_mark(Menu, " ->");
+ListView::RowSource groupRows(const Library& library, BrowseMode mode) {
+    ListView::RowSource rows;
+    rows.text = [&library, mode](size_t row, std::string& text) {
+        library.appendGroupName(mode, library.view(mode).groups[row], text);
+    };
+    return rows;
 }
 
-void move_menu_down(MENU* artistMenu, MENU* songMenu, bool showingArtists) {
-    if (showingArtists) {
-        int itemCount = item_count(artistMenu);
-        ITEM* curItem = current_item(artistMenu);
-        int currentIndex = item_index(curItem);
-        int topRow = top_row(artistMenu);
-        int rows, cols;
-        scale_menu(artistMenu, &rows, &cols);
-        int lastVisibleItem = topRow + rows - 4;
-
-        if (currentIndex == lastVisibleItem && itemCount >= 41) {
-            // Move to the next page of items 
-            menu_driver(artistMenu, REQ_SCR_DPAGE);
-            set_current_item(artistMenu, curItem);
-            topRow = top_row(artistMenu);
-            scale_menu(artistMenu, &rows, &cols);
-            lastVisibleItem = topRow + rows - 4;
-        } else {
-              if (currentIndex <= itemCount - 1) {
-                menu_driver(artistMenu, REQ_DOWN_ITEM);
-              }
-        }
-    } else {
-        int itemCount = item_count(songMenu);
-        ITEM* curItem = current_item(songMenu);
-        int currentIndex = item_index(curItem);
-        int topRow = top_row(songMenu);
-        int rows, cols;
-        scale_menu(songMenu, &rows, &cols);
-        int lastVisibleItem = topRow + rows - 4;
-
-        if (currentIndex == lastVisibleItem && currentIndex != 0 && itemCount >= 41) {
-            // Move to the next page of items
-            menu_driver(songMenu, REQ_SCR_DPAGE);
-            set_current_item(songMenu, curItem);
-            topRow = top_row(songMenu);
-            scale_menu(songMenu, &rows, &cols);
-            lastVisibleItem = topRow + rows - 4;
-        } else {
-            if (currentIndex < itemCount - 1) {
-                do {
-                    werase(menu_win(songMenu));
-                    menu_driver(songMenu, REQ_DOWN_ITEM);
-                    curItem = current_item(songMenu);
-                    currentIndex = item_index(curItem);
-                } while (currentIndex < itemCount - 1 && !(item_opts(curItem) & O_SELECTABLE));
-            }
+// Section headers ("Album (year)" under an artist), then "  title<padding> mm:ss" per track
+ListView::RowSource songRows(const Library& library, BrowseMode mode, uint32_t group) {
+    ListView::RowSource rows;
+    rows.text = [&library, mode, group](size_t row, std::string& text) {
+        const BrowseView& view = library.view(mode);
+        uint32_t section;
+        uint32_t trackId = groupRowTrack(view, group, static_cast<uint32_t>(row), section);
+        if (trackId == INDEX_NOT_FOUND) {
+            library.appendSectionLabel(mode, view.sections[section], text);
+            return;
         }
-    }
+        const LibraryTrack& track = library.track(trackId);
+        size_t titleWidth = view.groups[group].titleWidth;
+        text += "  ";
+        text += track.title;
+        text.append(track.title.size() < titleWidth ? titleWidth - track.title.size() : 0, ' ');
+        text += ' ';
+        text += track.duration;
+    };
+    rows.selectable = [&library, mode, group](size_t row) {
+        uint32_t section;
+        return groupRowTrack(library.view(mode), group, static_cast<uint32_t>(row), section) != INDEX_NOT_FOUND;
+    };
+    return rows;
 }
 
-void move_menu_up(MENU* artistMenu, MENU* songMenu, bool showingArtists) {
-    if (showingArtists) {
-        ITEM* curItem = current_item(artistMenu);
-        int currentIndex = item_index(curItem);
-        if (currentIndex > 0) {
-            do {
-                werase(menu_win(artistMenu));
-                menu_driver(artistMenu, REQ_UP_ITEM);
-                curItem = current_item(artistMenu);
-                currentIndex = item_index(curItem);
-            } while (currentIndex > 0 && !(item_opts(curItem) & O_SELECTABLE));
-        }
-    } else {
-        ITEM* curItem = current_item(songMenu);
-        int currentIndex = item_index(curItem);
-        if (currentIndex > 1) {
-            do {
-                werase(menu_win(songMenu));
-                menu_driver(songMenu, REQ_UP_ITEM);
-                curItem = current_item(songMenu);
-                currentIndex = item_index(curItem);
-            } while (currentIndex > 1 && !(item_opts(curItem) & O_SELECTABLE));
-        }
+const char* browseTitle(BrowseMode mode) {
+    switch (mode) {
+        case BrowseMode::Album: return " Albums: ";
+        case BrowseMode::Genre: return " Genres: ";
+        case BrowseMode::Year: return " Years: ";
+        case BrowseMode::Playlist: return " Playlists: ";
+        default: return " Artists: ";
     }
 }
-
-ITEM** createItems(const std::string& name, std::vector<std::string>& allArtists, std::vector<std::string>& songTitles, std::vector<std::string>& songDurations, std::vector<std::string>& albumNames, std::vector<std::string>& albumYears) {
-  if (name == "artist") {
-    ITEM** artistItems = new ITEM*[allArtists.size() + 1];
-    for (size_t i = 0; i < allArtists.size(); ++i) {
-        artistItems[i] = new_item(allArtists[i].c_str(), "");
-    }
-    artistItems[allArtists.size()] = nullptr;
-    return artistItems;
-  }
-  else if (name == "song") {
-    std::map<std::string, std::vector<std::string>> songsByAlbum;
-    for (size_t i = 0; i < albumNames.size(); ++i) {
-        std::string albumKey = albumNames[i] + " (" + albumYears[i].substr(0,4) + ")";
-        songsByAlbum[albumKey].push_back(songTitles[i]);
-    }
-
-    std::vector<std::string> newMenuItems;
-    for (const auto& [album, songs] : songsByAlbum) {
-        newMenuItems.push_back(album); // Non-selectable title
-        for (const auto& song : songs) {
-            newMenuItems.push_back("  " + song); // Selectable songs
-        }
-    }
-
-    ITEM** songItems = new ITEM*[newMenuItems.size() + 1];
-    for (size_t i = 0; i < newMenuItems.size(); ++i) {
-        songItems[i] = new_item(strdup(newMenuItems[i].c_str()), "");
-        if (newMenuItems[i].find("  ") != 0) { // Non-selectable if not a song (album title)
-            item_opts_off(songItems[i], O_SELECTABLE);
-        }
-    }
-    songItems[newMenuItems.size()] = nullptr;
-    return songItems;
-  }
-}
@@ -1,5 +1,5 @@
 #include "../parsers.hpp"
-#include "../sfml_helpers.hpp"
+#include <cstdio>
 
 using json = nlohmann::json;
 
@@ -13,122 +13,65 @@ std::string get_home_directory() {
     }
 }
 
-std::vector<std::string> parseArtists(const std::string& artistsFile) {
-    std::ifstream file(artistsFile);
-    if (!file.is_open()) {
-        std::cerr << "Could not open artists file: " << artistsFile << std::endl;
-        return {};
+// Song list layout of a browse group: each section contributes a header row followed by its
+// tracks. Sections of a group are consecutive in its track span, so section j of the group
+// starts at row (section.first - group.first) + j and a row is found by binary search.
+uint32_t groupRowCount(const BrowseView& view, uint32_t group) {
+    if (group >= view.groups.size()) {
+        return 0;
     }
-
-    json j;
-    try {
-        file >> j;
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing JSON: " << e.what() << std::endl;
-        return {};
-    }
-
-    std::vector<std::string> artists;
-    for (const auto& artist : j) {
-        artists.push_back(artist.get<std::string>());
-    }
-
-    return artists;
+    return view.groups[group].sectionCount + view.groups[group].count;
 }
 
-
-std::tuple<std::vector<std::string>, std::vector<std::string>, std::vector<std::string>, std::vector<std::string>, std::vector<std::string>> listSongs(const std::string& cacheFile, const std::string& artistName, const std::string& songsDirectory) {
-    std::ifstream file(cacheFile);
-    if (!file.is_open()) {
-        std::cerr << "Could not open cache file: " << cacheFile << std::endl;
-        return {{}, {}, {}, {}, {}};
-    }
-
-    json j;
-    try {
-        file >> j;
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing JSON: " << e.what() << std::endl;
-        return {{}, {}, {}, {}, {}};
+uint32_t groupRowTrack(const BrowseView& view, uint32_t group, uint32_t row, uint32_t& section) {
+    const BrowseGroup& shown = view.groups[group];
+    section = shown.firstSection;
+    if (shown.sectionCount == 0) {
+        return INDEX_NOT_FOUND;  // a playlist nothing matches: no rows at all
     }
-
-    std::vector<std::string> songTitles;
-    std::vector<std::string> songPaths;
-    std::vector<std::string> songDurations;
-    std::vector<std::string> Albums;
-    std::vector<std::string> albumYears;
-
-    // Iterate over each artist
-    for (auto it = j.begin(); it != j.end(); ++it) {
-        if (it.key() == artistName) {
-            auto& albums = it.value();
-
-            // Iterate over each album of the artist
-            for (auto albumIt = albums.begin(); albumIt != albums.end(); ++albumIt) {
-                std::string albumName = albumIt.key();
-                auto& discs = albumIt.value();
-
-                // Iterate over each disc in the album
-                for (auto discIt = discs.begin(); discIt != discs.end(); ++discIt) {
-                    auto& tracks = *discIt;
-
-                    // Iterate over each track in the disc
-                    for (auto trackIt = tracks.begin(); trackIt != tracks.end(); ++trackIt) {
-                        auto& songInfo = *trackIt;
-
-                        // Check if the track contains a valid song object
-                        if (!songInfo.empty()) {
-                            std::string songTitle = songInfo["title"].get<std::string>();
-                            std::string songFilename = songInfo["filename"].get<std::string>();
-                            std::string songPath = songsDirectory + songFilename;
-                            std::string albumYear = songInfo["date"].get<std::string>();
-
-                            songTitles.push_back(songTitle);
-                            songPaths.push_back(songPath);
-                            songDurations.push_back(getSongDuration(songPath));
-                            Albums.push_back(albumName);
-                            albumYears.push_back(albumYear);
-                        }
-                    }
-                }
-            }
+    auto headerRow = [&](uint32_t j) {
+        return view.sections[shown.firstSection + j].first - shown.first + j;
+    };
+    uint32_t lo = 0, hi = shown.sectionCount;  // last section whose header row is <= row
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (headerRow(mid) <= row) {
+            lo = mid;
+        } else {
+            hi = mid;
         }
     }
-
-    return {songTitles, songPaths, songDurations, Albums, albumYears};
+    section += lo;
+    uint32_t offset = row - headerRow(lo);
+    if (offset == 0) {
+        return INDEX_NOT_FOUND; // section header
+    }
+    return view.tracks[view.sections[section].first + offset - 1];
 }
 
-std::pair<std::string, std::string> findCurrentGenreArtist(const std::string& cacheFile, const std::string& currentSong, std::string& currentLyrics) {
-    std::ifstream file(cacheFile);
-    if (!file.is_open()) {
-        std::cerr << "Could not open cache file: " << cacheFile << std::endl;
-        return {};
-    }
+// Inverse of groupRowTrack: the row of the track at `position` of the view's tracks, inside its group
+uint32_t groupTrackRow(const BrowseView& view, uint32_t group, uint32_t position) {
+    const BrowseGroup& shown = view.groups[group];
+    auto section = std::upper_bound(view.sections.begin() + shown.firstSection, view.sections.begin() + shown.firstSection + shown.sectionCount, position,
+                                    [](uint32_t at, const BrowseSection& s) { return at < s.first; });
+    uint32_t headers = static_cast<uint32_t>(section - (view.sections.begin() + shown.firstSection));  // one per section so far
+    return position - shown.first + headers;
+}
 
-    json j;
-    try {
-        file >> j;
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing JSON: " << e.what() << std::endl;
-        return {};
-    }
+// mm:ss from the duration cached at scan time (minutes keep growing past 99)
+std::string formatDuration(uint32_t durationMs) {
+    uint32_t seconds = durationMs / 1000;
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%02u:%02u", seconds / 60, seconds % 60);
+    return std::string(buffer);
+}
 
-    for (auto it = j.begin(); it != j.end(); ++it) {
-        for (auto albumIt = it.value().begin(); albumIt != it.value().end(); ++albumIt) {
-            for (auto discIt = albumIt.value().begin(); discIt != albumIt.value().end(); ++discIt) {
-                for (auto trackIt = discIt.value().begin(); trackIt != discIt.value().end(); ++trackIt) {
-                    if (trackIt.value()["title"] == currentSong) {
-                        std::string genre = trackIt.value()["genre"];
-                        std::string artist = it.key();
-                        currentLyrics = trackIt.value()["lyrics"];
-                        return {genre, artist}; // Return the genre and artist as a pair
-                    }
-                }
-            }
-        }
+// Direct lookup by the id carried with playback: constant time, and unambiguous when titles repeat
+std::pair<std::string, std::string> findCurrentGenreArtist(const Library& library, uint32_t trackId) {
+    if (trackId >= library.trackCount()) {
+        return {}; // Return empty pair if genre and artist not found
     }
-
-    return {}; // Return empty pair if genre and artist not found
+    return {library.trackGenre(trackId), library.trackArtist(trackId)};
 }
 
 std::vector<std::string> splitStringByNewlines(const std::string& str) {
@@ -155,28 +98,161 @@ void litemusHelper(const std::string& NC) {
     std::cout << NC << "LiteMus - Light Music Player based on ncurses" << std::endl
               << std::endl
               << "Usage: lmus [OPTIONS]" << std::endl << std::endl
-              << "   run               Run Litemus" << std::endl
+              << "   run               Run Litemus (attaches to a running daemon instead)" << std::endl
+              << "   daemon            Run the player without a UI, controlled over $HOME/.cache/litemus/lmus.sock" << std::endl
+              << "   ctl CMD           Send a command to the daemon: play [ID], pause, toggle, next, prev," << std::endl
+              << "                     seek [+|-]S, volume [+|-]N, enqueue ID, shuffle [on|off], status, quit" << std::endl
               << "   --help            Show this help dialog and exit" << std::endl
               << "   --remote-cache    Remotely cache songs (dir set in $HOME/.cache/litemus/songDirectory.txt)" << std::endl
               << "   --clear-cache     Remove the current chosen directory's cache" << std::endl
+              << "   --jobs N          Metadata extraction workers while caching (default: number of cores)" << std::endl
+              << "   --buffer-seconds N Seconds of audio decoded ahead of playback (default: 4)" << std::endl
+              << "   --track-cache-mb N Memory kept for recently played files, 0 disables (default: 128)" << std::endl
+              << "   --frame-stats     Count the bytes written to the terminal per frame (shown in session details)" << std::endl
+              << "   --loudness        Also measure EBU R128 loudness of new songs while caching (decodes them once)" << std::endl
+              << "   --normalize MODE  Loudness normalization at playback: off, track, album or auto (default: auto)" << std::endl
               << std::endl << "Any bugs or issues check this repository https://github.com/nots1dd/Litemus"
               << std::endl;
 }
 
-void verboseQuit(const std::string& NC, const std::string& BLUE, const std::string& BOLD) {
-  cout << NC << "Menus unposted +" << endl << "Quit function invoked +" << endl << "Windows deleted successfully +" << endl << "Ncurses ended." << endl;
-  cout << BLUE << BOLD << "---------------------- LITEMUS -- SESSION -- END -------------------------" << endl;
+// Strips `--jobs N` out of argv so the remaining arguments keep their usual positions
+// Returns 0 when the option is absent (lmus_cache_main then uses every core)
+unsigned int extractJobsOption(int& argc, char* argv[]) {
+    unsigned int jobs = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) != "--jobs") {
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "[ERROR] --jobs expects a number of workers" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        try {
+            int value = std::stoi(argv[i + 1]);
+            if (value <= 0) {
+                throw std::invalid_argument("non-positive");
+            }
+            jobs = static_cast<unsigned int>(value);
+        } catch (const std::exception&) {
+            std::cerr << "[ERROR] Invalid value for --jobs: " << argv[i + 1] << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        for (int j = i; j + 2 <= argc; ++j) {
+            argv[j] = argv[j + 2];
+        }
+        argc -= 2;
+        break;
+    }
+    return jobs;
 }
 
-size_t getMaxSongTitleLength(const std::vector<std::string>& songTitles, const std::vector<std::string>& songDurations) {
-    size_t maxLength = 0;
-    for (size_t i = 0; i < songTitles.size(); ++i) {
-        size_t combinedLength = songTitles[i].length() + songDurations[i].length() + 10; // 5 is for spaces and brackets
-        if (combinedLength > maxLength) {
-            maxLength = combinedLength;
+// Strips `--buffer-seconds N` out of argv the same way; N is how much PCM the decode thread keeps ahead
+// Returns `fallback` when the option is absent
+float extractBufferSecondsOption(int& argc, char* argv[], float fallback) {
+    float seconds = fallback;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) != "--buffer-seconds") {
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "[ERROR] --buffer-seconds expects a number of seconds" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        try {
+            float value = std::stof(argv[i + 1]);
+            if (!(value > 0.f) || value > 600.f) {
+                throw std::invalid_argument("out of range");
+            }
+            seconds = value;
+        } catch (const std::exception&) {
+            std::cerr << "[ERROR] Invalid value for --buffer-seconds: " << argv[i + 1] << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        for (int j = i; j + 2 <= argc; ++j) {
+            argv[j] = argv[j + 2];
+        }
+        argc -= 2;
+        break;
+    }
+    return seconds;
+}
+
+// Strips `--track-cache-mb N` out of argv the same way; N bounds the compressed bytes kept in memory
+uint32_t extractTrackCacheOption(int& argc, char* argv[], uint32_t fallback) {
+    uint32_t megabytes = fallback;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) != "--track-cache-mb") {
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "[ERROR] --track-cache-mb expects a number of megabytes" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        try {
+            unsigned long value = std::stoul(argv[i + 1]);
+            if (value > 16384 || std::string(argv[i + 1]).find('-') != std::string::npos) {
+                throw std::invalid_argument("out of range");
+            }
+            megabytes = static_cast<uint32_t>(value);
+        } catch (const std::exception&) {
+            std::cerr << "[ERROR] Invalid value for --track-cache-mb: " << argv[i + 1] << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        for (int j = i; j + 2 <= argc; ++j) {
+            argv[j] = argv[j + 2];
+        }
+        argc -= 2;
+        break;
+    }
+    return megabytes;
+}
+
+// Strips a bare flag such as `--frame-stats` out of argv, like extractJobsOption
+bool extractFlagOption(int& argc, char* argv[], const std::string& flag) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == flag) {
+            for (int j = i; j + 1 <= argc; ++j) {
+                argv[j] = argv[j + 1];
+            }
+            argc -= 1;
+            return true;
         }
     }
-    return maxLength;
+    return false;
+}
+
+// Strips `--normalize MODE` out of argv; auto when absent
+NormalizeMode extractNormalizeOption(int& argc, char* argv[]) {
+    NormalizeMode mode = NormalizeMode::Auto;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) != "--normalize") {
+            continue;
+        }
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        if (value == "off") {
+            mode = NormalizeMode::Off;
+        } else if (value == "track") {
+            mode = NormalizeMode::Track;
+        } else if (value == "album") {
+            mode = NormalizeMode::Album;
+        } else if (value == "auto") {
+            mode = NormalizeMode::Auto;
+        } else {
+            std::cerr << "[ERROR] --normalize expects off, track, album or auto" << std::endl;
+            std::exit(EXIT_FAILURE);
+        }
+        for (int j = i; j + 2 <= argc; ++j) {
+            argv[j] = argv[j + 2];
+        }
+        argc -= 2;
+        break;
+    }
+    return mode;
+}
+
+void verboseQuit(const std::string& NC, const std::string& BLUE, const std::string& BOLD) {
+  cout << NC << "Menus unposted +" << endl << "Quit function invoked +" << endl << "Windows deleted successfully +" << endl << "Ncurses ended." << endl;
+  cout << BLUE << BOLD << "---------------------- LITEMUS -- SESSION -- END -------------------------" << endl;
 }
 
 std::string getRequiredWhitespaces(const std::string& title, size_t maxLength) {
@@ -188,15 +264,6 @@ std::string getRequiredWhitespaces(const std::string& title, size_t maxLength) {
     }
 }
 
-std::vector<std::string> getTitlesWithWhiteSpaces(const std::vector<std::string>& songTitles, const std::vector<std::string>& songDurations, size_t maxLength) {
-    std::vector<std::string> titlesWithWhitespaces;
-    for (size_t i = 0; i < songTitles.size(); ++i) {
-        std::string formattedTitle = songTitles[i] + getRequiredWhitespaces(songTitles[i], maxLength) + " " + songDurations[i];
-        titlesWithWhitespaces.push_back(formattedTitle);
-    }
-    return titlesWithWhitespaces;
-}
-
 std::string removeWhitespace(const std::string& str) {
     std::string result;
     std::remove_copy_if(str.begin(), str.end(), std::back_inserter(result), ::isspace);
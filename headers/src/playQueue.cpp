@@ -0,0 +1,331 @@
+#include "../playQueue.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <unordered_map>
+#include "nlohmann/json.hpp"
+
+using json = nlohmann::json;
+
+const int QUEUE_FILE_VERSION = 1;
+
+PlayQueue::PlayQueue(uint32_t trackCount)
+    : nextLink(trackCount, INDEX_NOT_FOUND), prevLink(trackCount, INDEX_NOT_FOUND), orderPos(trackCount, INDEX_NOT_FOUND) {}
+
+void PlayQueue::link(uint32_t trackId, uint32_t after) {
+    if (after == INDEX_NOT_FOUND) {
+        nextLink[trackId] = trackId;
+        prevLink[trackId] = trackId;
+        head = trackId;
+    } else {
+        uint32_t before = nextLink[after];
+        nextLink[trackId] = before;
+        prevLink[trackId] = after;
+        nextLink[after] = trackId;
+        prevLink[before] = trackId;
+    }
+    ++count;
+}
+
+void PlayQueue::unlink(uint32_t trackId) {
+    if (count == 1) {
+        head = INDEX_NOT_FOUND;
+    } else {
+        nextLink[prevLink[trackId]] = nextLink[trackId];
+        prevLink[nextLink[trackId]] = prevLink[trackId];
+        if (head == trackId) {
+            head = nextLink[trackId];
+        }
+    }
+    nextLink[trackId] = INDEX_NOT_FOUND;
+    prevLink[trackId] = INDEX_NOT_FOUND;
+    --count;
+}
+
+void PlayQueue::renumberFrom(size_t position) {
+    for (size_t i = position; i < order.size(); ++i) {
+        orderPos[order[i]] = static_cast<uint32_t>(i);
+    }
+}
+
+// Fisher-Yates over the queue, then the current track is swapped to the front
+void PlayQueue::reshuffle() {
+    for (uint32_t id : order) {
+        orderPos[id] = INDEX_NOT_FOUND;
+    }
+    order.clear();
+    order.reserve(count);
+    for (uint32_t id = head, i = 0; i < count; id = nextLink[id], ++i) {
+        order.push_back(id);
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+    auto playing = std::find(order.begin(), order.end(), currentId);
+    if (playing != order.end()) {
+        std::iter_swap(order.begin(), playing);
+    }
+    renumberFrom(0);
+}
+
+void PlayQueue::replace(const std::vector<uint32_t>& trackIds, uint32_t currentTrackId) {
+    clear();
+    for (uint32_t id : trackIds) {
+        if (id < nextLink.size() && !contains(id)) {
+            link(id, head == INDEX_NOT_FOUND ? INDEX_NOT_FOUND : prevLink[head]);
+        }
+    }
+    currentId = contains(currentTrackId) ? currentTrackId : head;
+    if (shuffle) {
+        reshuffle();
+    }
+}
+
+bool PlayQueue::append(uint32_t trackId) {
+    if (trackId >= nextLink.size() || contains(trackId)) {
+        return false;
+    }
+    link(trackId, head == INDEX_NOT_FOUND ? INDEX_NOT_FOUND : prevLink[head]);
+    if (currentId == INDEX_NOT_FOUND) {
+        currentId = trackId;
+    }
+    if (shuffle) {
+        // Lands on a random slot among the tracks still to come this cycle
+        order.push_back(trackId);
+        orderPos[trackId] = static_cast<uint32_t>(order.size() - 1);
+        size_t first = orderPos[currentId] + 1;
+        if (first < order.size() - 1) {
+            size_t slot = std::uniform_int_distribution<size_t>(first, order.size() - 1)(rng);
+            std::swap(order[slot], order.back());
+            orderPos[order[slot]] = static_cast<uint32_t>(slot);
+            orderPos[order.back()] = static_cast<uint32_t>(order.size() - 1);
+        }
+    }
+    return true;
+}
+
+bool PlayQueue::insertNext(uint32_t trackId) {
+    if (trackId >= nextLink.size() || trackId == currentId) {
+        return false;
+    }
+    if (contains(trackId)) {
+        remove(trackId);
+    }
+    link(trackId, currentId);
+    if (currentId == INDEX_NOT_FOUND) {
+        currentId = trackId;
+    }
+    if (shuffle) {
+        size_t position = trackId == currentId ? 0 : orderPos[currentId] + 1;
+        order.insert(order.begin() + position, trackId);
+        renumberFrom(position);
+    }
+    return true;
+}
+
+bool PlayQueue::remove(uint32_t trackId) {
+    if (!contains(trackId)) {
+        return false;
+    }
+    if (trackId == currentId) {
+        // Steps back, so the track that followed the removed one is still what comes next
+        currentId = count > 1 ? peekPrevious() : INDEX_NOT_FOUND;
+    }
+    unlink(trackId);
+    if (shuffle) {
+        // Keeps the rest of the permutation in order; only the tail is renumbered
+        size_t position = orderPos[trackId];
+        order.erase(order.begin() + position);
+        orderPos[trackId] = INDEX_NOT_FOUND;
+        renumberFrom(position);
+    }
+    return true;
+}
+
+void PlayQueue::clear() {
+    for (uint32_t id = head; count > 0;) {
+        uint32_t following = nextLink[id];
+        nextLink[id] = INDEX_NOT_FOUND;
+        prevLink[id] = INDEX_NOT_FOUND;
+        --count;
+        id = following;
+    }
+    for (uint32_t id : order) {
+        orderPos[id] = INDEX_NOT_FOUND;
+    }
+    order.clear();
+    head = INDEX_NOT_FOUND;
+    currentId = INDEX_NOT_FOUND;
+}
+
+uint32_t PlayQueue::peekNext() const {
+    if (currentId == INDEX_NOT_FOUND) {
+        return INDEX_NOT_FOUND;
+    }
+    if (shuffle) {
+        return order[(orderPos[currentId] + 1) % order.size()];
+    }
+    return nextLink[currentId];
+}
+
+uint32_t PlayQueue::peekPrevious() const {
+    if (currentId == INDEX_NOT_FOUND) {
+        return INDEX_NOT_FOUND;
+    }
+    if (shuffle) {
+        return order[(orderPos[currentId] + order.size() - 1) % order.size()];
+    }
+    return prevLink[currentId];
+}
+
+uint32_t PlayQueue::advance() {
+    currentId = peekNext();
+    return currentId;
+}
+
+uint32_t PlayQueue::retreat() {
+    currentId = peekPrevious();
+    return currentId;
+}
+
+bool PlayQueue::setCurrent(uint32_t trackId) {
+    if (!contains(trackId)) {
+        return false;
+    }
+    currentId = trackId;
+    return true;
+}
+
+void PlayQueue::setShuffle(bool on) {
+    if (on == shuffle) {
+        return;
+    }
+    shuffle = on;
+    if (shuffle) {
+        reshuffle();
+    } else {
+        for (uint32_t id : order) {
+            orderPos[id] = INDEX_NOT_FOUND;
+        }
+        order.clear();
+    }
+}
+
+void PlayQueue::remap(const std::vector<uint32_t>& newIds, uint32_t trackCount) {
+    std::vector<uint32_t> trackIds;
+    trackIds.reserve(count);
+    for (uint32_t id = head, i = 0; i < count; id = nextLink[id], ++i) {
+        if (newIds[id] != INDEX_NOT_FOUND) {
+            trackIds.push_back(newIds[id]);
+        }
+    }
+    std::vector<uint32_t> shuffledIds;
+    for (uint32_t id : order) {
+        if (newIds[id] != INDEX_NOT_FOUND) {
+            shuffledIds.push_back(newIds[id]);
+        }
+    }
+    uint32_t mappedCurrent = currentId == INDEX_NOT_FOUND ? INDEX_NOT_FOUND : newIds[currentId];
+    bool wasShuffled = shuffle;
+
+    nextLink.assign(trackCount, INDEX_NOT_FOUND);
+    prevLink.assign(trackCount, INDEX_NOT_FOUND);
+    orderPos.assign(trackCount, INDEX_NOT_FOUND);
+    order.clear();
+    head = INDEX_NOT_FOUND;
+    currentId = INDEX_NOT_FOUND;
+    count = 0;
+    shuffle = false;
+    replace(trackIds, mappedCurrent);
+    if (wasShuffled) {
+        shuffle = true;
+        order = std::move(shuffledIds);
+        renumberFrom(0);
+        if (order.size() != count) {
+            reshuffle();
+        }
+    }
+}
+
+// Written to a temporary file and renamed, so a crash never leaves half a queue behind
+bool PlayQueue::save(const std::string& filePath, const Library& library) const {
+    json tracks = json::array();
+    for (uint32_t id = head, i = 0; i < count; id = nextLink[id], ++i) {
+        tracks.push_back({id, library.track(id).inode});
+    }
+    json queueJson = {
+        {"version", QUEUE_FILE_VERSION},
+        {"shuffle", shuffle},
+        {"current", currentId == INDEX_NOT_FOUND ? json(nullptr) : json(currentId)},
+        {"tracks", tracks},
+        {"order", order},
+    };
+    const std::string tempPath = filePath + ".tmp";
+    std::ofstream outFile(tempPath, std::ios::trunc);
+    if (!outFile.is_open()) {
+        return false;
+    }
+    outFile << queueJson.dump();
+    outFile.close();
+    return outFile && std::rename(tempPath.c_str(), filePath.c_str()) == 0;
+}
+
+bool PlayQueue::load(const std::string& filePath, const Library& library) {
+    std::ifstream inFile(filePath);
+    if (!inFile.is_open()) {
+        return false;
+    }
+    json queueJson;
+    try {
+        inFile >> queueJson;
+        if (queueJson.value("version", 0) != QUEUE_FILE_VERSION) {
+            return false;
+        }
+
+        // Saved id -> id in the current library; built only if a rescan moved tracks around
+        std::unordered_map<uint64_t, uint32_t> byInode;
+        std::unordered_map<uint32_t, uint32_t> resolved;
+        auto resolve = [&](uint32_t id, uint64_t inode) {
+            if (id < library.trackCount() && library.track(id).inode == inode) {
+                return id;
+            }
+            if (byInode.empty()) {
+                for (uint32_t t = 0; t < library.trackCount(); ++t) {
+                    byInode.emplace(library.track(t).inode, t);
+                }
+            }
+            auto found = byInode.find(inode);
+            return found == byInode.end() ? INDEX_NOT_FOUND : found->second;
+        };
+
+        std::vector<uint32_t> trackIds;
+        for (const json& entry : queueJson.at("tracks")) {
+            uint32_t savedId = entry.at(0).get<uint32_t>();
+            uint32_t id = resolve(savedId, entry.at(1).get<uint64_t>());
+            if (id != INDEX_NOT_FOUND) {
+                resolved[savedId] = id;
+                trackIds.push_back(id);
+            }
+        }
+        uint32_t savedCurrent = queueJson.at("current").is_null() ? INDEX_NOT_FOUND : queueJson.at("current").get<uint32_t>();
+        auto current = resolved.find(savedCurrent);
+
+        shuffle = false;
+        replace(trackIds, current == resolved.end() ? INDEX_NOT_FOUND : current->second);
+        if (queueJson.value("shuffle", false)) {
+            shuffle = true;
+            for (const json& savedId : queueJson.at("order")) {
+                auto id = resolved.find(savedId.get<uint32_t>());
+                if (id != resolved.end() && orderPos[id->second] == INDEX_NOT_FOUND) {
+                    orderPos[id->second] = static_cast<uint32_t>(order.size());
+                    order.push_back(id->second);
+                }
+            }
+            if (order.size() != count) {
+                reshuffle();  // the saved permutation no longer covers the queue
+            }
+        }
+    } catch (const json::exception&) {
+        clear();
+        return false;
+    }
+    return true;
+}
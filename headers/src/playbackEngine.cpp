@@ -0,0 +1,494 @@
+#include "../playbackEngine.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+static const float PRELOAD_SECONDS = 5.f;
+// How long the decode thread may wait for a preload still in flight when the current
+// track ends; everything already in the ring keeps playing meanwhile, and the wait
+// happens without decodeMutex so start() and seeks are not held up by it
+static const std::chrono::milliseconds SPLICE_GRACE(1000);
+// Backstop for wakeups the other side signalled without holding the mutex
+static const std::chrono::milliseconds WAIT_SLICE(10);
+static const std::chrono::milliseconds DECODE_IDLE_SLICE(50);
+
+static sf::Time samplesToTime(uint64_t samples, unsigned int sampleRate, unsigned int channelCount) {
+    if (sampleRate == 0 || channelCount == 0) {
+        return sf::Time::Zero;
+    }
+    return sf::microseconds(static_cast<sf::Int64>(samples * 1000000 / (static_cast<uint64_t>(sampleRate) * channelCount)));
+}
+
+PlaybackEngine::PlaybackEngine(float decodeAheadSeconds)
+    : decodeAheadSeconds(decodeAheadSeconds), nextTrackId(UINT32_MAX), trackId(UINT32_MAX), pendingTrackId(UINT32_MAX) {
+    ring.reset(1);
+    decodeThread = std::thread(&PlaybackEngine::decodeLoop, this);
+    preloader.onLoaded = [this]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        preloadDone.notify_all();
+    };
+}
+
+PlaybackEngine::~PlaybackEngine() {
+    // The streaming thread calls back into this object, it has to be gone first
+    stop();
+    quitting = true;
+    {
+        std::lock_guard<std::mutex> lock(decodeMutex);
+        decodeWake.notify_all();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        preloadDone.notify_all();
+    }
+    decodeThread.join();
+}
+
+bool PlaybackEngine::start(LoadedTrack& track, float trackGain) {
+    stop();
+    if (!track.file) {
+        return false;
+    }
+    unsigned int channels = track.file->getChannelCount();
+    unsigned int rate = track.file->getSampleRate();
+    {
+        std::lock_guard<std::mutex> decodeLock(decodeMutex);
+        decoder.file = std::move(track.file);
+        decoder.stream = std::move(track.stream);
+        decoder.sliced = false;
+        decoder.seekIndex = std::move(track.seekIndex);
+        decoder.path = track.path;
+        decoder.sampleCount = decoder.file->getSampleCount();
+        decoder.duration = decoder.file->getDuration();
+        decoder.gain = trackGain;
+        previous.reset();
+        carry = std::move(track.head);  // prefill() below copies from here, no disk access
+        carryPos = 0;
+        decodedInTrack = 0;
+        streamSamples = 0;
+        channelCount = channels;
+        sampleRate = rate;
+
+        size_t second = static_cast<size_t>(rate) * channels;
+        block.resize(std::max<size_t>(second / 20, channels));   // 50 ms per decode step
+        chunk.resize(std::max<size_t>(second / 4, channels));    // 250 ms per OpenAL buffer
+        size_t ahead = static_cast<size_t>(decodeAheadSeconds * rate) * channels;
+        ring.reset(std::max(ahead, chunk.size() * 4));           // at least what SFML queues up front
+        streamDone = false;
+        starving = false;
+        decoding = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            awaitingSplice = false;
+            preloadDone.notify_all();  // a decode thread waiting on the old track's successor
+            trackId = track.trackId;
+            duration = decoder.duration;
+            trackStart = sf::Time::Zero;
+            pending = false;
+
+            nextPath.clear();
+            preloadRequested = false;
+            preloader.cancel();
+        }
+        prefill();
+    }
+    decodeWake.notify_one();
+    initialize(channels, rate);
+    play();
+    return true;
+}
+
+void PlaybackEngine::stop() {
+    abortWait = true;
+    {
+        std::lock_guard<std::mutex> lock(dataMutex);
+        dataReady.notify_all();
+    }
+    skipRewind = true;
+    sf::SoundStream::stop();
+    skipRewind = false;
+    abortWait = false;
+}
+
+void PlaybackEngine::setNext(const std::string& path, uint32_t newTrackId, float trackGain) {
+    std::lock_guard<std::mutex> lock(mutex);
+    nextPath = path;
+    nextTrackId = newTrackId;
+    nextGain = trackGain;
+    preloadRequested = false;  // the decode thread asks again if already inside the window
+    preloader.cancel();
+}
+
+void PlaybackEngine::setSeekIndexDir(const std::string& seekIndexDir) {
+    preloader.setSeekIndexDir(seekIndexDir);
+}
+
+void PlaybackEngine::setTrackCache(TrackCache* cache) {
+    preloader.setTrackCache(cache);
+}
+
+bool PlaybackEngine::update() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pending) {
+        return false;
+    }
+    if (getStatus() != Stopped && sf::SoundStream::getPlayingOffset() < pendingStart) {
+        return false;
+    }
+    trackStart = pendingStart;
+    trackId = pendingTrackId;
+    duration = pendingDuration;
+    pending = false;
+    return true;
+}
+
+bool PlaybackEngine::transitionPending() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pending;
+}
+
+uint32_t PlaybackEngine::currentTrack() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return trackId;
+}
+
+void PlaybackEngine::renumberTracks(const std::vector<uint32_t>& newIds) {
+    auto renumber = [&newIds](uint32_t id) { return id < newIds.size() ? newIds[id] : UINT32_MAX; };
+    std::lock_guard<std::mutex> lock(mutex);
+    trackId = renumber(trackId);
+    nextTrackId = renumber(nextTrackId);
+    pendingTrackId = renumber(pendingTrackId);
+}
+
+sf::Time PlaybackEngine::getDuration() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return duration;
+}
+
+sf::Time PlaybackEngine::getPlayingOffset() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    sf::Time offset = sf::SoundStream::getPlayingOffset() - trackStart;
+    return std::max(sf::Time::Zero, std::min(offset, duration));
+}
+
+void PlaybackEngine::setPlayingOffset(sf::Time offset) {
+    // SFML stops the stream and joins its thread first: one waiting in onGetData for a stalled
+    // decoder is let go like in stop(), so a seek never waits on the disk
+    abortWait = true;
+    {
+        std::lock_guard<std::mutex> lock(dataMutex);
+        dataReady.notify_all();
+    }
+    skipRewind = true;  // only the seek to `offset` is done; the skipped rewind clears abortWait
+    sf::SoundStream::setPlayingOffset(offset);  // onSeek() takes it as relative to the audible track
+    skipRewind = false;
+    abortWait = false;
+}
+
+unsigned int PlaybackEngine::splicedTransitions() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return spliced;
+}
+
+unsigned int PlaybackEngine::underranTransitions() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return transitionUnderruns;
+}
+
+sf::Time PlaybackEngine::bufferedAhead() const {
+    return samplesToTime(ring.size(), sampleRate, channelCount);
+}
+
+sf::Time PlaybackEngine::bufferCapacity() const {
+    return samplesToTime(ring.capacity(), sampleRate, channelCount);
+}
+
+unsigned int PlaybackEngine::bufferUnderruns() const {
+    return underrunCount;
+}
+
+// Consumer: SFML's streaming thread only ever copies out of the ring
+bool PlaybackEngine::onGetData(Chunk& data) {
+    data.samples = chunk.data();
+    data.sampleCount = 0;
+    while (true) {
+        size_t got = ring.pop(chunk.data(), chunk.size());
+        if (got > 0) {
+            starving = false;
+            decodeWake.notify_one();
+            data.sampleCount = got;
+            return true;
+        }
+        if (streamDone.load()) {
+            if (ring.size() > 0) {
+                continue;  // the last block landed between pop() and the flag
+            }
+            if (onStreamEvent) {
+                onStreamEvent();
+            }
+            return false;
+        }
+        if (abortWait.load()) {
+            return false;
+        }
+        if (!starving) {
+            starving = true;
+            ++underrunCount;  // the decoder fell behind: whatever OpenAL still holds is all there is
+        }
+        std::unique_lock<std::mutex> lock(dataMutex);
+        dataReady.wait_for(lock, WAIT_SLICE);
+    }
+}
+
+// Pre-decoded samples of a spliced track first, then its decoder
+size_t PlaybackEngine::fill(sf::Int16* out, size_t count) {
+    size_t filled = 0;
+    if (carryPos < carry.size()) {
+        filled = std::min(count, carry.size() - carryPos);
+        std::memcpy(out, carry.data() + carryPos, filled * sizeof(sf::Int16));
+        carryPos += filled;
+    }
+    if (filled < count) {
+        filled += static_cast<size_t>(decoder.file->read(out + filled, count - filled));
+    }
+    decodedInTrack += filled;
+    applyGain(out, filled);
+    return filled;
+}
+
+// Normalization happens here, per track, so a splice switches gain on the exact sample
+void PlaybackEngine::applyGain(sf::Int16* samples, size_t count) const {
+    float gain = decoder.gain;
+    if (gain == 1.f) {
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        float value = samples[i] * gain;
+        samples[i] = static_cast<sf::Int16>(std::max(-32768.f, std::min(32767.f, value)));
+    }
+}
+
+// Producer step, decodeMutex held and at least one block of space in the ring
+void PlaybackEngine::decodeBlock() {
+    size_t got = fill(block.data(), block.size());
+
+    uint64_t total = decoder.sampleCount;
+    uint64_t remaining = total > decodedInTrack ? total - decodedInTrack : 0;
+    if (remaining <= static_cast<uint64_t>(PRELOAD_SECONDS * sampleRate) * channelCount) {
+        requestPreload();
+    }
+
+    if (got < block.size()) {
+        // Current track exhausted: continue with the next one inside this very block. While it
+        // still loads, decodeLoop() waits for it and comes back here
+        Splice splice = spliceNext(got);
+        if (splice == Splice::Done) {
+            got += fill(block.data() + got, block.size() - got);
+        } else if (splice == Splice::Ended) {
+            decoding = false;
+        }
+    }
+    ring.push(block.data(), got);
+    streamSamples += got;
+    if (!decoding) {
+        streamDone = true;
+    }
+    std::lock_guard<std::mutex> lock(dataMutex);
+    dataReady.notify_one();
+}
+
+// What SFML pulls right after play(): three buffers, decoded before the stream starts
+void PlaybackEngine::prefill() {
+    while (decoding && !awaitingSplice && ring.size() < chunk.size() * 3 && ring.space() >= block.size()) {
+        decodeBlock();
+    }
+}
+
+void PlaybackEngine::decodeLoop() {
+    std::unique_lock<std::mutex> lock(decodeMutex);
+    while (!quitting) {
+        if (previous && !transitionPending()) {
+            previous.reset();  // the splice was heard, the old track cannot come back
+        }
+        if (!decoding || ring.space() < block.size()) {
+            decodeWake.wait_for(lock, DECODE_IDLE_SLICE);
+            continue;
+        }
+        if (awaitingSplice) {
+            std::chrono::steady_clock::time_point deadline = spliceDeadline;
+            lock.unlock();
+            {
+                std::unique_lock<std::mutex> wait(mutex);
+                preloadDone.wait_until(wait, deadline, [this]() { return preloader.ready() || quitting || !awaitingSplice; });
+            }
+            lock.lock();
+            if (!awaitingSplice || !decoding || ring.space() < block.size()) {
+                continue;  // a new track or a seek came in meanwhile, or the ring is full
+            }
+        }
+        decodeBlock();
+    }
+}
+
+void PlaybackEngine::requestPreload() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (preloadRequested || nextPath.empty()) {
+        return;
+    }
+    preloadRequested = true;
+    preloader.request(nextPath, nextTrackId);
+}
+
+// Never blocks: Waiting while the preload is in flight and SPLICE_GRACE has not run out
+PlaybackEngine::Splice PlaybackEngine::spliceNext(size_t samplesThisBlock) {
+    requestPreload();  // a track shorter than the preload window, or a late setNext()
+    std::unique_lock<std::mutex> lock(mutex);
+    if (nextPath.empty() || pending) {
+        awaitingSplice = false;
+        return Splice::Ended;
+    }
+    if (!preloader.ready() && !quitting) {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!awaitingSplice) {
+            awaitingSplice = true;
+            spliceDeadline = now + SPLICE_GRACE;
+        }
+        if (now < spliceDeadline) {
+            return Splice::Waiting;
+        }
+    }
+    awaitingSplice = false;
+    LoadedTrack next;
+    if (!preloader.take(next)) {
+        ++transitionUnderruns;  // the next track was not decoded in time, the output runs dry
+        return Splice::Ended;
+    }
+    if (!next.file || next.file->getChannelCount() != channelCount || next.file->getSampleRate() != sampleRate) {
+        nextPath.clear();
+        return Splice::Ended;  // unreadable, or a different format: the caller restarts the stream
+    }
+
+    previous = std::move(decoder);
+    decoder.file = std::move(next.file);
+    decoder.stream = std::move(next.stream);
+    decoder.sliced = false;
+    decoder.seekIndex = std::move(next.seekIndex);
+    decoder.path = next.path;
+    decoder.sampleCount = decoder.file->getSampleCount();
+    decoder.duration = decoder.file->getDuration();
+    decoder.gain = nextGain;
+    carry = std::move(next.head);
+    carryPos = 0;
+    decodedInTrack = 0;
+
+    pending = true;
+    pendingStart = samplesToTime(streamSamples + samplesThisBlock, sampleRate, channelCount);
+    pendingTrackId = nextTrackId;
+    pendingDuration = decoder.duration;
+    pendingPath = nextPath;
+    pendingGain = nextGain;
+    nextPath.clear();
+    preloadRequested = false;
+    ++spliced;
+    lock.unlock();
+
+    if (onStreamEvent) {
+        onStreamEvent();  // the main loop ticks quickly until update() sees the boundary
+    }
+    return Splice::Done;
+}
+
+// Positions the decoder and decodedInTrack; decodeMutex held
+void PlaybackEngine::seekDecoder(sf::Time timeOffset) {
+    uint64_t frame = static_cast<uint64_t>(timeOffset.asSeconds() * sampleRate);
+    if (seekWithIndex(frame)) {
+        return;
+    }
+    if (decoder.sliced) {
+        // A slice cannot seek before its start: back to the whole file
+        auto file = std::make_unique<sf::InputSoundFile>();
+        if (file->openFromFile(decoder.path)) {
+            decoder.file = std::move(file);
+            decoder.stream.reset();
+            decoder.sliced = false;
+        }
+    }
+    decoder.file->seek(timeOffset);
+    decodedInTrack = frame * channelCount;
+}
+
+// The decoder would walk every frame up to the target (VBR mp3 without a TOC); with a seek
+// index a new decoder starts at the indexed frame boundary just before it instead, and only
+// the samples from that boundary to the target are decoded and dropped. A track decoding from
+// cached bytes walks its frames in memory, which is quick enough
+bool PlaybackEngine::seekWithIndex(uint64_t frame) {
+    uint64_t byteOffset;
+    uint64_t startFrame;
+    if ((decoder.stream && !decoder.sliced) || !decoder.seekIndex || decoder.seekIndex->sampleRate != sampleRate || !decoder.seekIndex->lookup(frame, byteOffset, startFrame)) {
+        return false;
+    }
+    auto stream = std::make_unique<FileSliceStream>();
+    auto file = std::make_unique<sf::InputSoundFile>();
+    if (!stream->open(decoder.path, byteOffset) || !file->openFromStream(*stream) ||
+        file->getChannelCount() != channelCount || file->getSampleRate() != sampleRate) {
+        return false;
+    }
+    uint64_t position = startFrame * channelCount;
+    uint64_t target = frame * channelCount;
+    while (position < target) {
+        size_t want = static_cast<size_t>(std::min<uint64_t>(block.size(), target - position));
+        size_t got = static_cast<size_t>(file->read(block.data(), want));
+        if (got == 0) {
+            break;
+        }
+        position += got;
+    }
+    decoder.file = std::move(file);
+    decoder.stream = std::move(stream);
+    decoder.sliced = true;
+    decodedInTrack = position;
+    return true;
+}
+
+// Runs with the streaming thread stopped; the ring restarts at the new position.
+// sf::SoundStream::stop() rewinds through here too: stop() and setPlayingOffset() skip that
+void PlaybackEngine::onSeek(sf::Time timeOffset) {
+    if (skipRewind.exchange(false)) {
+        // The rewind of SFML's stop(): its streaming thread is joined by now, so the one a
+        // seek relaunches right after must wait for data again rather than give up
+        abortWait = false;
+        return;
+    }
+    std::lock_guard<std::mutex> decodeLock(decodeMutex);
+    if (!decoder) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending) {
+            // The splice was never heard: back to the audible track, the next one is queued again
+            decoder = std::move(previous);
+            nextPath = pendingPath;
+            nextTrackId = pendingTrackId;
+            nextGain = pendingGain;
+            preloadRequested = false;
+            preloader.cancel();
+            pending = false;
+        }
+        trackStart = sf::Time::Zero;
+        awaitingSplice = false;
+        preloadDone.notify_all();
+    }
+    previous.reset();
+    carry.clear();
+    carryPos = 0;
+    seekDecoder(std::max(sf::Time::Zero, std::min(timeOffset, decoder.duration)));
+    streamSamples = decodedInTrack;
+
+    ring.clear();
+    streamDone = false;
+    starving = false;
+    decoding = true;
+    prefill();
+    decodeWake.notify_one();
+}
@@ -0,0 +1,411 @@
+#include "../searchIndex.hpp"
+#include <algorithm>
+#include <cctype>
+#include <queue>
+#include <unordered_map>
+
+static const char CONTEXT_SEPARATOR = '|';  // never produced by foldSearchText
+static const size_t MAX_FIELD_LENGTH = 255;   // folded name / context kept per entry
+static const size_t LETTER_RESULT_LIMIT = 256; // precomputed results per one-letter query
+
+// Ranking: per query word, then for the whole entry
+static const int PREFIX_IN_NAME = 300;
+static const int PREFIX_IN_CONTEXT = 100;
+static const int INSIDE_NAME = 50;
+static const int NAME_STARTS_WITH_QUERY = 2000;
+static const int NAME_IS_QUERY = 4000;
+static const int INSIDE_WORD_TIER = -100000;  // below every entry whose words all matched as prefixes
+
+// U+00C0 - U+00FF and U+0100 - U+017F without their diacritics; '?' entries are spelled
+// with two letters (ae, th, ss, ij, oe) and handled before the table
+static const char LATIN_1_LETTERS[] =
+    "aaaaaa?ceeeeiiiidnooooo ouuuuy??"
+    "aaaaaa?ceeeeiiiidnooooo ouuuuy?y";
+static const char LATIN_EXTENDED_A_LETTERS[] =
+    "aaaaaaccccccccddddeeeeeeeeeegggggggghhhhiiiiiiiiii??jjkkkllllllllll"
+    "nnnnnnnnnoooooo??rrrrrrssssssssttttttuuuuuuuuuuuuwwyyyzzzzzzs";
+static_assert(sizeof(LATIN_1_LETTERS) == 64 + 1, "one letter per code point");
+static_assert(sizeof(LATIN_EXTENDED_A_LETTERS) == 128 + 1, "one letter per code point");
+
+static void appendSpace(std::string& folded) {
+    if (!folded.empty() && folded.back() != ' ') {
+        folded.push_back(' ');
+    }
+}
+
+// Appends the folded form of a two-byte code point; false when it is not a Latin one
+static bool foldLatin(uint32_t codePoint, std::string& folded) {
+    switch (codePoint) {
+        case 0xC6: case 0xE6: folded += "ae"; return true;
+        case 0xDE: case 0xFE: folded += "th"; return true;
+        case 0xDF: folded += "ss"; return true;
+        case 0x132: case 0x133: folded += "ij"; return true;
+        case 0x152: case 0x153: folded += "oe"; return true;
+    }
+    char letter;
+    if (codePoint >= 0x80 && codePoint < 0xC0) {
+        letter = ' ';  // no-break space, quotes, currency and other Latin-1 punctuation
+    } else if (codePoint >= 0xC0 && codePoint < 0x100) {
+        letter = LATIN_1_LETTERS[codePoint - 0xC0];
+    } else if (codePoint >= 0x100 && codePoint < 0x180) {
+        letter = LATIN_EXTENDED_A_LETTERS[codePoint - 0x100];
+    } else if (codePoint >= 0x300 && codePoint < 0x370) {
+        return true;  // combining accent of a decomposed letter: the base letter already went in
+    } else {
+        return false;
+    }
+    if (letter == ' ') {
+        appendSpace(folded);
+    } else {
+        folded.push_back(letter);
+    }
+    return true;
+}
+
+std::string foldSearchText(const std::string& text) {
+    std::string folded;
+    folded.reserve(text.size());
+    for (size_t i = 0; i < text.size();) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c < 0x80) {
+            if (std::isalnum(c)) {
+                folded.push_back(static_cast<char>(std::tolower(c)));
+            } else {
+                appendSpace(folded);
+            }
+            ++i;
+            continue;
+        }
+        if ((c & 0xE0) == 0xC0 && i + 1 < text.size() && (static_cast<unsigned char>(text[i + 1]) & 0xC0) == 0x80) {
+            uint32_t codePoint = ((c & 0x1Fu) << 6) | (static_cast<unsigned char>(text[i + 1]) & 0x3Fu);
+            if (foldLatin(codePoint, folded)) {
+                i += 2;
+                continue;
+            }
+        }
+        if (c == 0xE2 && i + 2 < text.size() && (static_cast<unsigned char>(text[i + 1]) & 0xFE) == 0x80 &&
+            (static_cast<unsigned char>(text[i + 2]) & 0xC0) == 0x80) {
+            appendSpace(folded);  // U+2000 - U+207F: dashes, curly quotes, ellipsis and other punctuation
+            i += 3;
+            continue;
+        }
+        folded.push_back(static_cast<char>(c));
+        ++i;
+    }
+    if (!folded.empty() && folded.back() == ' ') {
+        folded.pop_back();
+    }
+    return folded;
+}
+
+static uint32_t trigramKey(const char* bytes) {
+    return (static_cast<uint32_t>(static_cast<unsigned char>(bytes[0])) << 16) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(bytes[1])) << 8) |
+           static_cast<uint32_t>(static_cast<unsigned char>(bytes[2]));
+}
+
+// Calls visit(offset, length) for every word of a folded text
+template <typename Visit>
+static void forEachWord(const std::string& text, Visit visit) {
+    size_t start = 0;
+    for (size_t i = 0; i <= text.size(); ++i) {
+        if (i == text.size() || text[i] == ' ' || text[i] == CONTEXT_SEPARATOR) {
+            if (i > start) {
+                visit(start, i - start);
+            }
+            start = i + 1;
+        }
+    }
+}
+
+// First occurrence of token at the start of a word of text, npos if none
+static size_t findWordStart(const std::string& text, const std::string& token) {
+    for (size_t at = text.find(token); at != std::string::npos; at = text.find(token, at + 1)) {
+        if (at == 0 || text[at - 1] == ' ' || text[at - 1] == CONTEXT_SEPARATOR) {
+            return at;
+        }
+    }
+    return std::string::npos;
+}
+
+void SearchIndex::clear() {
+    documents.clear();
+    words.clear();
+    gramKeys.clear();
+    gramStarts.clear();
+    postings.clear();
+    letterResults.clear();
+    slots.clear();
+}
+
+void SearchIndex::build(const Library& library) {
+    clear();
+    documents.reserve(library.artistCount() + library.albumCount() + library.trackCount());
+    for (uint32_t id = 0; id < library.artistCount(); ++id) {
+        add(SearchKind::Artist, id, library.artist(id).name, "");
+    }
+    for (uint32_t id = 0; id < library.albumCount(); ++id) {
+        const LibraryAlbum& album = library.album(id);
+        add(SearchKind::Album, id, album.name, library.artist(album.artist).name);
+    }
+    for (uint32_t id = 0; id < library.trackCount(); ++id) {
+        const LibraryTrack& track = library.track(id);
+        add(SearchKind::Track, id, track.title, library.trackArtist(id) + " " + library.album(track.album).name);
+    }
+    finish();
+}
+
+void SearchIndex::add(SearchKind kind, uint32_t id, const std::string& primary, const std::string& context) {
+    Document document{kind, id, 0, foldSearchText(primary).substr(0, MAX_FIELD_LENGTH)};
+    document.primaryLength = static_cast<uint32_t>(document.text.size());
+    document.text += CONTEXT_SEPARATOR;
+    document.text += foldSearchText(context).substr(0, MAX_FIELD_LENGTH);
+    documents.push_back(std::move(document));
+}
+
+void SearchIndex::finish() {
+    // Documents are visited in id order, so every posting list comes out ascending
+    std::unordered_map<uint32_t, std::vector<uint32_t>> grams;
+    for (uint32_t documentId = 0; documentId < documents.size(); ++documentId) {
+        const Document& document = documents[documentId];
+        forEachWord(document.text, [&](size_t offset, size_t length) {
+            words.push_back({documentId, static_cast<uint16_t>(offset), static_cast<uint16_t>(length),
+                             static_cast<uint16_t>(document.primaryLength), document.kind});
+            for (size_t i = offset; i + 3 <= offset + length; ++i) {
+                std::vector<uint32_t>& list = grams[trigramKey(&document.text[i])];
+                if (list.empty() || list.back() != documentId) {
+                    list.push_back(documentId);
+                }
+            }
+        });
+    }
+
+    gramKeys.reserve(grams.size());
+    for (const auto& gram : grams) {
+        gramKeys.push_back(gram.first);
+    }
+    std::sort(gramKeys.begin(), gramKeys.end());
+    gramStarts.reserve(gramKeys.size() + 1);
+    for (uint32_t key : gramKeys) {
+        const std::vector<uint32_t>& list = grams[key];
+        gramStarts.push_back(static_cast<uint32_t>(postings.size()));
+        postings.insert(postings.end(), list.begin(), list.end());
+    }
+    gramStarts.push_back(static_cast<uint32_t>(postings.size()));
+
+    // Sorted on the first eight bytes packed big-endian (zero padded, so a shorter word still
+    // sorts first); only words sharing all eight compare their whole text, which also orders
+    // a word of eight bytes or fewer before the longer words it starts
+    std::vector<std::pair<uint64_t, Word>> keyed;
+    keyed.reserve(words.size());
+    for (const Word& word : words) {
+        std::string_view text = wordText(word);
+        uint64_t key = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            key = (key << 8) | (i < text.size() ? static_cast<unsigned char>(text[i]) : 0u);
+        }
+        keyed.push_back({key, word});
+    }
+    std::sort(keyed.begin(), keyed.end(), [this](const std::pair<uint64_t, Word>& a, const std::pair<uint64_t, Word>& b) {
+        if (a.first != b.first) {
+            return a.first < b.first;
+        }
+        return wordText(a.second) < wordText(b.second);  // "stranger" < "strangers" < "strangerz"
+    });
+    for (size_t i = 0; i < keyed.size(); ++i) {
+        words[i] = keyed[i].second;
+    }
+    slots.assign(documents.size(), Slot{0, 0});
+    stamp = 0;
+
+    std::vector<std::vector<SearchResult>> letters(128);
+    for (char c = '0'; c <= 'z'; ++c) {
+        if (std::isalnum(static_cast<unsigned char>(c)) && !std::isupper(static_cast<unsigned char>(c))) {
+            letters[static_cast<size_t>(c)] = search(std::string(1, c), LETTER_RESULT_LIMIT);
+        }
+    }
+    letterResults = std::move(letters);
+}
+
+std::pair<size_t, size_t> SearchIndex::prefixRange(const std::string& prefix) const {
+    auto first = std::lower_bound(words.begin(), words.end(), prefix, [this](const Word& word, const std::string& value) {
+        return wordText(word) < value;
+    });
+    auto last = std::upper_bound(first, words.end(), prefix, [this](const std::string& value, const Word& word) {
+        return value < wordText(word).substr(0, value.size());
+    });
+    return {static_cast<size_t>(first - words.begin()), static_cast<size_t>(last - words.begin())};
+}
+
+static int kindBonus(SearchKind kind) {
+    return kind == SearchKind::Artist ? 60 : kind == SearchKind::Album ? 30 : 0;
+}
+
+static int lengthPenalty(uint32_t primaryLength) {
+    return -static_cast<int>(primaryLength);  // shorter names are closer matches
+}
+
+std::vector<SearchResult> SearchIndex::search(const std::string& query, size_t limit) const {
+    std::vector<SearchResult> results;
+    std::string folded = foldSearchText(query);
+    std::vector<std::string> tokens;
+    forEachWord(folded, [&](size_t offset, size_t length) { tokens.push_back(folded.substr(offset, length)); });
+    if (tokens.empty() || limit == 0 || documents.empty()) {
+        return results;
+    }
+    if (tokens.size() == 1 && tokens[0].size() == 1 && !letterResults.empty() && static_cast<unsigned char>(tokens[0][0]) < 128) {
+        const std::vector<SearchResult>& cached = letterResults[static_cast<unsigned char>(tokens[0][0])];
+        if (limit <= cached.size() || cached.size() < LETTER_RESULT_LIMIT) {  // the latter: every match is there
+            return std::vector<SearchResult>(cached.begin(), cached.begin() + std::min(limit, cached.size()));
+        }
+    }
+    std::string phrase;
+    for (const std::string& token : tokens) {
+        phrase += phrase.empty() ? token : " " + token;
+    }
+    auto nameBonus = [&phrase](const Document& document) {
+        if (phrase.size() > document.primaryLength || document.text.compare(0, phrase.size(), phrase) != 0) {
+            return 0;
+        }
+        return document.primaryLength == phrase.size() ? NAME_IS_QUERY : NAME_STARTS_WITH_QUERY;
+    };
+
+    // Best `limit` so far, the worst of them on top
+    using Ranked = std::pair<int, uint32_t>;  // (score, document)
+    auto worse = [](const Ranked& a, const Ranked& b) { return a.first != b.first ? a.first > b.first : a.second < b.second; };
+    std::priority_queue<Ranked, std::vector<Ranked>, decltype(worse)> best(worse);
+    auto offer = [&](int score, uint32_t documentId) {
+        if (best.size() < limit) {
+            best.push({score, documentId});
+        } else if (worse(Ranked{score, documentId}, best.top())) {
+            best.pop();
+            best.push({score, documentId});
+        }
+    };
+
+    if (++stamp == 0) {
+        std::fill(slots.begin(), slots.end(), Slot{0, 0});
+        stamp = 1;
+    }
+
+    // Tier 1: every query word starts a word. The narrowest prefix range drives, scored from
+    // the word entries alone (completely, for a one-word query); the other query words are
+    // checked on the entries it yields
+    std::vector<std::pair<size_t, size_t>> ranges;
+    size_t driver = 0;
+    for (size_t t = 0; t < tokens.size(); ++t) {
+        ranges.push_back(prefixRange(tokens[t]));
+        if (ranges[t].second - ranges[t].first < ranges[driver].second - ranges[driver].first) {
+            driver = t;
+        }
+    }
+    std::vector<uint32_t> matched;
+    for (size_t w = ranges[driver].first; w < ranges[driver].second; ++w) {
+        const Word& word = words[w];
+        int score = word.offset < word.primaryLength ? PREFIX_IN_NAME : PREFIX_IN_CONTEXT;
+        if (tokens.size() == 1) {
+            if (word.offset == 0 && word.primaryLength > 0) {
+                score += word.primaryLength == phrase.size() ? NAME_IS_QUERY : NAME_STARTS_WITH_QUERY;
+            }
+            score += kindBonus(word.kind) + lengthPenalty(word.primaryLength);
+        }
+        Slot& slot = slots[word.document];
+        if (slot.stamp != stamp) {
+            slot = {stamp, score};
+            matched.push_back(word.document);
+        } else if (score > slot.score) {
+            slot.score = score;
+        }
+    }
+    for (uint32_t documentId : matched) {
+        if (tokens.size() == 1) {
+            offer(slots[documentId].score, documentId);
+            continue;
+        }
+        const Document& document = documents[documentId];
+        int score = slots[documentId].score;
+        bool matches = true;
+        for (size_t t = 0; t < tokens.size() && matches; ++t) {
+            if (t != driver) {
+                size_t at = findWordStart(document.text, tokens[t]);
+                matches = at != std::string::npos;
+                score += at < document.primaryLength ? PREFIX_IN_NAME : PREFIX_IN_CONTEXT;
+            }
+        }
+        if (matches) {
+            offer(score + nameBonus(document) + kindBonus(document.kind) + lengthPenalty(document.primaryLength), documentId);
+        }
+    }
+
+    // Tier 2, only while the results are not full: words of three letters or more found inside
+    // a word, candidates from the trigram lists (smallest first, the others only filter it)
+    bool infixPossible = std::any_of(tokens.begin(), tokens.end(), [](const std::string& token) { return token.size() >= 3; });
+    if (best.size() < limit && infixPossible) {
+        struct Span {
+            const uint32_t* first;
+            const uint32_t* last;
+        };
+        std::vector<Span> spans;
+        for (const std::string& token : tokens) {
+            for (size_t i = 0; i + 3 <= token.size(); ++i) {
+                uint32_t key = trigramKey(&token[i]);
+                auto found = std::lower_bound(gramKeys.begin(), gramKeys.end(), key);
+                if (found == gramKeys.end() || *found != key) {
+                    spans.clear();
+                    break;
+                }
+                size_t slot = static_cast<size_t>(found - gramKeys.begin());
+                spans.push_back({postings.data() + gramStarts[slot], postings.data() + gramStarts[slot + 1]});
+            }
+            if (spans.empty() && token.size() >= 3) {
+                break;  // a trigram nobody has: nothing contains this word
+            }
+        }
+        std::vector<uint32_t> candidates;
+        if (!spans.empty()) {
+            std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) { return a.last - a.first < b.last - b.first; });
+            candidates.assign(spans[0].first, spans[0].last);
+            for (size_t s = 1; s < spans.size() && !candidates.empty(); ++s) {
+                const uint32_t* cursor = spans[s].first;
+                size_t kept = 0;
+                for (uint32_t documentId : candidates) {
+                    cursor = std::lower_bound(cursor, spans[s].last, documentId);
+                    if (cursor == spans[s].last) {
+                        break;
+                    }
+                    if (*cursor == documentId) {
+                        candidates[kept++] = documentId;
+                    }
+                }
+                candidates.resize(kept);
+            }
+        }
+        for (uint32_t documentId : candidates) {
+            const Document& document = documents[documentId];
+            int score = INSIDE_WORD_TIER;
+            bool allPrefixes = true;
+            bool matches = true;
+            for (size_t t = 0; t < tokens.size() && matches; ++t) {
+                size_t at = findWordStart(document.text, tokens[t]);
+                if (at != std::string::npos) {
+                    score += at < document.primaryLength ? PREFIX_IN_NAME : PREFIX_IN_CONTEXT;
+                    continue;
+                }
+                allPrefixes = false;
+                at = tokens[t].size() >= 3 ? document.text.find(tokens[t]) : std::string::npos;  // short words only count at a word start
+                matches = at != std::string::npos;
+                score += at < document.primaryLength ? INSIDE_NAME : 0;
+            }
+            if (matches && !allPrefixes) {  // all-prefix entries are tier 1's
+                offer(score + kindBonus(document.kind) + lengthPenalty(document.primaryLength), documentId);
+            }
+        }
+    }
+
+    results.resize(best.size());
+    for (size_t i = results.size(); i-- > 0; best.pop()) {
+        const Document& document = documents[best.top().second];
+        results[i] = {document.kind, document.id};
+    }
+    return results;
+}
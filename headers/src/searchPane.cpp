@@ -0,0 +1,201 @@
+#include "../searchPane.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include "../compositor.hpp"
+
+static const size_t RESULT_LIMIT = 200;
+static const int QUERY_LINE = 1;  // between the title border and the first result row
+
+void SearchPane::indexLibrary(const Library& newLibrary, const std::string& lyricsIndexPath) {
+    forgetLibrary();
+    library = &newLibrary;
+    lyrics.open(lyricsIndexPath);
+    building = std::async(std::launch::async, [this]() {
+        index.build(*library);
+        // lyrics.idx is only rewritten when lyrics change, its tracks find theirs by inode
+        lyricsTracks.assign(lyrics.isOpen() ? lyrics.trackCount() : 0, INDEX_NOT_FOUND);
+        if (!lyricsTracks.empty()) {
+            std::unordered_map<uint64_t, uint32_t> idByInode;
+            idByInode.reserve(library->trackCount());
+            for (uint32_t id = 0; id < library->trackCount(); ++id) {
+                idByInode.emplace(library->track(id).inode, id);
+            }
+            for (uint32_t track = 0; track < lyricsTracks.size(); ++track) {
+                auto found = idByInode.find(lyrics.trackInode(track));
+                if (found != idByInode.end()) {
+                    lyricsTracks[track] = found->second;
+                }
+            }
+        }
+    });
+}
+
+void SearchPane::forgetLibrary() {
+    if (building.valid()) {
+        building.get();
+    }
+    close();
+    index.clear();
+    lyrics.close();
+    lyricsTracks.clear();
+    library = nullptr;
+}
+
+void SearchPane::open() {
+    if (win || !library) {
+        return;
+    }
+    win = newwin(1, 1, 0, 0);
+    place();
+    list.attach(win);
+    query.clear();
+    runQuery();
+}
+
+void SearchPane::close() {
+    if (!win) {
+        return;
+    }
+    compositorForget(win);
+    delwin(win);
+    win = nullptr;
+    list.attach(nullptr);
+    results.clear();
+    occurrences.clear();
+    markAllDirty();
+}
+
+// Centered over the menus, clear of the status bar
+void SearchPane::place() {
+    int height = LINES * 2 / 3;
+    int width = COLS * 2 / 3;
+    height = height < 6 ? 6 : height;
+    width = width < 30 ? 30 : width;
+    wresize(win, height, width);
+    mvwin(win, (LINES - height) / 3, (COLS - width) / 2);
+}
+
+void SearchPane::resize() {
+    if (win) {
+        place();
+        draw();
+    }
+}
+
+void SearchPane::runQuery() {
+    if (building.valid()) {
+        building.get();  // typed within the first moments of the session: the build is nearly done
+    }
+    auto started = std::chrono::steady_clock::now();
+    occurrences.clear();
+    if (!searchingLyrics) {
+        results = index.search(query, RESULT_LIMIT);
+    } else {
+        results.clear();
+        if (lyrics.isOpen()) {
+            for (const LyricsMatch& match : lyrics.findPhrase(query, RESULT_LIMIT)) {
+                // lyrics of a file the library no longer holds stay out
+                if (lyricsTracks[match.track] != INDEX_NOT_FOUND) {
+                    results.push_back({SearchKind::Track, lyricsTracks[match.track]});
+                    occurrences.push_back(match.occurrences);
+                }
+            }
+        }
+    }
+    queryMicros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count();
+
+    const Library& shown = *library;
+    const std::vector<SearchResult>& rows = results;
+    const std::vector<uint32_t>& counts = occurrences;
+    ListView::RowSource source;
+    source.text = [&shown, &rows, &counts](size_t row, std::string& text) {
+        const SearchResult& result = rows[row];
+        if (result.kind == SearchKind::Artist) {
+            text += "artist  ";
+            text += shown.artist(result.id).name;
+        } else if (result.kind == SearchKind::Album) {
+            const LibraryAlbum& album = shown.album(result.id);
+            text += "album   ";
+            text += album.name;
+            text += " - ";
+            text += shown.artist(album.artist).name;
+            text += " (";
+            text += album.year;
+            text += ')';
+        } else {
+            const LibraryTrack& track = shown.track(result.id);
+            text += "song    ";
+            text += track.title;
+            text += " - ";
+            text += shown.trackArtist(result.id);
+            text += "  ";
+            if (counts.empty()) {
+                text += track.duration;
+            } else {
+                char occurrences[24];
+                int length = snprintf(occurrences, sizeof(occurrences), "(%ux)", counts[row]);
+                text.append(occurrences, static_cast<size_t>(length));
+            }
+        }
+    };
+    list.setRows(rows.size(), std::move(source));
+}
+
+bool SearchPane::handleKey(int ch) {
+    if (ch == '\n' || ch == KEY_ENTER) {
+        return !results.empty();
+    } else if (ch == 27) {  // escape
+        close();
+    } else if (ch == '\t') {
+        searchingLyrics = !searchingLyrics;
+        runQuery();
+    } else if (ch == KEY_DOWN) {
+        list.moveDown();
+    } else if (ch == KEY_UP) {
+        list.moveUp();
+    } else if (ch == KEY_BACKSPACE || ch == 127 || ch == 8) {
+        // A whole UTF-8 character: continuation bytes first, then its lead byte
+        while (!query.empty() && (static_cast<unsigned char>(query.back()) & 0xC0) == 0x80) {
+            query.pop_back();
+        }
+        if (!query.empty()) {
+            query.pop_back();
+        }
+        runQuery();
+    } else if (ch >= 32 && ch < 256 && ch != 127) {  // printable ASCII and the bytes of UTF-8 input
+        query.push_back(static_cast<char>(ch));
+        runQuery();
+    }
+    return false;
+}
+
+SearchResult SearchPane::picked() const {
+    return results[list.cursor()];
+}
+
+void SearchPane::draw() {
+    if (!win) {
+        return;
+    }
+    werase(win);
+    box(win, 0, 0);
+    mvwprintw(win, 0, 2, searchingLyrics ? " Search lyrics (Tab: library) " : " Search (Tab: lyrics) ");
+    char summary[64];
+    if (searchingLyrics && !lyrics.isOpen()) {
+        snprintf(summary, sizeof(summary), " no lyrics index ");
+    } else {
+        snprintf(summary, sizeof(summary), " %zu%s in %.2f ms ", results.size(), results.size() == RESULT_LIMIT ? "+" : "", queryMicros / 1000.0);
+    }
+    int summaryX = getmaxx(win) - 2 - static_cast<int>(strlen(summary));
+    wattron(win, COLOR_PAIR(3));
+    mvwprintw(win, QUERY_LINE, 2, "> %.*s_", summaryX > 6 ? summaryX - 6 : 0, query.c_str());
+    wattroff(win, COLOR_PAIR(3));
+    if (summaryX > 2) {
+        mvwaddstr(win, QUERY_LINE, summaryX, summary);
+    }
+    list.draw();
+    touchwin(win);  // the whole overlay, the panels below may have been repainted over it
+    markDirty(win);
+}
@@ -0,0 +1,169 @@
+#include "../seekIndex.hpp"
+#include "../audioHeaders.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool SeekIndex::lookup(uint64_t frame, uint64_t& byteOffset, uint64_t& startFrame) const {
+    if (offsets.empty() || samplesPerFrame == 0 || framesPerEntry == 0) {
+        return false;
+    }
+    uint64_t samplesPerEntry = static_cast<uint64_t>(samplesPerFrame) * framesPerEntry;
+    size_t entry = static_cast<size_t>(std::min<uint64_t>(frame / samplesPerEntry, offsets.size() - 1));
+    byteOffset = offsets[entry];
+    startFrame = entry * samplesPerEntry;
+    return true;
+}
+
+std::string seekIndexPath(const std::string& seekIndexDir, uint64_t inode) {
+    return seekIndexDir + std::to_string(inode) + ".seek";
+}
+
+bool isMp3Path(const std::string& path) {
+    if (path.size() < 4) {
+        return false;
+    }
+    std::string extension = path.substr(path.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extension == ".mp3";
+}
+
+static bool readHeader(const std::string& indexPath, std::ifstream& in, SeekIndexHeader& header) {
+    in.open(indexPath, std::ios::binary);
+    return in.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+           memcmp(header.magic, SEEK_INDEX_MAGIC, sizeof(SEEK_INDEX_MAGIC)) == 0 && header.version == SEEK_INDEX_VERSION;
+}
+
+static bool matchesFile(const SeekIndexHeader& header, const struct stat& st) {
+    return header.fileSize == static_cast<uint64_t>(st.st_size) && header.mtime == static_cast<int64_t>(st.st_mtime);
+}
+
+bool seekIndexFresh(const std::string& mp3Path, const std::string& indexPath) {
+    struct stat st;
+    std::ifstream in;
+    SeekIndexHeader header;
+    return stat(mp3Path.c_str(), &st) == 0 && readHeader(indexPath, in, header) && matchesFile(header, st);
+}
+
+// Runs on the cache workers; a file whose frames change sample rate midway gets no table
+bool buildSeekIndex(const std::string& mp3Path, const std::string& indexPath) {
+    struct stat st;
+    if (stat(mp3Path.c_str(), &st) != 0 || static_cast<uint64_t>(st.st_size) > UINT32_MAX) {
+        return false;
+    }
+    SeekIndexHeader header{};
+    memcpy(header.magic, SEEK_INDEX_MAGIC, sizeof(header.magic));
+    header.version = SEEK_INDEX_VERSION;
+    header.fileSize = static_cast<uint64_t>(st.st_size);
+    header.mtime = static_cast<int64_t>(st.st_mtime);
+
+    std::vector<uint32_t> offsets;
+    uint64_t frameNumber = 0;
+    bool consistent = true;
+    bool found = walkMp3Frames(mp3Path, [&](uint64_t offset, uint32_t samples, uint32_t sampleRate) {
+        if (frameNumber == 0) {
+            header.sampleRate = sampleRate;
+            header.samplesPerFrame = samples;
+            header.framesPerEntry = std::max<uint32_t>(1, sampleRate / samples);  // about a second
+        } else if (sampleRate != header.sampleRate || samples != header.samplesPerFrame) {
+            consistent = false;
+        }
+        if (frameNumber % header.framesPerEntry == 0) {
+            offsets.push_back(static_cast<uint32_t>(offset));
+        }
+        ++frameNumber;
+    });
+    if (!found || !consistent || offsets.empty()) {
+        return false;
+    }
+    header.entryCount = static_cast<uint32_t>(offsets.size());
+
+    // Written to a temporary file and renamed, so playback never reads half a table
+    const std::string tempPath = indexPath + ".tmp";
+    std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint32_t));
+    out.close();
+    if (!out || std::rename(tempPath.c_str(), indexPath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::shared_ptr<const SeekIndex> loadSeekIndex(const std::string& mp3Path, const std::string& seekIndexDir) {
+    struct stat st;
+    if (seekIndexDir.empty() || !isMp3Path(mp3Path) || stat(mp3Path.c_str(), &st) != 0) {
+        return nullptr;
+    }
+    std::ifstream in;
+    SeekIndexHeader header;
+    if (!readHeader(seekIndexPath(seekIndexDir, static_cast<uint64_t>(st.st_ino)), in, header) || !matchesFile(header, st) ||
+        header.entryCount == 0 || header.entryCount > header.fileSize || header.samplesPerFrame == 0) {
+        return nullptr;
+    }
+    auto index = std::make_shared<SeekIndex>();
+    index->sampleRate = header.sampleRate;
+    index->samplesPerFrame = header.samplesPerFrame;
+    index->framesPerEntry = header.framesPerEntry;
+    index->offsets.resize(header.entryCount);
+    if (!in.read(reinterpret_cast<char*>(index->offsets.data()), index->offsets.size() * sizeof(uint32_t))) {
+        return nullptr;
+    }
+    return index;
+}
+
+FileSliceStream::~FileSliceStream() {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool FileSliceStream::open(const std::string& path, uint64_t start) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || start > static_cast<uint64_t>(st.st_size)) {
+        return false;
+    }
+    sliceStart = start;
+    sliceSize = static_cast<uint64_t>(st.st_size) - start;
+    position = 0;
+    return true;
+}
+
+sf::Int64 FileSliceStream::read(void* data, sf::Int64 size) {
+    if (fd < 0 || size < 0) {
+        return -1;
+    }
+    uint64_t count = std::min<uint64_t>(static_cast<uint64_t>(size), sliceSize - position);
+    ssize_t got = pread(fd, data, count, static_cast<off_t>(sliceStart + position));
+    if (got < 0) {
+        return -1;
+    }
+    position += static_cast<uint64_t>(got);
+    return got;
+}
+
+sf::Int64 FileSliceStream::seek(sf::Int64 target) {
+    if (target < 0) {
+        return -1;
+    }
+    position = std::min<uint64_t>(static_cast<uint64_t>(target), sliceSize);
+    return static_cast<sf::Int64>(position);
+}
+
+sf::Int64 FileSliceStream::tell() {
+    return static_cast<sf::Int64>(position);
+}
+
+sf::Int64 FileSliceStream::getSize() {
+    return static_cast<sf::Int64>(sliceSize);
+}
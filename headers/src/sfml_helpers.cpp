@@ -1,38 +1,71 @@
 #include "../sfml_helpers.hpp"
 
-void playMusic(sf::Music& music, const std::string& songPath) {
-    if (music.getStatus() == sf::Music::Playing) {
-        music.stop();
+// Opening happens on the loader thread; the main loop starts the song once it is loaded
+void playMusic(TrackLoader& loader, const std::string& songPath, uint32_t trackId) {
+    loader.request(songPath, trackId);
+}
+
+// Called when the loader signalled: starts the newest finished load, false if none was waiting
+bool startLoadedSong(PlaybackEngine& music, TrackLoader& loader, const Library& library, const PlayQueue& queue, NormalizeMode normalize) {
+    LoadedTrack loaded;
+    if (!loader.take(loaded)) {
+        return false;
     }
-    if (!music.openFromFile(songPath)) {
+    if (!music.start(loaded, songGain(library, loaded.trackId, normalize, queue.shuffled()))) {
         std::cerr << "Error loading file" << std::endl;
-    } else {
-        music.play();
+        return true;  // stays stopped, the main loop moves on to the next song
+    }
+    queueNextSong(music, library, queue, normalize);
+    return true;
+}
+
+// The track after the queue's current one is what the engine splices in when this one ends;
+// called again whenever the queue changes under a playing track
+void queueNextSong(PlaybackEngine& music, const Library& library, const PlayQueue& queue, NormalizeMode normalize) {
+    uint32_t trackId = queue.peekNext();
+    if (trackId == INDEX_NOT_FOUND) {
+        music.setNext(std::string(), trackId);
+        return;
+    }
+    music.setNext(library.track(trackId).path, trackId, songGain(library, trackId, normalize, queue.shuffled()));
+}
+
+// Gain of the normalization stage for one track; the user's volume still applies on top of it.
+// Album gain keeps the quiet and loud songs of an album apart, as mastered
+float songGain(const Library& library, uint32_t trackId, NormalizeMode normalize, bool shuffled) {
+    if (normalize == NormalizeMode::Off) {
+        return 1.f;
+    }
+    const LibraryTrack& track = library.track(trackId);
+    const LibraryAlbum& album = library.album(track.album);
+    bool albumGain = normalize == NormalizeMode::Album || (normalize == NormalizeMode::Auto && !shuffled);
+    if (albumGain && !std::isnan(album.loudness)) {
+        return normalizationGain(album.loudness, album.peak);
     }
+    return normalizationGain(track.loudness, track.peak);
 }
 
-void nextSong(sf::Music& music, const std::vector<std::string>& songs, int& currentSongIndex) {
-    music.stop();
-    currentSongIndex = (currentSongIndex + 1) % songs.size();
-    std::string nextSongPath = songs[currentSongIndex];
-    playMusic(music, nextSongPath);    
+// Both return the track id asked for, resolved straight from the library
+uint32_t nextSong(TrackLoader& loader, const Library& library, PlayQueue& queue) {
+    uint32_t trackId = queue.advance();
+    playMusic(loader, library.track(trackId).path, trackId);
+    return trackId;
 }
 
-void previousSong(sf::Music& music, const std::vector<std::string>& songs, int& currentSongIndex) {
-    music.stop();
-    currentSongIndex = (currentSongIndex - 1 + songs.size()) % songs.size();
-    std::string prevSongPath = songs[currentSongIndex];
-    playMusic(music, prevSongPath);
+uint32_t previousSong(TrackLoader& loader, const Library& library, PlayQueue& queue) {
+    uint32_t trackId = queue.retreat();
+    playMusic(loader, library.track(trackId).path, trackId);
+    return trackId;
 }
 
-void adjustVolume(sf::Music& music, float volumeChange) {
+void adjustVolume(PlaybackEngine& music, float volumeChange) {
     float currentVolume = music.getVolume();
     currentVolume += volumeChange;
     currentVolume = std::max(0.f, std::min(100.f, currentVolume));
     music.setVolume(currentVolume);
 }
 
-void toggleMute(sf::Music& music, bool isMuted) {
+void toggleMute(PlaybackEngine& music, bool isMuted) {
   if (!isMuted) {
     adjustVolume(music, -100.f);
   } else {
@@ -40,7 +73,7 @@ void toggleMute(sf::Music& music, bool isMuted) {
   }
 }
 
-void seekSong(sf::Music& music, int seekVal, bool forward) {
+void seekSong(PlaybackEngine& music, int seekVal, bool forward) {
   if (forward) {
     music.setPlayingOffset(music.getPlayingOffset() + sf::seconds(seekVal));
   } else {
@@ -51,20 +84,3 @@ void seekSong(sf::Music& music, int seekVal, bool forward) {
     }
   }
 }
-
-std::string getSongDuration(const std::string& songPath) {
-    sf::Music music;
-    if (!music.openFromFile(songPath)) {
-        return "00:00";
-    }
-    sf::Time duration = music.getDuration();
-    int seconds = static_cast<int>(duration.asSeconds());
-    int minutes = seconds / 60;
-    seconds %= 60;
-    char buffer[6];
-    snprintf(buffer, sizeof(buffer), "%02d:%02d", minutes, seconds);
-    return std::string(buffer);
-}
-
-
-
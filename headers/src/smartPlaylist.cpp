@@ -0,0 +1,487 @@
+#include "../smartPlaylist.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <nlohmann/json.hpp>
+#include "../searchIndex.hpp"
+
+using json = nlohmann::json;
+
+static const int MAX_QUERY_DEPTH = 64;  // nested parentheses / NOTs, so a hostile file cannot exhaust the stack
+
+enum class TokenKind { Word, String, Number, Operator, Open, Close, End };
+
+struct Token {
+    TokenKind kind;
+    std::string text;  // word, string contents, number or operator as written
+    size_t position;
+};
+
+static bool tokenize(const std::string& text, std::vector<Token>& tokens, std::string& error) {
+    size_t i = 0;
+    while (i < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        size_t start = i;
+        if (isspace(c)) {
+            ++i;
+        } else if (c == '(' || c == ')') {
+            tokens.push_back({c == '(' ? TokenKind::Open : TokenKind::Close, std::string(1, static_cast<char>(c)), start});
+            ++i;
+        } else if (c == '"') {
+            std::string value;
+            for (++i; i < text.size() && text[i] != '"'; ++i) {
+                if (text[i] == '\\' && i + 1 < text.size()) {
+                    ++i;  // \" and \\ stand for the character itself
+                }
+                value.push_back(text[i]);
+            }
+            if (i == text.size()) {
+                error = "unterminated string at " + std::to_string(start + 1);
+                return false;
+            }
+            ++i;
+            tokens.push_back({TokenKind::String, value, start});
+        } else if (isdigit(c)) {
+            while (i < text.size() && (isdigit(static_cast<unsigned char>(text[i])) || text[i] == ':')) {
+                ++i;
+            }
+            tokens.push_back({TokenKind::Number, text.substr(start, i - start), start});
+        } else if (isalpha(c) || c == '_') {
+            while (i < text.size() && (isalnum(static_cast<unsigned char>(text[i])) || text[i] == '_')) {
+                ++i;
+            }
+            tokens.push_back({TokenKind::Word, text.substr(start, i - start), start});
+        } else if (strchr("=!<>~", c) != nullptr) {
+            ++i;
+            if (i < text.size() && (text[i] == '=' || (c == '!' && text[i] == '~'))) {
+                ++i;
+            }
+            tokens.push_back({TokenKind::Operator, text.substr(start, i - start), start});
+        } else {
+            error = "unexpected '" + std::string(1, static_cast<char>(c)) + "' at " + std::to_string(start + 1);
+            return false;
+        }
+    }
+    tokens.push_back({TokenKind::End, "", text.size()});
+    return true;
+}
+
+static std::string lowerCase(const std::string& text) {
+    std::string lower = text;
+    for (char& c : lower) {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return lower;
+}
+
+// "1960" -> 1960, "4:30" -> 270 (minutes allowed only where `clock` is)
+static bool parseNumber(const std::string& text, bool clock, uint32_t& number) {
+    size_t colon = text.find(':');
+    if (colon != std::string::npos && (!clock || colon == 0 || text.size() - colon != 3 || text.find(':', colon + 1) != std::string::npos)) {
+        return false;
+    }
+    if (text.size() > 9) {
+        return false;
+    }
+    if (colon == std::string::npos) {
+        number = static_cast<uint32_t>(std::stoul(text));
+        return true;
+    }
+    uint32_t seconds = static_cast<uint32_t>(std::stoul(text.substr(colon + 1)));
+    if (seconds >= 60) {
+        return false;
+    }
+    number = static_cast<uint32_t>(std::stoul(text.substr(0, colon))) * 60 + seconds;
+    return true;
+}
+
+// Recursive descent straight into the postfix program
+class QueryParser {
+public:
+    QueryParser(const std::vector<Token>& tokens, SmartQuery& query) : tokens(tokens), query(query) {}
+
+    bool parse(std::string& error) {
+        if (!parseOr(0)) {
+            error = this->error;
+            return false;
+        }
+        if (peek().kind != TokenKind::End) {
+            error = "expected AND, OR or the end of the query at " + std::to_string(peek().position + 1);
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const Token& peek() const { return tokens[next]; }
+    bool keyword(const char* word) const { return peek().kind == TokenKind::Word && lowerCase(peek().text) == word; }
+
+    bool fail(const std::string& what) {
+        error = what + " at " + std::to_string(peek().position + 1);
+        return false;
+    }
+
+    bool parseOr(int depth) {
+        if (!parseAnd(depth)) {
+            return false;
+        }
+        while (keyword("or")) {
+            ++next;
+            if (!parseAnd(depth)) {
+                return false;
+            }
+            query.program.push_back({QueryStep::Or, 0});
+        }
+        return true;
+    }
+
+    bool parseAnd(int depth) {
+        if (!parseNot(depth)) {
+            return false;
+        }
+        while (keyword("and")) {
+            ++next;
+            if (!parseNot(depth)) {
+                return false;
+            }
+            query.program.push_back({QueryStep::And, 0});
+        }
+        return true;
+    }
+
+    bool parseNot(int depth) {
+        if (depth >= MAX_QUERY_DEPTH) {
+            return fail("query nested too deep");
+        }
+        if (keyword("not")) {
+            ++next;
+            if (!parseNot(depth + 1)) {
+                return false;
+            }
+            query.program.push_back({QueryStep::Not, 0});
+            return true;
+        }
+        if (peek().kind == TokenKind::Open) {
+            ++next;
+            if (!parseOr(depth + 1)) {
+                return false;
+            }
+            if (peek().kind != TokenKind::Close) {
+                return fail("expected ')'");
+            }
+            ++next;
+            return true;
+        }
+        return parsePredicate();
+    }
+
+    bool parsePredicate() {
+        static const std::pair<const char*, QueryField> FIELDS[] = {
+            {"artist", QueryField::Artist}, {"album", QueryField::Album}, {"genre", QueryField::Genre},
+            {"title", QueryField::Title},   {"year", QueryField::Year},   {"duration", QueryField::Duration},
+        };
+        static const std::pair<const char*, QueryOp> OPERATORS[] = {
+            {"=", QueryOp::Equal},  {"!=", QueryOp::NotEqual},    {"<", QueryOp::Less},     {"<=", QueryOp::LessEqual},
+            {">", QueryOp::Greater}, {">=", QueryOp::GreaterEqual}, {"~", QueryOp::Contains}, {"!~", QueryOp::NotContains},
+        };
+        QueryPredicate predicate{QueryField::Artist, QueryOp::Equal, "", 0};
+
+        auto field = std::find_if(std::begin(FIELDS), std::end(FIELDS), [this](const std::pair<const char*, QueryField>& f) { return keyword(f.first); });
+        if (field == std::end(FIELDS)) {
+            return fail("expected a field (artist, album, genre, title, year or duration)");
+        }
+        predicate.field = field->second;
+        ++next;
+
+        auto op = std::find_if(std::begin(OPERATORS), std::end(OPERATORS), [this](const std::pair<const char*, QueryOp>& o) {
+            return peek().kind == TokenKind::Operator && peek().text == o.first;
+        });
+        if (op == std::end(OPERATORS)) {
+            return fail("expected an operator");
+        }
+        predicate.op = op->second;
+        bool numeric = predicate.field == QueryField::Year || predicate.field == QueryField::Duration;
+        bool ordering = predicate.op != QueryOp::Equal && predicate.op != QueryOp::NotEqual;
+        bool containment = predicate.op == QueryOp::Contains || predicate.op == QueryOp::NotContains;
+        if (numeric ? containment : ordering && !containment) {
+            return fail(std::string(numeric ? "~ and !~ compare text" : "<, <=, > and >= compare numbers") + ", not " + field->first);
+        }
+        ++next;
+
+        if (numeric) {
+            if (peek().kind != TokenKind::Number || !parseNumber(peek().text, predicate.field == QueryField::Duration, predicate.number)) {
+                return fail(predicate.field == QueryField::Duration ? "expected seconds or m:ss" : "expected a year");
+            }
+        } else {
+            if (peek().kind != TokenKind::String) {
+                return fail("expected a quoted string");
+            }
+            predicate.text = foldSearchText(peek().text);
+        }
+        ++next;
+
+        query.program.push_back({QueryStep::Predicate, static_cast<uint32_t>(query.predicates.size())});
+        query.predicates.push_back(std::move(predicate));
+        return true;
+    }
+
+    const std::vector<Token>& tokens;
+    SmartQuery& query;
+    size_t next = 0;
+    std::string error;
+};
+
+bool parseSmartQuery(const std::string& text, SmartQuery& query, std::string& error) {
+    query = {};
+    std::vector<Token> tokens;
+    if (!tokenize(text, tokens, error)) {
+        return false;
+    }
+    if (tokens.size() == 1) {
+        error = "empty query";
+        return false;
+    }
+    QueryParser parser(tokens, query);
+    if (!parser.parse(error)) {
+        query = {};
+        return false;
+    }
+    return true;
+}
+
+void TrackTable::TextColumn::clear() {
+    text.clear();
+    starts.assign(1, 0);
+}
+
+void TrackTable::TextColumn::add(const std::string& value) {
+    text += value;
+    text.push_back('\0');
+    starts.push_back(static_cast<uint32_t>(text.size()));
+}
+
+void TrackTable::TextColumn::match(const QueryPredicate& predicate, uint8_t* matches) const {
+    size_t count = starts.size() - 1;
+    const std::string& needle = predicate.text;
+    if (predicate.op == QueryOp::Equal || predicate.op == QueryOp::NotEqual) {
+        for (size_t i = 0; i < count; ++i) {
+            matches[i] = starts[i + 1] - 1 - starts[i] == needle.size() && memcmp(text.data() + starts[i], needle.data(), needle.size()) == 0;
+        }
+    } else if (needle.empty()) {
+        std::fill(matches, matches + count, 1);
+    } else {
+        // One memmem scan over the whole column; the '\0' after each entry keeps a hit inside
+        // one entry, and the rest of an entry that matched is skipped
+        std::fill(matches, matches + count, 0);
+        const char* begin = text.data();
+        const char* end = begin + text.size();
+        size_t entry = 0;
+        for (const char* from = begin; from < end;) {
+            const char* hit = static_cast<const char*>(memmem(from, static_cast<size_t>(end - from), needle.data(), needle.size()));
+            if (hit == nullptr) {
+                break;
+            }
+            while (starts[entry + 1] <= static_cast<uint32_t>(hit - begin)) {
+                ++entry;
+            }
+            matches[entry] = 1;
+            from = begin + starts[entry + 1];
+        }
+    }
+    if (predicate.op == QueryOp::NotEqual || predicate.op == QueryOp::NotContains) {
+        for (size_t i = 0; i < count; ++i) {
+            matches[i] ^= 1;
+        }
+    }
+}
+
+void TrackTable::build(const Library& library, bool withTitles) {
+    trackCount = library.trackCount();
+    artists.resize(trackCount);
+    albums.resize(trackCount);
+    genres.resize(trackCount);
+    years.resize(trackCount);
+    durations.resize(trackCount);
+    titles.clear();
+    for (uint32_t id = 0; id < trackCount; ++id) {
+        const LibraryTrack& track = library.track(id);
+        artists[id] = track.artist;
+        albums[id] = track.album;
+        genres[id] = library.trackGenreId(id);
+        years[id] = library.trackYear(id);
+        durations[id] = track.durationMs / 1000;
+        if (withTitles) {
+            titles.add(foldSearchText(track.title));
+        }
+    }
+    artistNames.clear();
+    for (uint32_t id = 0; id < library.artistCount(); ++id) {
+        artistNames.add(foldSearchText(library.artist(id).name));
+    }
+    albumNames.clear();
+    for (uint32_t id = 0; id < library.albumCount(); ++id) {
+        albumNames.add(foldSearchText(library.album(id).name));
+    }
+    genreNames.clear();
+    for (uint32_t id = 0; id < library.genreCount(); ++id) {
+        genreNames.add(foldSearchText(library.genreName(id)));
+    }
+}
+
+// matches[i] = value[i] is known and passes; no branches in the loop, so it vectorizes
+template <typename Compare>
+static void compareColumn(const std::vector<uint32_t>& column, uint8_t* matches, Compare compare) {
+    const uint32_t* values = column.data();
+    for (size_t i = 0; i < column.size(); ++i) {
+        matches[i] = static_cast<uint8_t>((values[i] != 0) & compare(values[i]));
+    }
+}
+
+// matches[i] = answers[column[i]]: a text predicate decided per dictionary entry, spread to the tracks
+static void lookupColumn(const std::vector<uint32_t>& column, const std::vector<uint8_t>& answers, uint8_t* matches) {
+    const uint32_t* values = column.data();
+    const uint8_t* table = answers.data();
+    for (size_t i = 0; i < column.size(); ++i) {
+        matches[i] = table[values[i]];
+    }
+}
+
+void TrackTable::evaluatePredicate(const QueryPredicate& predicate, uint8_t* matches, std::vector<uint8_t>& scratch) const {
+    const TextColumn* dictionary = nullptr;
+    const std::vector<uint32_t>* column = nullptr;
+    switch (predicate.field) {
+        case QueryField::Artist: dictionary = &artistNames; column = &artists; break;
+        case QueryField::Album: dictionary = &albumNames; column = &albums; break;
+        case QueryField::Genre: dictionary = &genreNames; column = &genres; break;
+        case QueryField::Title:
+            if (titles.starts.size() - 1 == trackCount) {
+                titles.match(predicate, matches);
+            } else {
+                std::fill(matches, matches + trackCount, 0);
+            }
+            return;
+        case QueryField::Year: column = &years; break;
+        case QueryField::Duration: column = &durations; break;
+    }
+    if (dictionary != nullptr) {
+        scratch.resize(dictionary->starts.size() - 1);
+        dictionary->match(predicate, scratch.data());
+        lookupColumn(*column, scratch, matches);
+        return;
+    }
+    uint32_t value = predicate.number;
+    switch (predicate.op) {
+        case QueryOp::Equal: compareColumn(*column, matches, [value](uint32_t v) { return v == value; }); break;
+        case QueryOp::NotEqual: compareColumn(*column, matches, [value](uint32_t v) { return v != value; }); break;
+        case QueryOp::Less: compareColumn(*column, matches, [value](uint32_t v) { return v < value; }); break;
+        case QueryOp::LessEqual: compareColumn(*column, matches, [value](uint32_t v) { return v <= value; }); break;
+        case QueryOp::Greater: compareColumn(*column, matches, [value](uint32_t v) { return v > value; }); break;
+        case QueryOp::GreaterEqual: compareColumn(*column, matches, [value](uint32_t v) { return v >= value; }); break;
+        default: std::fill(matches, matches + trackCount, 0); break;  // refused by the parser
+    }
+}
+
+std::vector<uint32_t> TrackTable::evaluate(const SmartQuery& query) const {
+    std::vector<std::vector<uint8_t>> masks;  // the program's stack, a mask per level
+    std::vector<uint8_t> scratch;
+    size_t depth = 0;
+    for (const QueryInstruction& instruction : query.program) {
+        if (instruction.step == QueryStep::Predicate) {
+            if (depth == masks.size()) {
+                masks.emplace_back(trackCount);
+            }
+            evaluatePredicate(query.predicates[instruction.predicate], masks[depth].data(), scratch);
+            ++depth;
+        } else if (instruction.step == QueryStep::Not) {
+            if (depth < 1) {
+                return {};
+            }
+            uint8_t* top = masks[depth - 1].data();
+            for (uint32_t i = 0; i < trackCount; ++i) {
+                top[i] ^= 1;
+            }
+        } else {
+            if (depth < 2) {
+                return {};
+            }
+            uint8_t* left = masks[depth - 2].data();
+            const uint8_t* right = masks[depth - 1].data();
+            if (instruction.step == QueryStep::And) {
+                for (uint32_t i = 0; i < trackCount; ++i) {
+                    left[i] &= right[i];
+                }
+            } else {
+                for (uint32_t i = 0; i < trackCount; ++i) {
+                    left[i] |= right[i];
+                }
+            }
+            --depth;
+        }
+    }
+    if (depth != 1) {
+        return {};
+    }
+    const uint8_t* result = masks[0].data();
+    std::vector<uint32_t> ids;
+    ids.reserve(static_cast<size_t>(std::count(result, result + trackCount, 1)));
+    for (uint32_t i = 0; i < trackCount; ++i) {
+        if (result[i]) {
+            ids.push_back(i);
+        }
+    }
+    return ids;
+}
+
+bool loadSmartPlaylists(const std::string& path, std::vector<SmartPlaylist>& playlists, std::string& error) {
+    playlists.clear();
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        return true;
+    }
+    try {
+        json entries;
+        file >> entries;
+        if (!entries.is_array()) {
+            error = path + " should hold an array of {\"name\", \"query\"} objects";
+            return false;
+        }
+        for (const auto& entry : entries) {
+            if (!entry.is_object() || !entry.contains("name") || !entry["name"].is_string() || !entry.contains("query") || !entry["query"].is_string()) {
+                error = "every playlist in " + path + " needs a \"name\" and a \"query\" string";
+                playlists.clear();
+                return false;
+            }
+            SmartPlaylist playlist;
+            playlist.name = entry["name"].get<std::string>();
+            playlist.text = entry["query"].get<std::string>();
+            parseSmartQuery(playlist.text, playlist.query, playlist.error);
+            playlists.push_back(std::move(playlist));
+        }
+    } catch (const json::exception& e) {
+        error = "JSON parse error in " + path + ": " + e.what();
+        playlists.clear();
+        return false;
+    }
+    return true;
+}
+
+void applySmartPlaylists(Library& library, const std::vector<SmartPlaylist>& playlists) {
+    bool withTitles = false;
+    for (const SmartPlaylist& playlist : playlists) {
+        for (const QueryPredicate& predicate : playlist.query.predicates) {
+            withTitles = withTitles || predicate.field == QueryField::Title;
+        }
+    }
+    TrackTable table;
+    if (!playlists.empty()) {
+        table.build(library, withTitles);
+    }
+    std::vector<std::string> names;
+    std::vector<std::vector<uint32_t>> matches;
+    for (const SmartPlaylist& playlist : playlists) {
+        names.push_back(playlist.name);
+        matches.push_back(playlist.error.empty() ? table.evaluate(playlist.query) : std::vector<uint32_t>());
+    }
+    library.setPlaylists(names, matches);
+}
@@ -0,0 +1,423 @@
+#include "../tagReader.hpp"
+#include "../fileWindow.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+// Lyrics can be long, cover art frames are never read at all
+static const size_t maxFrameSize = 4 * 1024 * 1024;
+// Upper bound for blocks we have to read whole (v2.3 unsynchronised tags, vorbis comment blocks)
+static const size_t maxBlockSize = 16 * 1024 * 1024;
+
+// ID3v1 genre list, referenced by numeric TCON values such as "(17)" or "17"
+static const char* id3v1Genres[] = {
+    "Blues", "Classic Rock", "Country", "Dance", "Disco", "Funk", "Grunge", "Hip-Hop",
+    "Jazz", "Metal", "New Age", "Oldies", "Other", "Pop", "R&B", "Rap",
+    "Reggae", "Rock", "Techno", "Industrial", "Alternative", "Ska", "Death Metal", "Pranks",
+    "Soundtrack", "Euro-Techno", "Ambient", "Trip-Hop", "Vocal", "Jazz+Funk", "Fusion", "Trance",
+    "Classical", "Instrumental", "Acid", "House", "Game", "Sound Clip", "Gospel", "Noise",
+    "AlternRock", "Bass", "Soul", "Punk", "Space", "Meditative", "Instrumental Pop", "Instrumental Rock",
+    "Ethnic", "Gothic", "Darkwave", "Techno-Industrial", "Electronic", "Pop-Folk", "Eurodance", "Dream",
+    "Southern Rock", "Comedy", "Cult", "Gangsta", "Top 40", "Christian Rap", "Pop/Funk", "Jungle",
+    "Native American", "Cabaret", "New Wave", "Psychadelic", "Rave", "Showtunes", "Trailer", "Lo-Fi",
+    "Tribal", "Acid Punk", "Acid Jazz", "Polka", "Retro", "Musical", "Rock & Roll", "Hard Rock",
+};
+static const int id3v1GenreCount = sizeof(id3v1Genres) / sizeof(id3v1Genres[0]);
+
+static uint32_t readBE32(const std::string& b, size_t pos) {
+    return (static_cast<uint32_t>(static_cast<uint8_t>(b[pos])) << 24) | (static_cast<uint32_t>(static_cast<uint8_t>(b[pos + 1])) << 16) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(b[pos + 2])) << 8) | static_cast<uint32_t>(static_cast<uint8_t>(b[pos + 3]));
+}
+
+static uint32_t readBE24(const std::string& b, size_t pos) {
+    return (static_cast<uint32_t>(static_cast<uint8_t>(b[pos])) << 16) | (static_cast<uint32_t>(static_cast<uint8_t>(b[pos + 1])) << 8) |
+           static_cast<uint32_t>(static_cast<uint8_t>(b[pos + 2]));
+}
+
+static uint32_t readLE32(const std::string& b, size_t pos) {
+    return static_cast<uint32_t>(static_cast<uint8_t>(b[pos])) | (static_cast<uint32_t>(static_cast<uint8_t>(b[pos + 1])) << 8) |
+           (static_cast<uint32_t>(static_cast<uint8_t>(b[pos + 2])) << 16) | (static_cast<uint32_t>(static_cast<uint8_t>(b[pos + 3])) << 24);
+}
+
+static uint32_t readSynchsafe32(const std::string& b, size_t pos) {
+    return ((static_cast<uint32_t>(b[pos]) & 0x7f) << 21) | ((static_cast<uint32_t>(b[pos + 1]) & 0x7f) << 14) |
+           ((static_cast<uint32_t>(b[pos + 2]) & 0x7f) << 7) | (static_cast<uint32_t>(b[pos + 3]) & 0x7f);
+}
+
+static std::string toLowerKey(std::string key) {
+    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return std::tolower(c); });
+    return key;
+}
+
+static void appendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+// Length of the first string in data (up to, not including, its terminator)
+static size_t id3StringLength(uint8_t encoding, const char* data, size_t len) {
+    if (encoding == 1 || encoding == 2) {
+        for (size_t i = 0; i + 1 < len; i += 2) {
+            if (data[i] == 0 && data[i + 1] == 0) {
+                return i;
+            }
+        }
+        return len;
+    }
+    const void* nul = memchr(data, 0, len);
+    return nul ? static_cast<size_t>(static_cast<const char*>(nul) - data) : len;
+}
+
+static size_t id3TerminatorWidth(uint8_t encoding) {
+    return (encoding == 1 || encoding == 2) ? 2 : 1;
+}
+
+// Decodes the first string of an ID3v2 text field to UTF-8
+static std::string decodeId3String(uint8_t encoding, const char* data, size_t len) {
+    len = id3StringLength(encoding, data, len);
+    std::string out;
+    if (encoding == 0) {
+        for (size_t i = 0; i < len; ++i) {
+            appendUtf8(out, static_cast<uint8_t>(data[i]));
+        }
+    } else if (encoding == 1 || encoding == 2) {
+        bool bigEndian = (encoding == 2);
+        size_t i = 0;
+        if (len >= 2) {
+            uint8_t b0 = static_cast<uint8_t>(data[0]), b1 = static_cast<uint8_t>(data[1]);
+            if (b0 == 0xFF && b1 == 0xFE) { bigEndian = false; i = 2; }
+            else if (b0 == 0xFE && b1 == 0xFF) { bigEndian = true; i = 2; }
+        }
+        for (; i + 1 < len; i += 2) {
+            uint32_t unit = bigEndian ? (static_cast<uint8_t>(data[i]) << 8) | static_cast<uint8_t>(data[i + 1])
+                                      : (static_cast<uint8_t>(data[i + 1]) << 8) | static_cast<uint8_t>(data[i]);
+            if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < len) {
+                uint32_t low = bigEndian ? (static_cast<uint8_t>(data[i + 2]) << 8) | static_cast<uint8_t>(data[i + 3])
+                                         : (static_cast<uint8_t>(data[i + 3]) << 8) | static_cast<uint8_t>(data[i + 2]);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    appendUtf8(out, 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+                    i += 2;
+                    continue;
+                }
+            }
+            appendUtf8(out, unit);
+        }
+    } else {
+        out.assign(data, len);
+    }
+    return out;
+}
+
+static void removeUnsynchronisation(std::string& data) {
+    size_t out = 0;
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[out++] = data[i];
+        if (static_cast<uint8_t>(data[i]) == 0xFF && i + 1 < data.size() && data[i + 1] == 0) {
+            i++;
+        }
+    }
+    data.resize(out);
+}
+
+// ffprobe keeps the first value of a repeated ID3 frame, and joins repeated vorbis comments with ';'
+static void setTag(TagMap& tags, const std::string& key, const std::string& value, bool joinRepeats) {
+    if (value.empty()) {
+        return;
+    }
+    auto it = tags.find(key);
+    if (it == tags.end()) {
+        tags[key] = value;
+    } else if (joinRepeats) {
+        it->second += ";" + value;
+    }
+}
+
+static const char* id3FrameKey(const std::string& id) {
+    if (id == "TPE1" || id == "TP1") return "artist";
+    if (id == "TALB" || id == "TAL") return "album";
+    if (id == "TIT2" || id == "TT2") return "title";
+    if (id == "TPOS" || id == "TPA") return "disc";
+    if (id == "TRCK" || id == "TRK") return "track";
+    if (id == "TCON" || id == "TCO") return "genre";
+    if (id == "TDRC" || id == "TYER" || id == "TYE") return "date";
+    if (id == "USLT" || id == "ULT") return "lyrics";
+    return nullptr;
+}
+
+static std::string resolveGenre(const std::string& genre) {
+    int number = -1;
+    if (sscanf(genre.c_str(), "(%d)", &number) == 1 || sscanf(genre.c_str(), "%d", &number) == 1) {
+        if (number >= 0 && number < id3v1GenreCount) {
+            return id3v1Genres[number];
+        }
+    }
+    return genre;
+}
+
+static void storeId3Frame(const char* key, const std::string& body, TagMap& tags) {
+    if (body.empty()) {
+        return;
+    }
+    uint8_t encoding = static_cast<uint8_t>(body[0]);
+    if (strcmp(key, "lyrics") == 0) {
+        // USLT: encoding, 3 byte language, content descriptor, text
+        if (body.size() < 4) {
+            return;
+        }
+        std::string language = toLowerKey(body.substr(1, 3));
+        const char* rest = body.data() + 4;
+        size_t restLen = body.size() - 4;
+        size_t descLen = id3StringLength(encoding, rest, restLen);
+        std::string descriptor = decodeId3String(encoding, rest, descLen);
+        size_t textStart = std::min(restLen, descLen + id3TerminatorWidth(encoding));
+        std::string lyricsKey = "lyrics-" + (descriptor.empty() ? "" : toLowerKey(descriptor) + "-") + language;
+        setTag(tags, lyricsKey, decodeId3String(encoding, rest + textStart, restLen - textStart), false);
+        return;
+    }
+    std::string value = decodeId3String(encoding, body.data() + 1, body.size() - 1);
+    if (strcmp(key, "genre") == 0) {
+        value = resolveGenre(value);
+    }
+    setTag(tags, key, value, false);
+}
+
+// Reads frames either through the file window or, for whole-tag unsynchronisation, from memory
+struct Id3Source {
+    const FileWindow& file;
+    uint64_t base;
+    const std::string* memory;
+
+    bool read(uint64_t offset, size_t len, std::string& out) const {
+        if (memory) {
+            if (offset + len > memory->size()) {
+                return false;
+            }
+            out.assign(*memory, static_cast<size_t>(offset), len);
+            return true;
+        }
+        return file.read(base + offset, len, out);
+    }
+};
+
+// Parses an ID3v2 tag starting at base, returns the offset just past the tag (0 when there is none)
+static uint64_t parseId3v2(const FileWindow& file, uint64_t base, TagMap& tags) {
+    std::string header;
+    if (!file.read(base, 10, header) || header.compare(0, 3, "ID3") != 0) {
+        return 0;
+    }
+    uint8_t major = static_cast<uint8_t>(header[3]);
+    uint8_t flags = static_cast<uint8_t>(header[5]);
+    uint64_t tagSize = readSynchsafe32(header, 6);
+    uint64_t tagEnd = base + 10 + tagSize + ((major == 4 && (flags & 0x10)) ? 10 : 0);
+    if (major < 2 || major > 4 || (major == 2 && (flags & 0x40))) {
+        return tagEnd; // unknown version, or v2.2 compression which never got a defined scheme
+    }
+
+    uint64_t frameEnd = std::min<uint64_t>(tagSize, file.size() - std::min<uint64_t>(file.size(), base + 10));
+    std::string wholeTag;
+    Id3Source source{file, base + 10, nullptr};
+    if ((flags & 0x80) && major < 4) {
+        if (frameEnd > maxBlockSize || !file.read(base + 10, static_cast<size_t>(frameEnd), wholeTag)) {
+            return tagEnd;
+        }
+        removeUnsynchronisation(wholeTag);
+        frameEnd = wholeTag.size();
+        source.memory = &wholeTag;
+    }
+
+    uint64_t pos = 0;
+    std::string buf;
+    if (major >= 3 && (flags & 0x40)) {
+        if (!source.read(0, 4, buf)) {
+            return tagEnd;
+        }
+        pos = (major == 3) ? 4 + readBE32(buf, 0) : readSynchsafe32(buf, 0);
+    }
+
+    const size_t headerLen = (major == 2) ? 6 : 10;
+    const size_t idLen = (major == 2) ? 3 : 4;
+    while (pos + headerLen <= frameEnd) {
+        if (!source.read(pos, headerLen, buf) || buf[0] == 0) {
+            break; // padding
+        }
+        std::string id = buf.substr(0, idLen);
+        uint64_t size;
+        uint8_t formatFlags = 0;
+        if (major == 2) {
+            size = readBE24(buf, 3);
+        } else {
+            size = (major == 4) ? readSynchsafe32(buf, 4) : readBE32(buf, 4);
+            formatFlags = static_cast<uint8_t>(buf[9]);
+        }
+        uint64_t bodyPos = pos + headerLen;
+        pos = bodyPos + size;
+        if (pos > frameEnd) {
+            break;
+        }
+
+        const char* key = id3FrameKey(id);
+        if (!key || size == 0 || size > maxFrameSize) {
+            continue;
+        }
+
+        std::string body;
+        if (!source.read(bodyPos, static_cast<size_t>(size), body)) {
+            break;
+        }
+        if (major == 3) {
+            if (formatFlags & 0xC0) {
+                continue; // compressed or encrypted
+            }
+            if (formatFlags & 0x20) {
+                body.erase(0, 1); // grouping identity
+            }
+        } else if (major == 4) {
+            if (formatFlags & 0x0C) {
+                continue; // compressed or encrypted
+            }
+            if (formatFlags & 0x40) {
+                body.erase(0, 1); // grouping identity
+            }
+            if (formatFlags & 0x01) {
+                body.erase(0, std::min<size_t>(4, body.size())); // data length indicator
+            }
+            if ((formatFlags & 0x02) || (flags & 0x80)) {
+                removeUnsynchronisation(body);
+            }
+        }
+        storeId3Frame(key, body, tags);
+    }
+    return tagEnd;
+}
+
+static void parseVorbisComments(const std::string& block, TagMap& tags) {
+    if (block.size() < 8) {
+        return;
+    }
+    size_t pos = 4 + readLE32(block, 0); // skip the vendor string
+    if (pos + 4 > block.size()) {
+        return;
+    }
+    uint32_t count = readLE32(block, pos);
+    pos += 4;
+    for (uint32_t i = 0; i < count && pos + 4 <= block.size(); ++i) {
+        uint32_t len = readLE32(block, pos);
+        pos += 4;
+        if (len > block.size() - pos) {
+            return;
+        }
+        std::string comment = block.substr(pos, len);
+        pos += len;
+        size_t eq = comment.find('=');
+        if (eq == std::string::npos || eq == 0) {
+            continue;
+        }
+        std::string key = toLowerKey(comment.substr(0, eq));
+        if (key == "tracknumber") key = "track";
+        else if (key == "discnumber") key = "disc";
+        else if (key == "albumartist") key = "album_artist";
+        setTag(tags, key, comment.substr(eq + 1), true);
+    }
+}
+
+static void parseFlac(const FileWindow& file, uint64_t pos, TagMap& tags) {
+    pos += 4; // "fLaC"
+    std::string header;
+    for (int blocks = 0; blocks < 1024 && file.read(pos, 4, header); ++blocks) {
+        bool last = static_cast<uint8_t>(header[0]) & 0x80;
+        uint8_t type = static_cast<uint8_t>(header[0]) & 0x7F;
+        uint32_t len = readBE24(header, 1);
+        if (type == 4 && len <= maxBlockSize) {
+            std::string block;
+            if (file.read(pos + 4, len, block)) {
+                parseVorbisComments(block, tags);
+            }
+        }
+        pos += 4 + len;
+        if (last) {
+            break;
+        }
+    }
+}
+
+static const char* riffInfoKey(const std::string& id) {
+    if (id == "IART") return "artist";
+    if (id == "INAM") return "title";
+    if (id == "IPRD") return "album";
+    if (id == "IGNR") return "genre";
+    if (id == "ICRD") return "date";
+    if (id == "ITRK" || id == "IPRT") return "track";
+    return nullptr;
+}
+
+static void parseRiff(const FileWindow& file, TagMap& tags) {
+    uint64_t pos = 12; // "RIFF" size "WAVE"
+    std::string header;
+    for (int chunks = 0; chunks < 256 && file.read(pos, 8, header); ++chunks) {
+        std::string id = header.substr(0, 4);
+        uint32_t len = readLE32(header, 4);
+        if (id == "LIST" && len >= 4 && len <= maxBlockSize) {
+            std::string list;
+            if (file.read(pos + 8, len, list) && list.compare(0, 4, "INFO") == 0) {
+                for (size_t sub = 4; sub + 8 <= list.size();) {
+                    std::string subId = list.substr(sub, 4);
+                    uint32_t subLen = readLE32(list, sub + 4);
+                    if (subLen > list.size() - sub - 8) {
+                        break;
+                    }
+                    const char* key = riffInfoKey(subId);
+                    if (key) {
+                        std::string value = list.substr(sub + 8, subLen);
+                        value.resize(strnlen(value.c_str(), value.size()));
+                        setTag(tags, key, value, false);
+                    }
+                    sub += 8 + subLen + (subLen & 1);
+                }
+            }
+        } else if (id == "id3 " || id == "ID3 ") {
+            parseId3v2(file, pos + 8, tags);
+        }
+        pos += 8 + static_cast<uint64_t>(len) + (len & 1);
+    }
+}
+
+bool readNativeTags(const std::string& filePath, TagMap& tags, std::string& tagSource) {
+    tags.clear();
+    FileWindow file(filePath);
+    std::string magic;
+    if (!file.isOpen() || !file.read(0, 12, magic)) {
+        return false;
+    }
+
+    if (magic.compare(0, 3, "ID3") == 0) {
+        uint64_t tagEnd = parseId3v2(file, 0, tags);
+        tagSource = "ID3v2";
+        std::string flacMagic;
+        if (file.read(tagEnd, 4, flacMagic) && flacMagic == "fLaC") {
+            parseFlac(file, tagEnd, tags);
+            tagSource = "FLAC";
+        }
+    } else if (magic.compare(0, 4, "fLaC") == 0) {
+        parseFlac(file, 0, tags);
+        tagSource = "FLAC";
+    } else if (magic.compare(0, 4, "RIFF") == 0 && magic.compare(8, 4, "WAVE") == 0) {
+        parseRiff(file, tags);
+        tagSource = "RIFF";
+    }
+
+    return !tags.empty();
+}
@@ -0,0 +1,158 @@
+#include "../trackCache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// One file may take at most this share of the budget, so a long mix never flushes the album
+// around it; bigger files are streamed from disk as before
+static const uint64_t MAX_SHARE_OF_BUDGET = 4;
+// Misses waiting to be read in; skipping through the queue should not line up a backlog
+static const size_t MAX_PENDING_FILLS = 4;
+
+TrackCache::TrackCache(uint64_t budgetBytes) : budget(budgetBytes) {
+    if (budget > 0) {
+        filler = std::thread(&TrackCache::fillLoop, this);
+    }
+}
+
+TrackCache::~TrackCache() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quitting = true;
+    }
+    fillWake.notify_all();
+    if (filler.joinable()) {
+        filler.join();
+    }
+}
+
+TrackBytes TrackCache::fetch(const std::string& path) {
+    if (budget == 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return nullptr;
+    }
+    uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+    int64_t mtime = static_cast<int64_t>(st.st_mtime);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = byPath.find(path);
+        if (found != byPath.end()) {
+            Entry& entry = *found->second;
+            if (entry.fileSize == fileSize && entry.mtime == mtime) {
+                ++hits;
+                recency.splice(recency.begin(), recency, found->second);
+                return entry.bytes;
+            }
+            resident -= entry.bytes->size();  // edited since it was cached
+            recency.erase(found->second);
+            byPath.erase(found);
+        }
+        ++misses;
+        if (fileSize == 0 || fileSize > budget / MAX_SHARE_OF_BUDGET) {
+            return nullptr;
+        }
+        if (std::find(pendingFills.begin(), pendingFills.end(), path) == pendingFills.end()) {
+            if (pendingFills.size() == MAX_PENDING_FILLS) {
+                pendingFills.pop_front();
+            }
+            pendingFills.push_back(path);
+            fillWake.notify_one();
+        }
+    }
+    return nullptr;
+}
+
+// Reads missed files in whole, one at a time and without the lock, while their decoders
+// stream the same files from disk
+void TrackCache::fillLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        fillWake.wait(lock, [this]() { return quitting || !pendingFills.empty(); });
+        if (quitting) {
+            return;
+        }
+        std::string path = std::move(pendingFills.front());
+        pendingFills.pop_front();
+        lock.unlock();
+
+        struct stat st;
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0 && fstat(fd, &st) == 0 && st.st_size > 0 && static_cast<uint64_t>(st.st_size) <= budget / MAX_SHARE_OF_BUDGET) {
+            uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+            auto bytes = std::make_shared<std::vector<char>>(fileSize);
+            uint64_t done = 0;
+            while (done < fileSize) {
+                ssize_t got = pread(fd, bytes->data() + done, fileSize - done, static_cast<off_t>(done));
+                if (got <= 0) {
+                    break;
+                }
+                done += static_cast<uint64_t>(got);
+            }
+            if (done == fileSize) {  // else truncated while reading
+                insert(Entry{path, bytes, fileSize, static_cast<int64_t>(st.st_mtime)});
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        lock.lock();
+    }
+}
+
+void TrackCache::insert(Entry entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (byPath.count(entry.path)) {
+        return;  // queued twice and read in twice: the first copy stays
+    }
+    resident += entry.bytes->size();
+    recency.push_front(std::move(entry));
+    byPath[recency.front().path] = recency.begin();
+    // Evicted bytes stay alive for a decoder still reading them, only the cache forgets them
+    while (resident > budget && recency.size() > 1) {
+        resident -= recency.back().bytes->size();
+        byPath.erase(recency.back().path);
+        recency.pop_back();
+    }
+}
+
+TrackCacheStats TrackCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    TrackCacheStats result;
+    result.hits = hits;
+    result.misses = misses;
+    result.residentBytes = resident;
+    result.budgetBytes = budget;
+    result.tracks = recency.size();
+    return result;
+}
+
+sf::Int64 MemoryFileStream::read(void* out, sf::Int64 size) {
+    if (size < 0) {
+        return -1;
+    }
+    uint64_t count = std::min<uint64_t>(static_cast<uint64_t>(size), data->size() - position);
+    memcpy(out, data->data() + position, count);
+    position += count;
+    return static_cast<sf::Int64>(count);
+}
+
+sf::Int64 MemoryFileStream::seek(sf::Int64 target) {
+    if (target < 0) {
+        return -1;
+    }
+    position = std::min<uint64_t>(static_cast<uint64_t>(target), data->size());
+    return static_cast<sf::Int64>(position);
+}
+
+sf::Int64 MemoryFileStream::tell() {
+    return static_cast<sf::Int64>(position);
+}
+
+sf::Int64 MemoryFileStream::getSize() {
+    return static_cast<sf::Int64>(data->size());
+}
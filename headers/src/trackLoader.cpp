@@ -0,0 +1,117 @@
+#include "../trackLoader.hpp"
+
+TrackLoader::TrackLoader() {
+    worker = std::thread(&TrackLoader::loadLoop, this);
+}
+
+TrackLoader::~TrackLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quitting = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+void TrackLoader::request(const std::string& path, uint32_t trackId) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++generation;
+        requestedPath = path;
+        requestedTrackId = trackId;
+        requested = true;
+        hasResult = false;
+        result = LoadedTrack();
+    }
+    wake.notify_one();
+}
+
+void TrackLoader::setSeekIndexDir(const std::string& dir) {
+    std::lock_guard<std::mutex> lock(mutex);
+    seekIndexDir = dir;
+}
+
+void TrackLoader::setTrackCache(TrackCache* cache) {
+    std::lock_guard<std::mutex> lock(mutex);
+    trackCache = cache;
+}
+
+void TrackLoader::cancel() {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++generation;
+    requested = false;
+    hasResult = false;
+    result = LoadedTrack();
+}
+
+bool TrackLoader::take(LoadedTrack& track) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!hasResult) {
+        return false;
+    }
+    track = std::move(result);
+    result = LoadedTrack();
+    hasResult = false;
+    return true;
+}
+
+bool TrackLoader::ready() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hasResult;
+}
+
+bool TrackLoader::busy() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return requested || (loading && loadingGeneration == generation) || hasResult;
+}
+
+void TrackLoader::loadLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [this]() { return quitting || requested; });
+        if (quitting) {
+            return;
+        }
+        LoadedTrack track;
+        std::string indexDir = seekIndexDir;
+        TrackCache* cache = trackCache;
+        track.path = requestedPath;
+        track.trackId = requestedTrackId;
+        loadingGeneration = generation;
+        requested = false;
+        loading = true;
+        lock.unlock();
+
+        // The slow part (cold cache, spinning disk, network mount) runs without the lock
+        track.file.reset(new sf::InputSoundFile);
+        TrackBytes bytes = cache ? cache->fetch(track.path) : nullptr;
+        bool opened;
+        if (bytes) {
+            track.stream.reset(new MemoryFileStream(std::move(bytes)));
+            opened = track.file->openFromStream(*track.stream);
+        } else {
+            opened = track.file->openFromFile(track.path);
+        }
+        if (opened) {
+            track.head.resize(static_cast<size_t>(TRACK_HEAD_SECONDS * track.file->getSampleRate()) * track.file->getChannelCount());
+            track.head.resize(static_cast<size_t>(track.file->read(track.head.data(), track.head.size())));
+            track.seekIndex = loadSeekIndex(track.path, indexDir);
+        } else {
+            track.file.reset();
+            track.stream.reset();
+        }
+
+        lock.lock();
+        loading = false;
+        if (loadingGeneration != generation) {
+            continue;  // overtaken by a newer request (or cancelled) while loading
+        }
+        result = std::move(track);
+        hasResult = true;
+        lock.unlock();
+        if (onLoaded) {
+            onLoaded();
+        }
+        lock.lock();
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef TAG_READER_HPP
+#define TAG_READER_HPP
+
+#include <map>
+#include <string>
+
+// Tags keyed the way ffprobe reports them under format.tags, lowercased:
+// "artist", "album", "title", "disc", "track", "genre", "date", "lyrics-<lang>"
+using TagMap = std::map<std::string, std::string>;
+
+// Reads ID3v2 (mp3, or an `id3 ` chunk in wav), FLAC Vorbis comments and RIFF INFO
+// straight from the file header region with bounded preads, no ffprobe fork.
+// Returns false (and leaves tags empty) when the file has no tag block we understand,
+// in which case the caller falls back to ffprobe. tagSource names the block that was used.
+bool readNativeTags(const std::string& filePath, TagMap& tags, std::string& tagSource);
+
+#endif // TAG_READER_HPP
@@ -0,0 +1,88 @@
+#ifndef TRACK_CACHE_HPP
+#define TRACK_CACHE_HPP
+
+#include <SFML/Audio.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Default memory budget of the track cache (`--track-cache-mb`)
+const uint32_t DEFAULT_TRACK_CACHE_MB = 128;
+
+using TrackBytes = std::shared_ptr<const std::vector<char>>;
+
+struct TrackCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t residentBytes = 0;
+    uint64_t budgetBytes = 0;
+    size_t tracks = 0;
+};
+
+// The compressed bytes of the last tracks played, least recently used dropped first.
+// Compressed rather than decoded: a budget that holds one decoded album holds ten encoded
+// ones, and decoding from memory costs far less than the disk it replaces. Replay, previous
+// and a track coming round again in the queue then open without touching the disk (a stat
+// still checks that the file was not edited since). Shared by every TrackLoader.
+// A miss never delays the load: the caller streams the file from disk as before while the
+// cache's own thread reads it in for the next time.
+class TrackCache {
+public:
+    explicit TrackCache(uint64_t budgetBytes);
+    ~TrackCache();  // waits for a file being read in
+    TrackCache(const TrackCache&) = delete;
+    TrackCache& operator=(const TrackCache&) = delete;
+
+    // The whole file when it is cached and unchanged; null otherwise (the caller then opens
+    // the file itself), a file that fits the budget being queued to be read in
+    TrackBytes fetch(const std::string& path);
+
+    TrackCacheStats stats() const;
+
+private:
+    struct Entry {
+        std::string path;
+        TrackBytes bytes;
+        uint64_t fileSize;
+        int64_t mtime;
+    };
+
+    void insert(Entry entry);
+    void fillLoop();
+
+    mutable std::mutex mutex;
+    std::condition_variable fillWake;
+    std::thread filler;
+    bool quitting = false;
+    std::deque<std::string> pendingFills;  // missed files still to read in, oldest first
+    uint64_t budget;
+    uint64_t resident = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    std::list<Entry> recency;  // most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> byPath;
+};
+
+// Presents cached bytes to sf::InputSoundFile; keeps them alive while the decoder reads
+class MemoryFileStream : public sf::InputStream {
+public:
+    explicit MemoryFileStream(TrackBytes bytes) : data(std::move(bytes)) {}
+
+    sf::Int64 read(void* out, sf::Int64 size) override;
+    sf::Int64 seek(sf::Int64 target) override;
+    sf::Int64 tell() override;
+    sf::Int64 getSize() override;
+
+private:
+    TrackBytes data;
+    uint64_t position = 0;
+};
+
+#endif // TRACK_CACHE_HPP
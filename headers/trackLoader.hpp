@@ -0,0 +1,78 @@
+#ifndef TRACK_LOADER_HPP
+#define TRACK_LOADER_HPP
+
+#include <SFML/Audio.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "seekIndex.hpp"
+#include "trackCache.hpp"
+
+// How much of a track a load decodes up front, enough for the stream to start from memory
+const float TRACK_HEAD_SECONDS = 1.f;
+
+// An opened track with its first TRACK_HEAD_SECONDS already decoded; the decoder
+// continues right after `head`
+struct LoadedTrack {
+    uint32_t trackId = UINT32_MAX;
+    std::string path;
+    std::unique_ptr<sf::InputSoundFile> file;  // null when the file could not be opened
+    std::unique_ptr<sf::InputStream> stream;   // cached bytes `file` reads, null when it reads the file
+    std::vector<sf::Int16> head;
+    std::shared_ptr<const SeekIndex> seekIndex;  // long mp3s scanned with a frame table, else null
+
+    LoadedTrack() = default;
+    LoadedTrack(LoadedTrack&&) = default;
+    LoadedTrack& operator=(LoadedTrack&&) = default;
+    ~LoadedTrack() { file.reset(); }  // the decoder goes before the stream it reads
+};
+
+// Background "load track X" worker.
+// Only the newest request matters: a request replaces one that has not started yet, and
+// the result of a load that was overtaken while the file was being opened is dropped, so
+// mashing next costs one open in flight plus the last one asked for.
+class TrackLoader {
+public:
+    TrackLoader();
+    ~TrackLoader();
+    TrackLoader(const TrackLoader&) = delete;
+    TrackLoader& operator=(const TrackLoader&) = delete;
+
+    void request(const std::string& path, uint32_t trackId);
+    void setSeekIndexDir(const std::string& dir);  // where loads look for mp3 seek tables
+    void setTrackCache(TrackCache* cache);         // loads go through it when set
+    void cancel();
+
+    // The result of the newest request once it is done; false while it is still loading
+    bool take(LoadedTrack& track);
+    bool ready() const;
+    bool busy() const;  // a request is queued, loading or waiting to be taken
+
+    // Runs on the loader thread after a result became ready, without the loader's lock held
+    std::function<void()> onLoaded;
+
+private:
+    void loadLoop();
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::thread worker;
+    bool quitting = false;
+    uint64_t generation = 0;       // bumped by every request / cancel
+    uint64_t loadingGeneration = 0;
+    std::string seekIndexDir;
+    TrackCache* trackCache = nullptr;
+    std::string requestedPath;
+    uint32_t requestedTrackId = UINT32_MAX;
+    bool requested = false;        // requestedPath has not been picked up yet
+    bool loading = false;
+    bool hasResult = false;
+    LoadedTrack result;
+};
+
+#endif // TRACK_LOADER_HPP
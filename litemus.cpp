@@ -1,10 +1,21 @@
 #include <cstdio>
+#include <algorithm>
 #include "headers/lmus_cache.hpp"
 #include "headers/sfml_helpers.hpp"
 #include "headers/ncurses_helpers.hpp"
 #include "headers/parsers.hpp"
 #include "headers/checkSongDir.hpp"
 #include "headers/keyHandlers.hpp"
+#include "headers/loopEvents.hpp"
+#include "headers/compositor.hpp"
+#include "headers/playQueue.hpp"
+#include "headers/daemon.hpp"
+#include "headers/controlSocket.hpp"
+#include "headers/libraryRefresh.hpp"
+#include "headers/searchPane.hpp"
+#include "headers/lyricsPane.hpp"
+#include "headers/lyricsStore.hpp"
+#include "headers/smartPlaylist.hpp"
 
 #define COLOR_PAIR_FOCUSED 1 
 #define COLOR_PAIR_SELECTED 3
@@ -20,8 +31,15 @@ const std::string songDirCache = cacheLitemusDir + "songDirectory.txt";
 const std::string cacheDirectory = cacheInfoDir + "song_names.json";
 const std::string cacheInfoFile = cacheInfoDir + "song_cache_info.json";
 const std::string cacheArtistDirectory = cacheInfoDir + "artists.json";
+const std::string cacheIndexFile = cacheInfoDir + "library.idx";
+const std::string cacheLyricsIndexFile = cacheInfoDir + "lyrics.idx";
+const std::string cacheLyricsFile = cacheInfoDir + "lyrics.dat";
+const std::string cacheQueueFile = cacheInfoDir + "queue.json";
+const std::string cacheSeekDir = cacheInfoDir + "seek/";
 const std::string cacheDebugFile = cacheLitemusDir + "debug.log";
+const std::string controlSocketFile = cacheLitemusDir + "lmus.sock";
 const std::string keybindsFilePath = configLitemusDir + "keybinds.json";
+const std::string playlistsFilePath = configLitemusDir + "playlists.json";
 
 // ansi escape vals (colors)
 const string ERROR = "\033[31m";
@@ -31,14 +49,13 @@ const string BLD = "\033[1m";
 
 const char* title_content = "  LITEMUS - Light Music player                                                                                                                                                                               ";
 
-char* strdup(const char* s) {
-    size_t len = strlen(s);
-    char* dup = new char[len + 1];
-    strcpy(dup, s);
-    return dup;
-}
-
 int main(int argc, char* argv[]) {
+    unsigned int jobs = extractJobsOption(argc, argv);
+    bool frameStatsEnabled = extractFlagOption(argc, argv, "--frame-stats");
+    float bufferSeconds = extractBufferSecondsOption(argc, argv, DEFAULT_DECODE_AHEAD_SECONDS);
+    bool analyzeLoudness = extractFlagOption(argc, argv, "--loudness");
+    NormalizeMode normalize = extractNormalizeOption(argc, argv);
+    uint32_t trackCacheMb = extractTrackCacheOption(argc, argv, DEFAULT_TRACK_CACHE_MB);
     // Initialize ncurses
     if (argc == 1) {
       litemusHelper(NC);
@@ -47,7 +64,7 @@ int main(int argc, char* argv[]) {
     if (argc <= 2 && std::string(argv[1]) == "--remote-cache") {
         songDirMain(songDirCache, cacheLitemusDir);
         std::string songsDirectory = read_file_to_string(songDirCache);
-        lmus_cache_main(songsDirectory, homeDir, cacheLitemusDir, configLitemusDir, cacheInfoDir, cacheInfoFile, cacheArtistDirectory, songDirCache, cacheDebugFile);
+        lmus_cache_main(songsDirectory, homeDir, cacheLitemusDir, configLitemusDir, cacheInfoDir, cacheInfoFile, cacheArtistDirectory, songDirCache, cacheDebugFile, jobs, analyzeLoudness, false, nullptr);
         cout << endl << "Successfully cached the directory " << GREEN << songsDirectory << NC << endl << "Run `" << GREEN << "lmus run" << NC << "` to experience LiteMus!" << endl;
         return 0;
     }
@@ -66,27 +83,77 @@ int main(int argc, char* argv[]) {
         return 1;
       }
     }
+    else if (argc == 2 && std::string(argv[1]) == "daemon") {
+      if (!file_exists_and_not_empty(songDirCache)) {
+        cout << ERROR << BLD << "[ERROR] No songs directory cached yet: run `lmus run` or `lmus --remote-cache` once first." << NC << endl;
+        return 1;
+      }
+      std::string songsDirectory = read_file_to_string(songDirCache);
+      lmus_cache_main(songsDirectory, homeDir, cacheLitemusDir, configLitemusDir, cacheInfoDir, cacheInfoFile, cacheArtistDirectory, songDirCache, cacheDebugFile, jobs, analyzeLoudness, false, nullptr);
+      return lmus_daemon_main(songsDirectory, cacheIndexFile, cacheQueueFile, cacheSeekDir, controlSocketFile, bufferSeconds, trackCacheMb, normalize);
+    }
+    else if (argc >= 3 && std::string(argv[1]) == "ctl") {
+      std::string command = argv[2];
+      for (int i = 3; i < argc; ++i) {
+        command += std::string(" ") + argv[i];
+      }
+      return lmus_ctl_main(controlSocketFile, command);
+    }
+    else if (argc == 2 && std::string(argv[1]) == "run" && daemonListening(controlSocketFile)) {
+      // The daemon owns playback: this session only shows its status and sends it keys
+      std::unordered_map<std::string, int> keybinds;
+      loadKeybinds(keybindsFilePath, keybinds);
+      return lmus_attach_main(controlSocketFile, keybinds);
+    }
     else if (argc == 2 && std::string(argv[1]) == "run") {
     songDirMain(songDirCache, cacheLitemusDir);
     std::string songsDirectory = read_file_to_string(songDirCache);
-    lmus_cache_main(songsDirectory, homeDir, cacheLitemusDir, configLitemusDir, cacheInfoDir, cacheInfoFile, cacheArtistDirectory, songDirCache, cacheDebugFile);
+    // The session opens from the last cache snapshot; only a first run (or a broken index)
+    // waits for the cache pass, otherwise it verifies the library behind the running UI
+    Library library;
+    bool cachedLibrary = loadLibraryFile(library, cacheIndexFile, songsDirectory);
+    if (!cachedLibrary) {
+        lmus_cache_main(songsDirectory, homeDir, cacheLitemusDir, configLitemusDir, cacheInfoDir, cacheInfoFile, cacheArtistDirectory, songDirCache, cacheDebugFile, jobs, analyzeLoudness, false, nullptr);
+        if (!loadLibraryFile(library, cacheIndexFile, songsDirectory)) {
+            cout << ERROR << BLD << "[ERROR] Could not open the library index " << cacheIndexFile << ". Run `lmus --remote-cache` to rebuild the cache." << NC << endl;
+            return -1;
+        }
+    }
     std::unordered_map<std::string, int> keybinds;
     loadKeybinds(keybindsFilePath, keybinds);
+    // Smart playlists are evaluated here and again after every rescan; a broken file or query
+    // only costs its playlists
+    std::vector<SmartPlaylist> smartPlaylists;
+    std::string playlistsError;
+    if (!loadSmartPlaylists(playlistsFilePath, smartPlaylists, playlistsError)) {
+        cout << YELLOW << BOLD << "[WARNING] " << playlistsError << NC << endl;
+    }
+    for (const SmartPlaylist& playlist : smartPlaylists) {
+        if (!playlist.error.empty()) {
+            cout << YELLOW << BOLD << "[WARNING] Smart playlist \"" << playlist.name << "\": " << playlist.error << NC << endl;
+        }
+    }
+    applySmartPlaylists(library, smartPlaylists);
     cout << BLUE << BOLD << "--------------------- LITEMUS -- SESSION -- START ------------------------" << endl;
+    // SFML reports files it cannot open or decode on sf::err() (stderr), which would land on
+    // the screen ncurses owns: the loaders and the background rescan write them to debug.log
+    static std::ofstream sfmlErrors(cacheDebugFile, std::ios::app);
+    sf::err().rdbuf(sfmlErrors.rdbuf());
     ncursesSetup(); 
+    if (frameStatsEnabled && !enableFrameByteCounter()) {
+        endwin();
+        cout << ERROR << BLD << "[ERROR] --frame-stats needs /proc/thread-self/io (task I/O accounting) on this kernel." << NC << endl;
+        return -1;
+    }
     int menu_height, menu_width, title_height, title_width;
     updateWindowDimensions(menu_height, menu_width, title_height, title_width); // dynamic grab of terminal window's dimensions
 
-    // Cache directory and song information
-    std::vector<std::string> allInodes = loadPreviousInodes(cacheInfoFile);
-    int songsSize = allInodes.size();
-    std::vector<std::string> allArtists = parseArtists(cacheArtistDirectory);
+    // The run loop below does no file I/O or parsing: a rescanned library arrives fully built
+    std::vector<std::string> allArtists = library.artistNames();
     int artistsSize = allArtists.size();
-    auto [songCrudeTitles, songPaths, songDurations, songAlbums, albumYears] = listSongs(cacheDirectory, allArtists[0], songsDirectory); // default to the first artist
-    size_t maxTitleLength = getMaxSongTitleLength(songCrudeTitles, songDurations);
-    auto songTitles = getTitlesWithWhiteSpaces(songCrudeTitles, songDurations, maxTitleLength);
+    int songsSize = library.trackCount();
     // Check if songs are found
-    if (allArtists.empty() || songTitles.empty() || songPaths.empty()) {
+    if (allArtists.empty() || library.trackCount() == 0) {
         printw("No songs found in directory.\n");
         refresh();
         endwin();
@@ -94,52 +161,77 @@ int main(int argc, char* argv[]) {
         cout << "[NOTE] Ensure that the mp3 files in your directory have proper metadata embedded in them!" << endl;
         return -1;
     }
-
-    // Initialize artist menu
-    ITEM** artistItems = createItems("artist", allArtists, songTitles, songDurations, songAlbums, albumYears);
-    MENU* artistMenu = new_menu(artistItems);
-
-    // Initialize song menu 
-    ITEM** songItems = createItems("song", allArtists, songTitles, songDurations, songAlbums, albumYears);
-    MENU* songMenu = new_menu(songItems);
-    songTitles = songCrudeTitles;
+    BrowseMode browseMode = BrowseMode::Artist;  // what the left pane lists
+    uint32_t shownGroup = 0;                     // its row whose tracks the song pane shows
 
     // Window dimensions and initialization
 
     WINDOW* title_win = newwin(title_height, title_width, 0, 0);
     wbkgd(title_win, COLOR_PAIR(GREY_BACKGROUND_COLOR));
     box(title_win, 0, 0);
-    wrefresh(title_win);
 
     WINDOW* artist_menu_win = newwin(menu_height, menu_width, 1, 0);
     WINDOW* song_menu_win = newwin(menu_height, menu_width, 1, menu_width);
     WINDOW* status_win = newwin(10, 300, LINES - 2, 0);
-
-    // Set menus to their respective windows
-    ncursesMenuSetup(artistMenu, artist_menu_win, menu_height, menu_width, "artist"); 
-    ncursesMenuSetup(songMenu, song_menu_win, menu_height, menu_width, "song");
-      
-
-    set_menu_format(artistMenu, menu_height, 0);
-    set_menu_format(songMenu, menu_height, 0);
-
-    set_current_item(songMenu, songItems[1]);
+    // Flush order is paint order: anything drawn on top of these is an overlay
+    compositorAddPanel(title_win);
+    compositorAddPanel(artist_menu_win);
+    compositorAddPanel(song_menu_win);
+    compositorAddPanel(status_win);
+
+    // Lists draw straight from the library, only the rows that are on screen
+    ListView artistList;
+    artistList.attach(artist_menu_win);
+    artistList.setRows(library.view(browseMode).groups.size(), groupRows(library, browseMode));
+    ListView songList;
+    songList.attach(song_menu_win);
+    songList.setRows(groupRowCount(library.view(browseMode), shownGroup), songRows(library, browseMode, shownGroup)); // cursor lands past the first album header
 
     ncursesWinControl(artist_menu_win, song_menu_win, status_win, title_win, "box");
-
-    ncursesWinControl(artist_menu_win, song_menu_win, status_win, title_win, "refresh"); 
+    SearchPane searchPane;  // the whole library, indexed in the background
+    LyricsPane lyricsPane;
+    uint32_t lyricsTrackId = INDEX_NOT_FOUND;  // whose lyrics the open lyrics pane shows
+    searchPane.indexLibrary(library, cacheLyricsIndexFile);
 
     // Initialize SFML Music
-    sf::Music music;
-    int currentSongIndex = -1;
-    std::string currentSong = songTitles.empty() ? "" : songTitles[0];
+    TrackCache trackCache(static_cast<uint64_t>(trackCacheMb) << 20);  // outlives both loaders
+    PlaybackEngine music(bufferSeconds);
+    music.setSeekIndexDir(cacheSeekDir);
+    music.setTrackCache(&trackCache);
+    uint32_t currentTrackId = INDEX_NOT_FOUND;
+    PlayQueue queue(library.trackCount());     // playback order, browsing the menus never touches it
+    queue.load(cacheQueueFile, library);       // last session's queue, ready for play / next / prev
+    std::string currentSong = library.track(library.artist(library.artistIdAt(0)).firstTrack).title;
     std::string currentArtist = allArtists.empty() ? "" : allArtists[0];
     std::string currentGenre = "";
-    std::string currentLyrics = "";
 
-    // Timeout for getch() to avoid blocking indefinitely
-    timeout(1);
+    // getch() never blocks: the loop sleeps in poll() and drains every pending key per wakeup
+    nodelay(stdscr, TRUE);
     nodelay(artist_menu_win, TRUE);
+    LoopEvents events;
+    if (!events.open()) {
+        endwin();
+        cout << ERROR << BLD << "[ERROR] Could not create the timer / wakeup descriptors for the main loop." << NC << endl;
+        return -1;
+    }
+    music.onStreamEvent = [&events]() { events.notifyTrackEnd(); };
+    TrackLoader loader;  // files are opened off the UI thread, LOOP_EVENT_LOADED says when
+    loader.onLoaded = [&events]() { events.notifyLoaded(); };
+    loader.setSeekIndexDir(cacheSeekDir);
+    loader.setTrackCache(&trackCache);
+    LibraryRefresh libraryRefresh;  // declared after events: joined before they close
+    if (cachedLibrary) {
+        libraryRefresh.onFinished = [&events]() { events.notifyLibrary(); };
+        libraryRefresh.start([songsDirectory, jobs, analyzeLoudness](CacheSummary& summary, const std::atomic<bool>& cancel) {
+            std::string scanDirectory = songsDirectory;
+            lmus_cache_main(scanDirectory, homeDir, cacheLitemusDir, configLitemusDir, cacheInfoDir, cacheInfoFile, cacheArtistDirectory, songDirCache, cacheDebugFile, jobs, analyzeLoudness, true, &summary, &cancel);
+        }, cacheIndexFile, songsDirectory);
+    }
+    bool libraryWaiting = false;  // the rescan finished, swapped in once no load or splice is in flight
+    std::string libraryNotice = "";
+    std::chrono::steady_clock::time_point libraryNoticeUntil;
+    bool trackEnding = false;  // decoder done or next track spliced, the tail of the track is still playing
+    bool redraw = false;
 
     // Flag to track first enter press
     bool firstEnterPressed = false;
@@ -150,74 +242,108 @@ int main(int argc, char* argv[]) {
     bool updateStatusMetadata = false;
     bool showingartMen = true;
 
-    highlightFocusedWindow(artistMenu, true);
-    highlightFocusedWindow(songMenu, false);
+    highlightFocusedWindow(artistList, true);
+    highlightFocusedWindow(songList, false);
+    updateStatusBar(status_win, currentSong, currentArtist, currentGenre, music, firstEnterPressed, showingLyrics, loader.busy());
+    ncursesWinLoop(artistList, songList, artist_menu_win, song_menu_win, status_win, title_win, title_content, showingartMen, browseTitle(browseMode));
+    flushFrame();
     
       while (true) {
-          int ch = getch();
-          if (ch != ERR) {
-              if (ch == keybinds["show_artists_menu"]) {
+          unsigned int ready = events.wait();
+          if (ready & LOOP_EVENT_HANGUP) {
+              break;
+          }
+          if (ready & LOOP_EVENT_TRACK_END) {
+              trackEnding = true;
+          }
+          if (ready & LOOP_EVENT_LIBRARY) {
+              libraryWaiting = true;
+          }
+          bool resized = false;
+          int ch;
+          while ((ch = getch()) != ERR) {
+              redraw = true;
+              if (ch == KEY_RESIZE) {
+                  resized = true;
+              } else if (searchPane.active()) {  // typing goes to the query, the menus wait
+                  if (searchPane.handleKey(ch)) {
+                      SearchResult result = searchPane.picked();
+                      searchPane.close();
+                      showingartMen = true;
+                      revealSearchResult(library, result, artistList, songList, browseMode, shownGroup, showingArtists);
+                  }
+              } else if (lyricsPane.active() && lyricsPane.handleKey(ch)) {
+                  if (!lyricsPane.active()) {  // closed
+                      werase(artist_menu_win);
+                      artistList.setFore(COLOR_PAIR(COLOR_YELLOW));
+                      highlightFocusedWindow(artistList, showingArtists);
+                      showingLyrics = false;
+                  }
+              } else if (lyricsPane.active() && ch != keybinds["toggle_playback"] && ch != keybinds["increase_volume"] && ch != keybinds["decrease_volume"]) {
+                  // the menus are covered: only the playback keys the warning lists reach them
+              } else if (ch == keybinds["show_artists_menu"]) {
                   if (!showingArtists) {
-                      highlightFocusedWindow(artistMenu, true);
-                      highlightFocusedWindow(songMenu, false);
+                      highlightFocusedWindow(artistList, true);
+                      highlightFocusedWindow(songList, false);
                       showingArtists = !showingArtists;
                   }
                   showingartMen = true;
-                  handleKeyEvent_1(artistMenu, songMenu, artist_menu_win, showingArtists, menu_height, menu_width);
+                  handleKeyEvent_1(artistList, songList, artist_menu_win, showingArtists);
               } else if (ch == keybinds["toggle_window_focus"]) {  // Tab to switch between menus
                   updateSongMenu = false;
                   showingartMen = true;
                   showingArtists = !showingArtists;
-                  handleKeyEvent_tab(artistMenu, songMenu, artist_menu_win, song_menu_win, showingArtists, menu_height, menu_width);
+                  handleKeyEvent_tab(artistList, songList, artist_menu_win, song_menu_win, showingArtists);
               } else if (ch == KEY_DOWN || ch == keybinds["key_down"]) {
-                  move_menu_down(artistMenu, songMenu, showingArtists); // ncurses helpers
                   if (showingArtists) {
-                      updateSongMenu = true;
+                      updateSongMenu = artistList.moveDown();
+                  } else {
+                      songList.moveDown();
                   }
               } else if (ch == KEY_UP || ch == keybinds["key_up"]) {
-                  move_menu_up(artistMenu, songMenu, showingArtists); // ncurses helpers
                   if (showingArtists) {
-                      updateSongMenu = true;
+                      updateSongMenu = artistList.moveUp();
+                  } else {
+                      songList.moveUp();
                   }
               } else if (ch == KEY_RIGHT || ch == keybinds["key_right"]) {
                   seekSong(music, 5, 1); // 1 is bool for true -> it will forward (sfml helpers)
               } else if (ch == KEY_LEFT || ch == keybinds["key_left"]) {
                   seekSong(music, 5, 0); // sfml helpers
-              } else if (ch == keybinds["string_search"]) { // string search 
-                  handleKeyEvent_slash(artistMenu, songMenu, showingArtists);
-                  if (showingArtists) {
-                      updateSongMenu = true;
-                  }
+              } else if (ch == keybinds["string_search"]) { // library-wide search
+                  searchPane.open();
+              } else if (ch == keybinds["cycle_browse_mode"]) {  // artists -> albums -> genres -> years -> playlists
+                  do {  // without a playlists.json there is no Playlist view to show
+                      browseMode = static_cast<BrowseMode>((static_cast<size_t>(browseMode) + 1) % BROWSE_MODE_COUNT);
+                  } while (library.view(browseMode).groups.empty());
+                  artistList.setRows(library.view(browseMode).groups.size(), groupRows(library, browseMode));
+                  werase(artist_menu_win);
+                  showingartMen = true;
+                  updateSongMenu = true;
               } else if (ch == keybinds["play_selected_song"]) {  // Enter key
                   if (!showingArtists) {
-                      // Play selected song from song menu
-                      ITEM* curItem = current_item(songMenu);
-                      int selectedIndex = item_index(curItem);
-
-                      // Find the actual playable index (skip over non-selectable items)
-                      int playableIndex = -1;
-                      int actualIndex = 0;
-
-                      while (actualIndex <= selectedIndex) {
-                          if (item_opts(songItems[actualIndex]) & O_SELECTABLE) {
-                              if (playableIndex == selectedIndex) {
-                                  break; // Found the actual playable item
-                              }
-                              playableIndex++;
-                          }
-                          actualIndex++;
-                      }
-
-                      // Check if the selected index is within bounds and playable
-                      if (playableIndex < songPaths.size()) {
-                          currentSongIndex = playableIndex;
+                      // Play selected song from song menu: the cursor row maps straight to a track id,
+                      // and the shown group (artist, album, genre, decade or playlist) becomes the queue
+                      const BrowseView& view = library.view(browseMode);
+                      uint32_t section;
+                      uint32_t trackId = groupRowTrack(view, shownGroup, static_cast<uint32_t>(songList.cursor()), section);
+                      if (trackId != INDEX_NOT_FOUND) {
+                          const BrowseGroup& group = view.groups[shownGroup];
+                          std::vector<uint32_t> groupTrackIds(view.tracks.begin() + group.first, view.tracks.begin() + group.first + group.count);
+                          queue.replace(groupTrackIds, trackId);
+                          currentTrackId = trackId;
                           updateStatusMetadata = true;
-                          playMusic(music, songPaths[currentSongIndex]);
+                          playMusic(loader, library.track(currentTrackId).path, currentTrackId);
                       }
                       firstEnterPressed = true;
                   }
               } else if (ch == keybinds["toggle_playback"]) {  // Pause/play music
-                  if (music.getStatus() == sf::Music::Paused) {
+                  if (!firstEnterPressed && !queue.empty()) {  // resume the restored queue
+                      currentTrackId = queue.current();
+                      playMusic(loader, library.track(currentTrackId).path, currentTrackId);
+                      updateStatusMetadata = true;
+                      firstEnterPressed = true;
+                  } else if (music.getStatus() == sf::SoundSource::Paused) {
                       music.play();
                   } else {
                       music.pause();
@@ -227,7 +353,7 @@ int main(int argc, char* argv[]) {
               } else if (ch == keybinds["backward_seek_song_60s"]) {  // Rewind (go back 60 seconds)
                   seekSong(music, 60 , 0);
               } else if (ch == keybinds["replay_current_song"]) {  // Restart current song
-                  music.stop();
+                  music.setPlayingOffset(sf::Time::Zero);  // stop() no longer rewinds
                   music.play();
               } else if (ch == keybinds["increase_volume"]) {  // Volume up
                   adjustVolume(music, 10.f); // sfml helpers
@@ -237,58 +363,83 @@ int main(int argc, char* argv[]) {
                   toggleMute(music, isMuted); // sfml helpers
                   isMuted = !isMuted;
               } else if (ch == keybinds["play_next_song"]) {  // Next song
-                  if (firstEnterPressed) {
-                      nextSong(music, songPaths, currentSongIndex);
+                  if (!queue.empty()) {
+                      currentTrackId = nextSong(loader, library, queue);
                       updateStatusMetadata = true; 
+                      firstEnterPressed = true;
                   }
               } else if (ch == keybinds["play_prev_song"]) {  // Previous song
-                  if (firstEnterPressed) {
-                      previousSong(music, songPaths, currentSongIndex);
+                  if (!queue.empty()) {
+                      currentTrackId = previousSong(loader, library, queue);
                       updateStatusMetadata = true; 
+                      firstEnterPressed = true;
                   }
+              } else if (ch == keybinds["append_to_queue"] || ch == keybinds["play_song_next"] || ch == keybinds["remove_from_queue"]) {
+                  if (!showingArtists) {
+                      uint32_t section;
+                      uint32_t trackId = groupRowTrack(library.view(browseMode), shownGroup, static_cast<uint32_t>(songList.cursor()), section);
+                      if (trackId != INDEX_NOT_FOUND) {
+                          if (ch == keybinds["append_to_queue"]) {
+                              queue.append(trackId);
+                          } else if (ch == keybinds["play_song_next"]) {
+                              queue.insertNext(trackId);
+                          } else {
+                              queue.remove(trackId);
+                          }
+                          queueNextSong(music, library, queue, normalize);  // the splice target may have changed
+                      }
+                  }
+              } else if (ch == keybinds["toggle_shuffle"]) {
+                  queue.setShuffle(!queue.shuffled());
+                  queueNextSong(music, library, queue, normalize);
               } else if (ch == keybinds["display_help_controls"]) {  // Display help window
                   if (showingArtists) {
-                      highlightFocusedWindow(artistMenu, false);
-                      highlightFocusedWindow(songMenu, true);
+                      highlightFocusedWindow(artistList, false);
+                      highlightFocusedWindow(songList, true);
                       showingArtists = !showingArtists;
                   }
                   showingartMen = false;
                   displayWindow(artist_menu_win, "help", keybinds);
               } else if (ch == keybinds["display_lyrics_view"]) {
+                  // Only the playing song's lyrics, read from lyrics.dat now that they are shown
+                  std::string currentLyrics;
+                  if (currentTrackId != INDEX_NOT_FOUND) {
+                      const LibraryTrack& track = library.track(currentTrackId);
+                      readLyrics(cacheLyricsFile, track.lyricsOffset, track.lyricsLength, track.inode, currentLyrics);
+                  }
                   if (currentLyrics != "") {
-                      // Assuming you have all the necessary variables defined and initialized
-                      displayLyricsWindow(artist_menu_win, currentLyrics, currentSong, currentArtist, menu_height, menu_width, music,
-                                          status_win, firstEnterPressed, showingLyrics, song_menu_win, songMenu, currentGenre, showingArtists, keybinds);
-
+                      // Drawn and fed keys by this loop from now on, until 1 closes it
+                      lyricsPane.open(artist_menu_win, currentLyrics, currentSong, currentArtist);
+                      lyricsTrackId = currentTrackId;
+                      showingLyrics = true;
                   } else {
                       displayWindow(artist_menu_win, "LyricErr", keybinds);
+                      flushFrame();
                       std::this_thread::sleep_for(std::chrono::seconds(1));
+                      werase(artist_menu_win);
+                      artistList.setFore(COLOR_PAIR(COLOR_YELLOW));
+                      highlightFocusedWindow(artistList, showingArtists);
                   }
-                  werase(artist_menu_win);
-                  ncursesMenuSetup(artistMenu, artist_menu_win, menu_height, menu_width, "artist");
-                  set_menu_format(artistMenu, menu_height, 0);
-                  set_menu_fore(artistMenu, COLOR_PAIR(COLOR_YELLOW));
-                  post_menu(artistMenu);
-                  highlightFocusedWindow(artistMenu, showingArtists);
-                  showingLyrics = false;
               } else if (ch == keybinds["display_session_details"]) {
                   if (showingArtists) {
-                      highlightFocusedWindow(artistMenu, false);
-                      highlightFocusedWindow(songMenu, true);
+                      highlightFocusedWindow(artistList, false);
+                      highlightFocusedWindow(songList, true);
                       showingArtists = !showingArtists;
                   }
                   showingartMen = false;
-                  printSessionDetails(artist_menu_win, songsDirectory, cacheLitemusDir, cacheDebugFile, keybindsFilePath, artistsSize, songsSize);
+                  printSessionDetails(artist_menu_win, songsDirectory, cacheLitemusDir, cacheDebugFile, keybindsFilePath, artistsSize, songsSize, music, queue, trackCache.stats());
               } else if (ch == keybinds["quit"]) {  // Quit
-                  if (showExitConfirmation(song_menu_win)) {
-                      quitFunc(music, allArtists, songTitles, artistItems, songItems, artistMenu, songMenu);
+                  if (showExitConfirmation()) {
+                      queue.save(cacheQueueFile, library);
+                      quitFunc(music);
                       ncursesWinControl(artist_menu_win, song_menu_win, status_win, title_win, "delete");
                       endwin();
                       verboseQuit(NC, BLUE, BOLD);
                       return 0;
                   }
               } else if (ch == keybinds["force_quit"]) { // force exit
-                  quitFunc(music, allArtists, songTitles, artistItems, songItems, artistMenu, songMenu);
+                  queue.save(cacheQueueFile, library);
+                  quitFunc(music);
                   ncursesWinControl(artist_menu_win, song_menu_win, status_win, title_win, "delete");
                   endwin();
                   verboseQuit(NC, BLUE, BOLD);
@@ -298,92 +449,128 @@ int main(int argc, char* argv[]) {
 
                   
         if (updateSongMenu) {
-            ITEM* artItem = current_item(artistMenu);
-            int artselectedIndex = item_index(artItem);
-            post_menu(artistMenu);
-            post_menu(songMenu);
-            box(menu_win(artistMenu), 0, 0);
-            const char* selectedArtist = allArtists[artselectedIndex].c_str();
-
-            // Update song menu with songs of the selected artist
-            auto [newCrudeSongTitles, newSongPaths, newSongDurations, albumNames, albumYears] = listSongs(cacheDirectory, selectedArtist, songsDirectory);
-            size_t newMaxTitleLength = getMaxSongTitleLength(newCrudeSongTitles, newSongDurations);
-            auto newSongTitles = getTitlesWithWhiteSpaces(newCrudeSongTitles, newSongDurations, newMaxTitleLength);
-            // Group songs by album and release year
-            std::map<std::string, std::vector<std::string>> songsByAlbum;
-            for (size_t i = 0; i < albumNames.size(); ++i) {
-                std::string albumKey = albumNames[i] + " (" + albumYears[i].substr(0,4) + ")";
-                songsByAlbum[albumKey].push_back(newSongTitles[i]);
-            }
+            // Update song menu with songs of the selected group: no rows are built, only re-pointed
+            shownGroup = static_cast<uint32_t>(artistList.cursor());
+            songList.setRows(groupRowCount(library.view(browseMode), shownGroup), songRows(library, browseMode, shownGroup));
+            werase(song_menu_win);
+            box(artist_menu_win, 0, 0);
+            artistList.draw();
+            songList.setFore(COLOR_PAIR(COLOR_BLUE));
+            songList.draw();
+            updateSongMenu = false;
+        }
 
-            // Prepare new menu items
-            std::vector<std::string> newMenuItems;
-            for (const auto& [album, songs] : songsByAlbum) {
-                newMenuItems.push_back(album); // Non-selectable title
-                for (const auto& song : songs) {
-                    newMenuItems.push_back("  " + song); // Selectable songs
-                }
-            }
+        // A requested song finished opening: it replaces whatever plays now
+        if ((ready & LOOP_EVENT_LOADED) && startLoadedSong(music, loader, library, queue, normalize)) {
+            trackEnding = false;
+            redraw = true;
+        }
 
-            // Clean up old menu items
-            for (size_t i = 0; i < songTitles.size(); ++i) {
-                free_item(songItems[i]);
-            }
-            free_menu(songMenu);
-            werase(menu_win(songMenu));
-
-            // Create new menu items
-            songItems = new ITEM*[newMenuItems.size() + 1];
-            for (size_t i = 0; i < newMenuItems.size(); ++i) {
-                songItems[i] = new_item(strdup(newMenuItems[i].c_str()), "");
-                if (newMenuItems[i].find("  ") != 0) { // Non-selectable if not a song (album title)
-                    item_opts_off(songItems[i], O_SELECTABLE);
+        // Playback crossed a gapless splice: the queued track is the one playing now
+        if (music.update()) {
+            currentTrackId = music.currentTrack();
+            queue.setCurrent(currentTrackId);  // false if it was taken off the queue meanwhile
+            queueNextSong(music, library, queue, normalize);
+            updateStatusMetadata = true;
+            trackEnding = false;
+            redraw = true;
+        }
+
+        // Swap in the rescanned library. Every id held here, by the queue or by the engine is
+        // renumbered through the inodes; waiting for the loader and the splice means no id is in flight
+        if (libraryWaiting && !loader.busy() && !music.transitionPending()) {
+            std::unique_ptr<Library> fresh;
+            CacheSummary summary;
+            bool taken = libraryRefresh.take(fresh, summary);
+            if (taken && fresh) {
+                std::vector<uint32_t> idMap = mapTrackIds(library, *fresh);
+                std::string shownName = library.groupName(browseMode, library.view(browseMode).groups[shownGroup]);
+                queue.remap(idMap, fresh->trackCount());
+                music.renumberTracks(idMap);
+                if (currentTrackId != INDEX_NOT_FOUND) {
+                    currentTrackId = idMap[currentTrackId];
+                }
+                searchPane.forgetLibrary();  // its build may still read the old library
+                library = std::move(*fresh);
+                std::vector<SmartPlaylist> freshPlaylists;  // picks up edits to playlists.json too
+                if (loadSmartPlaylists(playlistsFilePath, freshPlaylists, playlistsError)) {
+                    smartPlaylists = std::move(freshPlaylists);
+                }
+                applySmartPlaylists(library, smartPlaylists);  // before the search build starts reading it
+                searchPane.indexLibrary(library, cacheLyricsIndexFile);
+                if (library.view(browseMode).groups.empty()) {
+                    browseMode = BrowseMode::Artist;
                 }
+
+                allArtists = library.artistNames();
+                artistsSize = allArtists.size();
+                songsSize = library.trackCount();
+                const std::vector<BrowseGroup>& groups = library.view(browseMode).groups;
+                auto shownPosition = std::find_if(groups.begin(), groups.end(), [&](const BrowseGroup& group) { return library.groupName(browseMode, group) == shownName; });
+                shownGroup = shownPosition == groups.end() ? 0 : static_cast<uint32_t>(shownPosition - groups.begin());
+                artistList.setRows(groups.size(), groupRows(library, browseMode));
+                artistList.setCursor(shownGroup);
+                songList.setRows(groupRowCount(library.view(browseMode), shownGroup), songRows(library, browseMode, shownGroup));
+                queueNextSong(music, library, queue, normalize);
+
+                libraryNotice = "Library rescanned: +" + std::to_string(summary.added) + " / -" + std::to_string(summary.removed) + " songs";
+                libraryNoticeUntil = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+                markAllDirty();
+                redraw = true;
+            } else if (taken && !summary.error.empty()) {
+                // the session carries on with the library it opened with
+                libraryNotice = "Library rescan failed: " + summary.error;
+                libraryNoticeUntil = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+                redraw = true;
             }
-            songItems[newMenuItems.size()] = nullptr;
-
-            // Recreate the menu
-            songMenu = new_menu(songItems);
-            ncursesMenuSetup(songMenu, song_menu_win, menu_height, menu_width, "song");
-            set_menu_format(songMenu, menu_height, 1); // Set the menu format to display items correctly
-            set_menu_fore(songMenu, A_REVERSE);
-            post_menu(songMenu);
-
-            // Update the song details
-            songTitles = newCrudeSongTitles;
-            songPaths = newSongPaths;
-            songDurations = newSongDurations;
-
-            // Refresh the windows
-            wrefresh(menu_win(artistMenu));
-            wrefresh(menu_win(songMenu));
-
-            set_current_item(songMenu, songItems[1]); // the 0th item is always an album name
-            set_menu_fore(songMenu, COLOR_PAIR(COLOR_BLUE));
+            libraryWaiting = false;
+        }
+        if (!libraryNotice.empty() && std::chrono::steady_clock::now() >= libraryNoticeUntil) {
+            libraryNotice = "";
+            redraw = true;
         }
 
-        if (updateStatusMetadata) {
-          currentSong = songTitles[currentSongIndex];
-          auto resultGA = findCurrentGenreArtist(cacheDirectory, currentSong, currentLyrics);
+        if (updateStatusMetadata && currentTrackId != INDEX_NOT_FOUND) {
+          currentSong = library.track(currentTrackId).title;
+          auto resultGA = findCurrentGenreArtist(library, currentTrackId);
           currentGenre = resultGA.first;
           currentArtist = resultGA.second;
-          updateStatusBar(status_win, currentSong, currentArtist, currentGenre,  music, firstEnterPressed, showingLyrics);
           updateStatusMetadata = false;
         }
 
-        // Handle song transition when current song ends
-        if (music.getStatus() == sf::Music::Stopped && firstEnterPressed) {
-            nextSong(music, songPaths, currentSongIndex);
-            currentSong = songTitles[currentSongIndex];
-            auto resultGA = findCurrentGenreArtist(cacheDirectory, currentSong, currentLyrics);
+        // The stream ended without a splice (last track failed to preload, format change, underrun)
+        if (music.getStatus() == sf::SoundSource::Stopped && firstEnterPressed && !loader.busy() && !queue.empty()) {
+            currentTrackId = nextSong(loader, library, queue);
+            currentSong = library.track(currentTrackId).title;
+            auto resultGA = findCurrentGenreArtist(library, currentTrackId);
             currentGenre = resultGA.first;
             currentArtist = resultGA.second;
-            updateStatusBar(status_win, currentSong, currentArtist, currentGenre, music, firstEnterPressed, showingLyrics);
+            trackEnding = false;
+            redraw = true;
+        }
+
+        // The lyrics pane follows the playing song; one without lyrics closes it
+        if (lyricsPane.active() && currentTrackId != lyricsTrackId) {
+            std::string currentLyrics;
+            if (currentTrackId != INDEX_NOT_FOUND) {
+                const LibraryTrack& track = library.track(currentTrackId);
+                readLyrics(cacheLyricsFile, track.lyricsOffset, track.lyricsLength, track.inode, currentLyrics);
+            }
+            if (currentLyrics != "") {
+                lyricsPane.open(artist_menu_win, currentLyrics, currentSong, currentArtist);
+            } else {
+                lyricsPane.close();
+                werase(artist_menu_win);
+                artistList.setFore(COLOR_PAIR(COLOR_YELLOW));
+                highlightFocusedWindow(artistList, showingArtists);
+                showingLyrics = false;
+            }
+            lyricsTrackId = currentTrackId;
+            redraw = true;
         }
 
-        if (is_term_resized(LINES, COLS)) {
-                clear();
-                refresh();
+        if (resized) {
+                clearok(curscr, TRUE);  // the next doupdate() repaints the whole terminal
                 updateWindowDimensions(menu_height, menu_width, title_height, title_width);
 
                 wresize(title_win, title_height, title_width);
@@ -395,19 +582,36 @@ int main(int argc, char* argv[]) {
                 mvwin(status_win, menu_height + 2, 0);
 
                 ncursesWinControl(artist_menu_win, song_menu_win, status_win, title_win, "box");
-                ncursesWinControl(artist_menu_win, song_menu_win, status_win, title_win, "refresh");
+                markAllDirty();
+                searchPane.resize();
+                lyricsPane.resize();
         }
 
-        // Update status bar and refresh windows
-        updateStatusBar(status_win, currentSong, currentArtist, currentGenre, music, firstEnterPressed, showingLyrics);
-        ncursesWinLoop(artistMenu, songMenu, artist_menu_win, song_menu_win, status_win, title_win, title_content, showingartMen); 
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));  // Optional delay
+        // Redraw only what changed: everything after input / a track change, just the status bar on a tick
+        if (redraw) {
+            updateStatusBar(status_win, currentSong, currentArtist, currentGenre, music, firstEnterPressed, showingLyrics, loader.busy(), libraryNotice);
+            ncursesWinLoop(artistList, songList, artist_menu_win, song_menu_win, status_win, title_win, title_content, showingartMen && !lyricsPane.active(), browseTitle(browseMode)); 
+            lyricsPane.draw(keybinds);  // over the artist pane it replaces
+            searchPane.draw();  // stays on top of the menus it covers
+            redraw = false;
+        } else if (ready & LOOP_EVENT_TICK) {
+            updateStatusBar(status_win, currentSong, currentArtist, currentGenre, music, firstEnterPressed, showingLyrics, loader.busy(), libraryNotice);
+        }
+        flushFrame();  // the one terminal write of this iteration
+
+        // Tick once a second while the progress moves; poll quickly while a finished or spliced track
+        // drains (or a track failed to open) so the switch shows up on time; no tick at all when idle
+        // or while a song loads, the loader wakes the loop itself
+        if (trackEnding || music.transitionPending() || (firstEnterPressed && music.getStatus() == sf::SoundSource::Stopped && !loader.busy() && !queue.empty())) {
+            events.setTickInterval(50);
+        } else {
+            events.setTickInterval(music.getStatus() == sf::SoundSource::Playing || !libraryNotice.empty() ? 1000 : 0);
+        }
     }
 
     // Clean up and exit
-    unpost_menu(artistMenu);
-    unpost_menu(songMenu);
-    quitFunc(music, allArtists, songTitles, artistItems, songItems, artistMenu, songMenu);
+    queue.save(cacheQueueFile, library);
+    quitFunc(music);
     ncursesWinControl(artist_menu_win, song_menu_win, status_win, title_win, "delete");
     endwin();
     verboseQuit(NC, BLUE, BOLD);